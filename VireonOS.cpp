@@ -7,25 +7,689 @@
   Kompatybilne z Dev-C++ 5.11 (C++98)
 */
 
+#ifdef _WIN32
 #include <windows.h>
+#include <conio.h>
+#else
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <queue>
+#include <deque>
 #include <ctime>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cctype>
+#include <climits>
+#include <cstddef>
+#include <cmath>
 #include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VIREON_SSE2
+#endif
 
 using namespace std;
 
 /* ===============================
    KONSOLE / KOLORY / SLEEP
+   Caly tekst z cout trafia do back-buffera (siatka komorek znak+atrybut).
+   setColor() zmienia tylko biezacy atrybut, a terminal dostaje jeden zapis
+   na klatke: przy msleep(), przed odczytem z cin, przy flush/endl.
+   Linux: sekwencje ANSI. Windows: tryb VT jesli konsola go ma, inaczej API konsoli.
+
+   Ostatnie wiersze zostaja w buforze razem z kopia tego, co juz jest na
+   terminalu (front). Animacje cofaja kursor (screen.rewind) i rysuja cala
+   klatke od nowa, a present() wysyla tylko zmienione odcinki komorek.
+=============================== */
+struct Cell { char ch; unsigned char attr; };
+
+/* punkty pomiarowe tablicy procesow (PROCESS MANAGER nizej):
+   czas miedzy procEnter/procLeave idzie na konto danego procesu */
+enum { PID_IDLE = 0, PID_KERNEL, PID_SHELL, PID_LOGGER, PID_INSTALLER, PID_NETIF, PID_AUDIO, PID_GFX };
+void procEnter(int pid);
+void procLeave();
+
+enum OutputMode { OUT_PLAIN, OUT_ANSI, OUT_CONSOLE };
+
+struct FrameStats {
+    long frames, bytes, lastBytes, maxBytes, overBudget;
+    long cellsSent, cellsSkipped;
+    int budget;                   // bajtow na klatke
+};
+
+class Screen : public streambuf {
+public:
+    Screen();
+    ~Screen();
+    void attach();
+    void setAttr(int a){ attr = (unsigned char)a; }
+    int getAttr() const { return attr; }
+    void blit(const string &text, const string &attrs);   // gotowy bufor z kolorem na znak
+    void setDiscard(bool on){ present(); discard = on; }   // benchmark: renderuj, ale nie wypisuj
+    void present();
+    void clearAll();
+    void rewind(int lines);
+    bool canRewind() const { return mode != OUT_PLAIN; }
+    size_t memoryBytes() const;
+    void inputLineEchoed();
+    FrameStats stats;
+protected:
+    virtual int overflow(int c);
+    virtual streamsize xsputn(const char *s, streamsize n);
+    virtual int sync();
+private:
+    void resetGrid();
+    void presentFrame();
+    void putChar(char c);
+    void diffRow(int r);
+    void moveTo(int r, int c);
+    void emitCells(const vector<Cell> &row, int from, int to);
+    void emitAttr(unsigned char a);
+    void emitColumn(const vector<Cell> &row, int from, int to);
+    void writeOut();
+
+    vector< vector<Cell> > rows;   // klatka budowana przez cout
+    vector< vector<Cell> > front;  // to, co pokazuje terminal
+    vector<int> dirtyLo, dirtyHi;
+    int onTerm;                    // ile pierwszych wierszy juz istnieje na terminalu
+    int curRow, curCol;
+    int termRow, termCol;          // kursor terminala
+    unsigned char attr, termAttr;
+    OutputMode mode;
+    string out;
+    long frameBytes;
+    bool discard;
+    streambuf *origOut;
+#ifdef _WIN32
+    HANDLE hOut;
+#endif
+};
+
+/* cin przez ten bufor: przed blokujacym odczytem wypycha klatke, a po echu
+   ENTER na terminalu wie, ze kursor jest juz w nowej linii */
+class ScreenInput : public streambuf {
+public:
+    ScreenInput(): src(0), orig(0), tty(false), fd(-1) {}
+    void attach(streambuf *from, bool isTty);
+    void redirect(streambuf *from, bool isTty){ src = from; tty = isTty; fd = -1; setg(0,0,0); }   // skrypt / korpus
+    streambuf *source() const { return orig; }
+    bool isTty() const { return tty; }
+    bool pending(long long timeoutUs);   // czy getline nie zablokuje (czeka najwyzej timeoutUs)
+protected:
+    virtual int underflow();
+private:
+    streambuf *src, *orig;
+    bool tty;
+    int fd;                              // POSIX tty: czytamy wprost z fd, zeby select() widzial wszystko
+    char buf[256];
+};
+
+Screen screen;
+ScreenInput screenInput;
+
+long long nowMicros();
+
+static const int SCREEN_KEEP_ROWS = 64;   // ile wierszy mozna nadpisac przez rewind()
+static const int SCREEN_RUN_GAP = 4;      // krotsza przerwa miedzy zmianami: przepisz zamiast skakac
+
+Screen::Screen(): curRow(0), curCol(0), termRow(0), termCol(0), attr(7), termAttr(7),
+                  mode(OUT_PLAIN), frameBytes(0), discard(false), origOut(0) {
+    memset(&stats, 0, sizeof(stats));
+    stats.budget = 1024;
+    resetGrid();
+}
+
+Screen::~Screen(){
+    if(!origOut) return;
+    setAttr(7);
+    present();        // po zniszczeniu tablic procesow procEnter nic nie robi
+    if(mode==OUT_ANSI && termAttr!=7){ out = "\x1b[0m"; writeOut(); }
+    cout.rdbuf(origOut);
+    if(screenInput.source()) cin.rdbuf(screenInput.source());
+}
+
+void Screen::attach(){
+    bool inTty;
+#ifdef _WIN32
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+    hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD m;
+    if(GetConsoleMode(hOut, &m))
+        mode = SetConsoleMode(hOut, m | ENABLE_VIRTUAL_TERMINAL_PROCESSING) ? OUT_ANSI : OUT_CONSOLE;
+    inTty = GetConsoleMode(GetStdHandle(STD_INPUT_HANDLE), &m) != 0;
+#else
+    if(isatty(1)) mode = OUT_ANSI;
+    inTty = isatty(0) != 0;
+#endif
+    origOut = cout.rdbuf(this);
+    screenInput.attach(cin.rdbuf(&screenInput), inTty);
+}
+
+void Screen::resetGrid(){
+    rows.assign(1, vector<Cell>());
+    front.assign(1, vector<Cell>());
+    dirtyLo.assign(1, INT_MAX);
+    dirtyHi.assign(1, 0);
+    onTerm = 1;
+    curRow = curCol = termRow = termCol = 0;
+}
+
+void Screen::putChar(char c){
+    if(c=='\n'){
+        curRow++; curCol = 0;
+        if(curRow == (int)rows.size()){
+            rows.push_back(vector<Cell>());
+            front.push_back(vector<Cell>());
+            dirtyLo.push_back(INT_MAX);
+            dirtyHi.push_back(0);
+        }
+        if(rows.size() > 512) present();   // dlugie listingi nie trzymaja calego tekstu
+        return;
+    }
+    if(c=='\r'){ curCol = 0; return; }
+    if(c=='\t'){ do putChar(' '); while(curCol%8); return; }
+    vector<Cell> &row = rows[curRow];
+    if(curCol >= (int)row.size()){
+        Cell blank = { ' ', 7 };
+        row.resize(curCol+1, blank);
+    }
+    row[curCol].ch = c;
+    row[curCol].attr = attr;
+    if(curCol < dirtyLo[curRow]) dirtyLo[curRow] = curCol;
+    if(curCol+1 > dirtyHi[curRow]) dirtyHi[curRow] = curCol+1;
+    curCol++;
+}
+
+void Screen::blit(const string &text, const string &attrs){
+    unsigned char keep = attr;
+    for(size_t i=0;i<text.size();i++){ attr = (unsigned char)attrs[i]; putChar(text[i]); }
+    attr = keep;
+}
+
+int Screen::overflow(int c){
+    if(c != EOF) putChar((char)c);
+    return c==EOF ? 0 : c;
+}
+
+streamsize Screen::xsputn(const char *s, streamsize n){
+    for(streamsize i=0;i<n;i++) putChar(s[i]);
+    return n;
+}
+
+int Screen::sync(){ present(); return 0; }
+
+void Screen::rewind(int lines){
+    if(mode==OUT_PLAIN) return;   // bez sterowania kursorem kolejna klatka idzie ponizej
+    curRow = max(0, curRow - lines);
+    curCol = 0;
+}
+
+void Screen::emitAttr(unsigned char a){
+    if(mode==OUT_ANSI){
+        static const char ansiOf[8] = { '0','4','2','6','1','5','3','7' };  /* bity BGR konsoli -> RGB ANSI */
+        if(a==7){ out += "\x1b[0m"; }
+        else {
+            out += "\x1b[0;";
+            out += (a&8) ? "9" : "3";
+            out += ansiOf[a&7];
+            if(a>>4){
+                out += (a&0x80) ? ";10" : ";4";
+                out += ansiOf[(a>>4)&7];
+            }
+            out += 'm';
+        }
+    }
+#ifdef _WIN32
+    else if(mode==OUT_CONSOLE){
+        writeOut();
+        SetConsoleTextAttribute(hOut, a);
+    }
+#endif
+    termAttr = a;
+}
+
+void Screen::emitCells(const vector<Cell> &row, int from, int to){
+    for(int i=from;i<to;i++){
+        if(mode!=OUT_PLAIN && row[i].attr!=termAttr) emitAttr(row[i].attr);
+        out += row[i].ch;
+    }
+    if(to > from) stats.cellsSent += to - from;
+}
+
+void Screen::emitColumn(const vector<Cell> &row, int from, int to){
+    if(to==from) return;
+    if(to>from && to-from < SCREEN_RUN_GAP && to <= (int)row.size()){
+        emitCells(row, from, to);   // krocej niz sekwencja ruchu kursora
+        return;
+    }
+    if(mode==OUT_ANSI){
+        char seq[16];
+        if(to==0) out += '\r';
+        else {
+            sprintf(seq, "\x1b[%d%c", to>from ? to-from : from-to, to>from ? 'C' : 'D');
+            out += seq;
+        }
+        return;
+    }
+#ifdef _WIN32
+    if(mode==OUT_CONSOLE){
+        writeOut();
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if(GetConsoleScreenBufferInfo(hOut, &info)){
+            info.dwCursorPosition.X = (SHORT)(info.dwCursorPosition.X + (to-from));
+            SetConsoleCursorPosition(hOut, info.dwCursorPosition);
+        }
+        return;
+    }
+#endif
+    /* bez sterowania kursorem: powrot karetka i przepisanie poczatku wiersza */
+    if(to<from){ out += '\r'; from = 0; }
+    emitCells(row, from, min(to, (int)row.size()));
+}
+
+void Screen::moveTo(int r, int c){
+    if(r != termRow){
+        if(mode==OUT_ANSI){
+            char seq[16];
+            sprintf(seq, "\x1b[%d%c", r>termRow ? r-termRow : termRow-r, r>termRow ? 'B' : 'A');
+            out += seq;
+        }
+#ifdef _WIN32
+        else if(mode==OUT_CONSOLE){
+            writeOut();
+            CONSOLE_SCREEN_BUFFER_INFO info;
+            if(GetConsoleScreenBufferInfo(hOut, &info)){
+                info.dwCursorPosition.Y = (SHORT)(info.dwCursorPosition.Y + (r-termRow));
+                SetConsoleCursorPosition(hOut, info.dwCursorPosition);
+            }
+        }
+#endif
+        termRow = r;
+    }
+    emitColumn(rows[r], termCol, c);
+    termCol = c;
+}
+
+static bool sameLook(const Cell &a, const Cell &b){
+    if(a.ch != b.ch) return false;
+    return a.attr==b.attr || (a.ch==' ' && (a.attr>>4)==(b.attr>>4));
+}
+
+/* wysyla tylko komorki rozne od frontu; bliskie zmiany laczy w jeden odcinek */
+void Screen::diffRow(int r){
+    const vector<Cell> &next = rows[r];
+    vector<Cell> &prev = front[r];
+    static const Cell blank = { ' ', 7 };
+    int lo = dirtyLo[r], hi = dirtyHi[r];
+    int c = lo;
+    while(c < hi){
+        if(sameLook(next[c], c < (int)prev.size() ? prev[c] : blank)){ c++; stats.cellsSkipped++; continue; }
+        int last = c;
+        for(int e=c+1; e<hi && e-last <= SCREEN_RUN_GAP; e++)
+            if(!sameLook(next[e], e < (int)prev.size() ? prev[e] : blank)) last = e;
+        moveTo(r, c);
+        emitCells(next, c, last+1);
+        termCol = last+1;
+        c = last+1;
+    }
+    prev = next;
+    dirtyLo[r] = INT_MAX;
+    dirtyHi[r] = 0;
+}
+
+void Screen::writeOut(){
+    if(out.empty()) return;
+    frameBytes += (long)out.size();
+    if(discard){ out.clear(); return; }
+#ifdef _WIN32
+    DWORD written;
+    if(mode==OUT_CONSOLE) WriteConsoleA(hOut, out.data(), (DWORD)out.size(), &written, 0);
+    else WriteFile(hOut, out.data(), (DWORD)out.size(), &written, 0);
+#else
+    size_t done = 0;
+    while(done < out.size()){
+        ssize_t w = write(1, out.data()+done, out.size()-done);
+        if(w <= 0) break;
+        done += (size_t)w;
+    }
+#endif
+    out.clear();
+}
+
+void Screen::present(){
+    procEnter(PID_GFX);
+    presentFrame();
+    procLeave();
+}
+
+size_t Screen::memoryBytes() const {
+    size_t n = out.capacity();
+    for(size_t r=0;r<rows.size();r++) n += (rows[r].capacity() + front[r].capacity()) * sizeof(Cell);
+    return n;
+}
+
+void Screen::presentFrame(){
+    if(!origOut) return;
+    frameBytes = 0;
+    for(int r=0;r<(int)rows.size();r++){
+        if(r >= onTerm){
+            /* nowy wiersz: dojdz do ostatniego istniejacego i przewin terminal */
+            moveTo(onTerm-1, termCol);
+            out += '\n';
+            termRow = r; termCol = 0;
+            onTerm++;
+        }
+        if(dirtyLo[r] < dirtyHi[r]) diffRow(r);
+    }
+    moveTo(curRow, curCol);
+    writeOut();
+
+    if(frameBytes > 0){
+        stats.frames++;
+        stats.bytes += frameBytes;
+        stats.lastBytes = frameBytes;
+        if(frameBytes > stats.maxBytes) stats.maxBytes = frameBytes;
+        if(frameBytes > stats.budget) stats.overBudget++;
+    }
+
+    int keep = (mode==OUT_PLAIN) ? 1 : SCREEN_KEEP_ROWS;
+    int drop = min((int)rows.size() - keep, curRow);
+    if(drop > 0){
+        rows.erase(rows.begin(), rows.begin()+drop);
+        front.erase(front.begin(), front.begin()+drop);
+        dirtyLo.erase(dirtyLo.begin(), dirtyLo.begin()+drop);
+        dirtyHi.erase(dirtyHi.begin(), dirtyHi.begin()+drop);
+        onTerm -= drop; curRow -= drop; termRow -= drop;
+    }
+}
+
+void Screen::clearAll(){
+    present();
+#ifdef _WIN32
+    if(mode==OUT_CONSOLE) system("cls");
+#endif
+    if(mode==OUT_ANSI){ out = "\x1b[2J\x1b[H"; writeOut(); }
+    resetGrid();
+}
+
+void Screen::inputLineEchoed(){
+    resetGrid();
+}
+
+void ScreenInput::attach(streambuf *from, bool isTty){
+    src = orig = from;
+    tty = isTty;
+#ifndef _WIN32
+    if(tty) fd = 0;
+#endif
+}
+
+bool ScreenInput::pending(long long timeoutUs){
+    screen.present();
+    if(gptr() < egptr() || !tty) return true;
+#ifdef _WIN32
+    long long end = nowMicros() + timeoutUs;
+    while(!_kbhit()){
+        if(nowMicros() >= end) return false;
+        Sleep(10);
+    }
+    return true;
+#else
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(fd, &set);
+    timeval tv;
+    tv.tv_sec = (long)(timeoutUs / 1000000);
+    tv.tv_usec = (long)(timeoutUs % 1000000);
+    procEnter(PID_IDLE);
+    int ready = select(fd+1, &set, 0, 0, &tv);
+    procLeave();
+    return ready != 0;
+#endif
+}
+
+int ScreenInput::underflow(){
+    screen.present();
+    streamsize n = 0;
+    procEnter(PID_IDLE);   // czekanie na uzytkownika to nie CPU powloki
+    if(fd >= 0){
+#ifndef _WIN32
+        ssize_t r = read(fd, buf, sizeof(buf));
+        n = r > 0 ? r : 0;
+#endif
+    } else if((n = src->in_avail()) > 0){
+        if(n > (streamsize)sizeof(buf)) n = sizeof(buf);
+        n = src->sgetn(buf, n);
+    } else {
+        int c = src->sbumpc();
+        if(c != EOF){ buf[0] = (char)c; n = 1; }
+    }
+    procLeave();
+    if(n <= 0) return EOF;
+    setg(buf, buf, buf+n);
+    if(tty && memchr(buf, '\n', (size_t)n)) screen.inputLineEchoed();
+    return (unsigned char)buf[0];
+}
+
+void setColor(int color) { screen.setAttr(color); }
+
+/* ===============================
+   ZEGAR SYSTEMU (real / fast / virtual)
+   msleep() i getUptime() ida przez ten zegar:
+    - real:    prawdziwe czekanie
+    - fast:    czas plynie N razy szybciej, sleep skrocony N razy
+    - virtual: sleep tylko przesuwa licznik, zero czekania (skrypty, testy)
+=============================== */
+enum ClockMode { CLOCK_REAL, CLOCK_FAST, CLOCK_VIRTUAL };
+
+ClockMode clockMode = CLOCK_REAL;
+int clockSpeed = 1;
+long long clockBase = 0;     // czas zegara w chwili ostatniej zmiany trybu
+long long clockEpoch = 0;    // nowMicros() w tej chwili
+long long clockVirtual = 0;  // przespane us w trybie virtual
+
+/* monotoniczny zegar w mikrosekundach (pomiary, benchmark) */
+long long nowMicros(){
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    if(!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER c; QueryPerformanceCounter(&c);
+    return (c.QuadPart / freq.QuadPart) * 1000000LL + (c.QuadPart % freq.QuadPart) * 1000000LL / freq.QuadPart;
+#else
+    timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+#endif
+}
+
+long long clockNow(){
+    switch(clockMode){
+        case CLOCK_FAST:    return clockBase + (nowMicros() - clockEpoch) * clockSpeed;
+        case CLOCK_VIRTUAL: return clockBase + clockVirtual;
+        default:            return clockBase + (nowMicros() - clockEpoch);
+    }
+}
+
+void setClockMode(ClockMode m, int speed){
+    clockBase = clockNow();
+    clockEpoch = nowMicros();
+    clockVirtual = 0;
+    clockMode = m;
+    clockSpeed = max(1, speed);
+}
+
+const char *clockModeName(){
+    return clockMode==CLOCK_FAST ? "fast" : clockMode==CLOCK_VIRTUAL ? "virtual" : "real";
+}
+
+/* "real", "virtual", "fast" albo "fast:N"; false gdy nieznany */
+bool parseClockMode(const string &spec, ClockMode &m, int &speed){
+    speed = 1;
+    if(spec=="real"){ m = CLOCK_REAL; return true; }
+    if(spec=="virtual"){ m = CLOCK_VIRTUAL; return true; }
+    if(spec.compare(0,4,"fast")==0){
+        m = CLOCK_FAST;
+        speed = 10;
+        if(spec.size()>5 && spec[4]==':') speed = atoi(spec.c_str()+5);
+        return speed > 0 && (spec.size()==4 || spec[4]==':');
+    }
+    return false;
+}
+
+/* czeka (albo w trybie virtual tylko przesuwa zegar) do chwili t */
+void clockSleepUntil(long long t){
+    screen.present();
+    long long us = t - clockNow();
+    if(us <= 0) return;
+    if(clockMode==CLOCK_VIRTUAL){ clockVirtual += us; return; }
+    if(clockMode==CLOCK_FAST) us /= clockSpeed;
+    procEnter(PID_IDLE);
+#ifdef _WIN32
+    Sleep((DWORD)(us/1000));
+#else
+    usleep((useconds_t)us);
+#endif
+    procLeave();
+}
+
+/* ===============================
+   ATOMIKI (GCC/MinGW __sync, MSVC Interlocked)
+=============================== */
+#ifdef _MSC_VER
+inline unsigned atomicAdd(volatile unsigned *p, unsigned v){
+    return (unsigned)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v);
+}
+inline bool atomicCas(volatile unsigned *p, unsigned expect, unsigned want){
+    return (unsigned)InterlockedCompareExchange((volatile LONG*)p, (LONG)want, (LONG)expect) == expect;
+}
+inline bool atomicCasPtr(const char * volatile *p, const char *expect, const char *want){
+    return InterlockedCompareExchangePointer((void * volatile *)p, (void*)want, (void*)expect) == expect;
+}
+inline void atomicFence(){ MemoryBarrier(); }
+#else
+inline unsigned atomicAdd(volatile unsigned *p, unsigned v){ return __sync_fetch_and_add(p, v); }
+inline bool atomicCas(volatile unsigned *p, unsigned expect, unsigned want){
+    return __sync_bool_compare_and_swap(p, expect, want);
+}
+inline bool atomicCasPtr(const char * volatile *p, const char *expect, const char *want){
+    return __sync_bool_compare_and_swap(p, expect, want);
+}
+inline void atomicFence(){ __sync_synchronize(); }
+#endif
+inline unsigned atomicLoad(const volatile unsigned *p){ unsigned v = *p; atomicFence(); return v; }
+inline void atomicStore(volatile unsigned *p, unsigned v){ atomicFence(); *p = v; }
+
+/* ===============================
+   KATALOG DANYCH I PLIKI MAPOWANE
+   Trwale dane systemu leza w dataDir (--data DIR, "none" = tylko RAM).
+   MappedFile mapuje plik tylko do odczytu: mmap albo MapViewOfFile.
 =============================== */
-HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-void setColor(int color) { SetConsoleTextAttribute(hConsole, color); }
-void msleep(int ms) { Sleep(ms); }
+string dataDir = "vireon_data";
+
+bool dataEnabled(){ return !dataDir.empty() && dataDir!="none"; }
+string dataPath(const string &name){ return dataDir + "/" + name; }
+
+bool ensureDataDir(){
+    if(!dataEnabled()) return false;
+#ifdef _WIN32
+    return CreateDirectoryA(dataDir.c_str(), 0) || GetLastError()==ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    return mkdir(dataDir.c_str(), 0755)==0 || (stat(dataDir.c_str(), &st)==0 && S_ISDIR(st.st_mode));
+#endif
+}
+
+struct MappedFile {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, map;
+    MappedFile(): data(0), size(0), file(INVALID_HANDLE_VALUE), map(0) {}
+#else
+    int fd;
+    MappedFile(): data(0), size(0), fd(-1) {}
+#endif
+};
+
+void unmapFile(MappedFile &m){
+#ifdef _WIN32
+    if(m.data) UnmapViewOfFile(m.data);
+    if(m.map) CloseHandle(m.map);
+    if(m.file!=INVALID_HANDLE_VALUE) CloseHandle(m.file);
+    m.file = INVALID_HANDLE_VALUE; m.map = 0;
+#else
+    if(m.data) munmap((void*)m.data, m.size);
+    if(m.fd >= 0) close(m.fd);
+    m.fd = -1;
+#endif
+    m.data = 0; m.size = 0;
+}
+
+/* false gdy pliku nie ma; pusty plik to data==0, size==0 */
+bool mapFile(const string &path, MappedFile &m){
+    unmapFile(m);
+#ifdef _WIN32
+    m.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, 0,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if(m.file==INVALID_HANDLE_VALUE) return false;
+    m.size = (size_t)GetFileSize(m.file, 0);
+    if(m.size==0) return true;
+    m.map = CreateFileMappingA(m.file, 0, PAGE_READONLY, 0, 0, 0);
+    if(m.map) m.data = (const char*)MapViewOfFile(m.map, FILE_MAP_READ, 0, 0, 0);
+#else
+    m.fd = open(path.c_str(), O_RDONLY);
+    if(m.fd < 0) return false;
+    struct stat st;
+    if(fstat(m.fd, &st)!=0){ unmapFile(m); return false; }
+    m.size = (size_t)st.st_size;
+    if(m.size==0) return true;
+    void *p = mmap(0, m.size, PROT_READ, MAP_SHARED, m.fd, 0);
+    if(p!=MAP_FAILED) m.data = (const char*)p;
+#endif
+    if(!m.data){ unmapFile(m); return false; }
+    return true;
+}
+
+/* FNV-1a dla formatow na dysku (sumy kontrolne, haszowanie nazw) */
+unsigned fnv1a(const char *s, size_t n){
+    unsigned h = 2166136261u;
+    for(size_t i=0;i<n;i++){ h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+/* MurmurHash64A: szybki 64-bitowy hasz tresci (po 8 bajtow naraz) */
+unsigned long long hash64(const char *p, size_t n){
+    const unsigned long long m = 0xc6a4a7935bd1e995ULL;
+    unsigned long long h = 0x8445d61a4e774912ULL ^ (n * m);
+    const char *end = p + (n & ~(size_t)7);
+    for(; p!=end; p+=8){
+        unsigned long long k;
+        memcpy(&k, p, 8);
+        k *= m; k ^= k >> 47; k *= m;
+        h ^= k; h *= m;
+    }
+    if(n & 7){
+        unsigned long long t = 0;
+        for(size_t i=n & 7; i>0; i--) t = (t << 8) | (unsigned char)p[i-1];
+        h ^= t; h *= m;
+    }
+    h ^= h >> 47; h *= m; h ^= h >> 47;
+    return h;
+}
 
 /* ===============================
    GLOBAL DATA
@@ -35,42 +699,103 @@ string KERNEL_VERSION = "Vireon Kernel Beta";
 string CURRENT_USER = "admin";
 string currentEnvironment = "GUI_Basic";
 time_t bootTime;
+long long bootClock;   // clockNow() przy starcie, dla uptime
 
-map<string,string> fileSystem;
-vector<string> processList;
-vector<string> systemLog;
-vector<string> installedPrograms;
-vector<string> installedEnvironments;
+/* blok kontrolny procesu: serwisy systemu i zadania schedulera */
+enum ProcState { PROC_SLEEPING, PROC_READY, PROC_RUNNING };
+struct Process {
+    int pid;
+    string name;
+    string cmdline;
+    long long startTime;      // clockNow() przy starcie
+    long long cpuMicros;      // zmierzony czas na CPU
+    long long sampleCpu;      // cpuMicros przy poprzednim htop (CPU%)
+    size_t memBytes;          // ostatni pomiar pamieci
+    size_t (*memProbe)();     // serwisy: mierzy pamiec przy probkowaniu (moze byc 0)
+};
+vector<Process> processTable;
 
-vector<string> browserHistory;
 vector<string> browserBookmarks;
-struct Tab { string title; string url; };
+struct Tab { string title; string url; vector<string> back, fwd; };
 vector<Tab> browserTabs;
 int activeTabIndex = -1;
 
+/* Tabela komend: nazwa -> handler + sposob parsowania argumentu.
+   Jedna struktura dla powloki i przegladarki, z niej tez drawCommandsTable(). */
+enum ArgKind { ARG_NONE, ARG_TEXT, ARG_OPT, ARG_INT };
+struct CmdArgs { string text; int num; };
+typedef bool (*CmdHandler)(const CmdArgs &a);   // false = wyjscie z powloki
+struct Command {
+    const char *name;
+    const char *usage;
+    const char *group;
+    const char *desc;
+    ArgKind arg;
+    CmdHandler handler;
+    bool hidden;          // alias, nie pokazywany w tabeli
+};
+struct CommandTable {
+    vector<Command> cmds;
+    vector<int> slots;    // perfect hash: kazda nazwa ma wlasny slot
+    unsigned seed, mask;
+};
+enum { CMD_DONE, CMD_EXIT, CMD_UNKNOWN };
+/* maska tabeli: 2^k-1, najwyzej 65535 (granica buildCommandTable) */
+bool cmdMaskValid(unsigned mask){ return mask >= 7 && mask <= 0xFFFFu && (mask & (mask + 1))==0; }
+CommandTable shellCommands;
+CommandTable browserCommands;
+
 /* ===============================
    PROTOTYPES (naprawa: brakujace deklaracje)
 =============================== */
 string getUptime();
+enum LogLevel { LOG_INFO, LOG_WARN, LOG_ERROR };
+void logEvent(int level, const char *fmt, const char *a1=0, const char *a2=0);
+void addLog(const char *msg);
 void addLog(const string &msg);
+void logOpenStore();
+void logFlush();
+unsigned logPending();
+void logCloseStore();
+void msleep(int ms);
 void showLogo();
 void boot();
 
 void initFS();
-void ls();
+void ls(const string &path="");
 void cat(const string &f);
 void touch(const string &f);
 void writeFile(const string &f);
+void makeDir(const string &path);
+void changeDir(const string &path);
+void diskFree();
+void takeSnapshot(const string &name);
+void listSnapshots();
+void rollbackTo(const string &name);
+bool vfsSnapshot(const string &name);
+void closeFS();
+
+void searchName(unsigned ino, unsigned dir, const string &name, bool isDir);
+void searchText(unsigned ino, const string &seam, const char *data, size_t len, bool append);
+void searchDrop();
+void regLoad();
+void grepFiles(const string &args);
+void findFiles(const string &args);
 
 void initProcesses();
+int procSpawn(const string &name, const string &cmdline, size_t (*memProbe)());
+void procExit(int pid);
+Process *findProcess(int pid);
 void htop(bool verbose=false);
-void showLogs();
+void showLogs(const string &opts="");
+void showFrameStats();
 
 void guessGame();
-void calculator();
+void calculator(const string &arg);
 void notesApp();
 void paint();
 void musicPlayer();
+void youtubePlayer();
 
 void installer();
 void changeEnvironment();
@@ -79,6 +804,10 @@ void wsmApps();
 void wsmCmds();
 void drawCommandsTable();
 
+void initCommands();
+void initBrowserCommands();
+int runCommand(const CommandTable &t, const string &line);
+
 /* Now add prototypes for functions that were referenced before their definitions */
 void drawWSM();
 void drawDesktop();
@@ -89,7 +818,7 @@ void extendedFastfetch();
 void browserShell();
 void browserOpen(const string &url);
 void browserShowBookmarks();
-void browserShowHistory();
+void browserShowHistory(const string &args);
 void browserNewTab(const string &url);
 void browserCloseTab(int idx);
 void browserSwitchTab(int idx);
@@ -102,24 +831,181 @@ void smallLogo(const string &id);
 
 string promptLine(const string &prompt);
 string toLowerStr(const string &s);
+string trim(const string &s);
 void pressAnyKey();
 
 /* ===============================
    UTILITIES
 =============================== */
 string getUptime(){
-    time_t now = time(0);
-    int sec = (int)difftime(now, bootTime);
+    int sec = (int)((clockNow() - bootClock) / 1000000);
     int min = sec/60; sec%=60;
     char buffer[64]; sprintf(buffer,"%dm %ds",min,sec);
     return string(buffer);
 }
 
-void addLog(const string &msg){
-    time_t now=time(0);
-    char tbuf[32]; struct tm *lt=localtime(&now);
-    sprintf(tbuf,"%02d:%02d:%02d",lt->tm_hour,lt->tm_min,lt->tm_sec);
-    systemLog.push_back(string("[")+tbuf+"] "+msg);
+/* ===============================
+   SCHEDULER (kooperacyjny)
+   Animacje i instalacje to zadania: step() liczy jedna klatke i oddaje
+   sterowanie, scheduler budzi je wedlug zegara systemu. Zadanie na
+   pierwszym planie rysuje klatki na ekranie, w tle tylko liczy stan.
+   Powloka czeka na wejscie, a w tym czasie zadania dalej chodza.
+=============================== */
+struct Task;
+struct TaskKind {
+    bool inlineFrame;             // klatka w jednym wierszu (\r), inaczej blok wierszy
+    void (*header)(Task &t);      // przed pierwsza klatka na ekranie (moze byc 0)
+    bool (*step)(Task &t);        // nastepna klatka; false = koniec
+    void (*finish)(Task &t);      // po koncu; rysuje tylko gdy t.foreground
+};
+struct Task {
+    int pid;
+    string name;
+    const TaskKind *kind;
+    long long wakeAt;
+    int delayMs;                  // do nastepnej klatki, step() moze zmienic
+    int frame, frames;
+    bool foreground;
+    bool quiet;                   // w tle bez komunikatow (prefetch)
+    int drawnRows;                // -1 = jeszcze nie na ekranie
+    int color;
+    vector<string> rows;          // biezaca klatka
+    vector<int> vals;             // stan aplikacji
+};
+
+vector<Task*> tasks;
+int schedDepth = 0;               // >0 gdy wykonuje sie step()
+bool launchBackground = false;    // komenda konczyla sie na '&'
+vector<string> taskNotices;       // "[pid] Done ..." do wypisania przed promptem
+
+Task *findTask(int pid){
+    for(size_t i=0;i<tasks.size();i++) if(tasks[i]->pid==pid) return tasks[i];
+    return 0;
+}
+
+Task *createTask(const TaskKind *kind, const string &name, int delayMs, int frames){
+    Task *t = new Task;
+    t->pid = procSpawn(name, "/bin/"+toLowerStr(name), 0);
+    t->name = name;
+    t->kind = kind;
+    t->wakeAt = clockNow();
+    t->delayMs = delayMs;
+    t->frame = 0;
+    t->frames = frames;
+    t->foreground = true;
+    t->quiet = false;
+    t->drawnRows = -1;
+    t->color = 7;
+    return t;
+}
+
+void drawTask(Task &t){
+    if(t.drawnRows < 0){
+        if(t.kind->header) t.kind->header(t);
+    } else if(!t.kind->inlineFrame) screen.rewind(t.drawnRows);
+    setColor(t.color);
+    if(t.kind->inlineFrame){ if(!t.rows.empty()) cout<<"\r"<<t.rows[0]; }
+    else for(size_t i=0;i<t.rows.size();i++) cout<<t.rows[i]<<"\n";
+    setColor(7);
+    t.drawnRows = (int)t.rows.size();
+}
+
+void endTask(size_t i){
+    Task *t = tasks[i];
+    tasks.erase(tasks.begin()+i);
+    /* bez sterowania kursorem bloki klatek nie byly rysowane - pokaz ostatnia */
+    if(t->foreground && !t->kind->inlineFrame && !screen.canRewind()) drawTask(*t);
+    t->kind->finish(*t);
+    if(!t->foreground && !t->quiet){
+        char buf[32]; sprintf(buf, "[%d] Done  ", t->pid);
+        taskNotices.push_back(buf + t->name);
+    }
+    procExit(t->pid);
+    logEvent(LOG_INFO, "Task finished: %s", t->name.c_str());
+    delete t;
+}
+
+size_t taskBytes(const Task &t){
+    size_t n = sizeof(Task) + t.name.capacity() + t.vals.capacity()*sizeof(int);
+    for(size_t i=0;i<t.rows.size();i++) n += sizeof(string) + t.rows[i].capacity();
+    return n;
+}
+
+void runDueTasks(){
+    procEnter(PID_KERNEL);
+    long long now = clockNow();
+    for(size_t i=0;i<tasks.size();){
+        Task &t = *tasks[i];
+        if(t.wakeAt <= now){
+            procEnter(t.pid);
+            schedDepth++;
+            bool more = t.kind->step(t);
+            schedDepth--;
+            if(more && t.foreground && (t.kind->inlineFrame || screen.canRewind())) drawTask(t);
+            if(Process *p = findProcess(t.pid)) p->memBytes = taskBytes(t);
+            procLeave();
+            if(!more){ endTask(i); continue; }
+            t.wakeAt += (long long)t.delayMs * 1000;
+            if(t.wakeAt < now) t.wakeAt = now;   // po dlugim bloku nie nadrabiaj klatek seria
+        }
+        i++;
+    }
+    procLeave();
+}
+
+long long nextWake(){
+    long long w = -1;
+    for(size_t i=0;i<tasks.size();i++)
+        if(w < 0 || tasks[i]->wakeAt < w) w = tasks[i]->wakeAt;
+    return w;
+}
+
+/* do chwili until (pid<0) albo do konca zadania pid; w miedzyczasie chodza inne */
+void schedulerWait(long long until, int pid){
+    if(schedDepth > 0){ clockSleepUntil(until); return; }
+    while(true){
+        runDueTasks();
+        if(pid >= 0 ? findTask(pid)==0 : clockNow() >= until) return;
+        long long wake = nextWake();
+        long long target = pid >= 0 ? wake : (wake >= 0 ? min(wake, until) : until);
+        if(target < 0) return;
+        clockSleepUntil(target);
+    }
+}
+
+void msleep(int ms){
+    schedulerWait(clockNow() + (long long)ms*1000, -1);
+}
+
+/* pierwszy plan: czeka do konca zadania; w tle (&): wraca od razu */
+void launchTask(Task *t, bool background){
+    t->foreground = !background;
+    tasks.push_back(t);
+    logEvent(LOG_INFO, "Task started: %s", t->name.c_str());
+    if(background){
+        if(!t->quiet) cout<<"["<<t->pid<<"] "<<t->name<<" running in background\n\n";
+        return;
+    }
+    schedulerWait(-1, t->pid);
+}
+
+/* powloka: zadania chodza, dopoki uzytkownik nie poda linii */
+void waitForInput(){
+    logFlush();
+    while(!tasks.empty()){
+        runDueTasks();
+        long long wake = nextWake();
+        if(wake < 0) break;
+        if(clockMode==CLOCK_VIRTUAL){
+            if(screenInput.pending(0)) return;
+            clockSleepUntil(wake);
+            continue;
+        }
+        long long us = wake - clockNow();
+        if(clockMode==CLOCK_FAST) us /= clockSpeed;
+        if(screenInput.pending(max(0LL, us))) return;
+    }
+    screenInput.pending(0);   // wypchnij prompt
 }
 
 /* ===============================
@@ -146,402 +1032,5027 @@ void showLogo(){
 
 /* ===============================
    FILE SYSTEM
+   Obraz dataDir/vfs.img, mapowany przy starcie:
+     [VfsHeader 4 KB][tablica inodow][extenty: tresc plikow i tablice dzieci katalogow]
+   Katalog to inode, ktorego extent jest tablica haszujaca VfsDirEntry
+   (nazwa -> inode), wiec rozwiazanie sciezki kosztuje O(glebokosci),
+   a ls dotyka tylko jednego katalogu. Tresc plikow lezy w magazynie
+   blobow adresowanych trescia (kawalki po VFS_CHUNK, licznik odwolan),
+   wiec identyczne pliki i pobrania dziela miejsce. Start niczego nie
+   parsuje, cat wypisuje tresc wprost z mapowania.
+
+   Migawki (snapshot) sa O(1): zapamietuja polozenie tablicy inodow
+   i podbijaja epoke. Wszystko, co powstalo we wczesniejszej epoce, jest
+   zamrozone: pierwsza zmiana w nowej epoce kopiuje tablice inodow,
+   tablice dzieci katalogu albo tablice kawalkow pliku (vfsThaw), tresc
+   zostaje wspolna. Rollback przelacza korzen i zbiera to, czego nie
+   widac juz z zadnego korzenia (vfsCollect). Zapis: dane ida do wolnego
+   extentu, potem metadane jako transakcja do vfs.journal i dopiero
+   wtedy do obrazu; po awarii start powtarza kompletne transakcje.
+   Przy --data none ten sam format zyje w buforze w RAM, bez dziennika.
 =============================== */
-void initFS(){
-    fileSystem.clear();
-    fileSystem["readme.txt"] =
-        "VireonOS Beta\n"
-        "This is a simulated OS environment.\n";
-    fileSystem["about.txt"] =
-        "VireonOS Beta - Combined demo executable for Dev-C++ 5.11.\nContact: fake@vireonos.dev\n";
-    fileSystem["notes.txt"] = "Initial notes...\n";
-    addLog("Filesystem initialized");
+const unsigned VFS_HEADER_BYTES = 4096;
+const unsigned VFS_NAME_MAX = 56;
+const unsigned VFS_ALIGN = 64;
+const unsigned VFS_INODES_INITIAL = 256;
+const unsigned VFS_DIR_SLOTS = 16;              // poczatkowa tablica dzieci, potega dwojki
+const unsigned VFS_ROOT = 1;
+const unsigned VFS_DCACHE = 1024;               // potega dwojki
+const unsigned VFS_GROW = 1u << 20;             // obraz rosnie o tyle naraz
+const unsigned VFS_JOURNAL_LIMIT = 256u << 10;  // potem dziennik jest czyszczony
+const unsigned VFS_MAX_FILE = 1u << 30;
+const unsigned VFS_CHUNK = 16u << 10;           // tresc plikow w kawalkach (blobach) tej wielkosci
+const unsigned VFS_BLOBS_INITIAL = 64;
+const unsigned VFS_INDEX_INITIAL = 128;         // potega dwojki
+const unsigned VFS_TOMB = 0xFFFFFFFFu;          // usuniety slot indeksu blobow
+const unsigned VFS_TX_MAGIC = 0x4A585456u;      // "VTXJ"
+const unsigned VFS_MAX_SNAPSHOTS = 32;
+const char VFS_MAGIC[8] = { 'V','F','S','I','M','G','0','4' };
+
+enum VfsType { VFS_NONE, VFS_FILE, VFS_DIR };
+
+struct VfsExtent { unsigned offset, capacity; };
+const unsigned VFS_MAX_FREE = (VFS_HEADER_BYTES - 80) / sizeof(VfsExtent);
+
+struct VfsHeader {
+    char magic[8];
+    unsigned version;
+    unsigned inodeOffset, inodeCapacity, inodeCount;
+    unsigned blobOffset, blobCapacity, blobCount, blobFree;
+    unsigned indexOffset, indexCapacity, indexCount;    // indexCount liczy tez VFS_TOMB
+    unsigned dataEnd;                   // koniec zajetej czesci obrazu
+    unsigned freeCount;
+    unsigned epoch;                     // rosnie z kazda migawka i rollbackiem
+    unsigned inodeEpoch;                // epoka, w ktorej powstala tablica inodow
+    unsigned snapOffset, snapCount;
+    unsigned txSeq;                     // ostatnia transakcja dziennika zastosowana w obrazie
+    VfsExtent freeList[VFS_MAX_FREE];   // zwolnione extenty, first-fit
+};
+
+struct VfsInode {
+    unsigned type;
+    unsigned parent;                    // root wskazuje na siebie
+    unsigned offset;                    // tablica id blobow pliku albo tablica dzieci
+    unsigned length;                    // bajty tresci / liczba dzieci
+    unsigned capacity;                  // bajty extentu
+    unsigned mtime;
+    unsigned tail;                      // prywatny, niepelny ostatni kawalek (dopisywanie)
+    unsigned birth;                     // epoka zapisu; starsza = wspolna z migawka
+};
+
+/* migawka: korzen drzewa (tablica inodow) z chwili jej zrobienia */
+struct VfsSnapshot {
+    char name[32];
+    unsigned inodeOffset, inodeCapacity, inodeCount;
+    unsigned epoch;
+    unsigned time;
+    unsigned reserved[3];
+};
+
+/* blob: niezmienny kawalek tresci; offset 0 = id wolne (next = nastepne wolne) */
+struct VfsBlob {
+    unsigned hashLo, hashHi;
+    unsigned offset, length;
+    unsigned refs;
+    unsigned next;
+};
+
+struct VfsDirEntry {
+    char name[VFS_NAME_MAX];
+    unsigned inode;                     // 0 = wolny slot
+    unsigned hash;                      // fnv1a(name), przy rozroscie bez liczenia od nowa
+};
+
+/* dentry cache: (katalog, nazwa) -> inode, mapowany bezposrednio */
+struct Dentry {
+    unsigned dir, hash, inode;
+    char name[VFS_NAME_MAX];
+};
+
+struct VfsWrite { unsigned offset; string bytes; };
+
+bool vfsOnDisk = false;
+MappedFile vfsMap;
+FILE *vfsFile = 0, *vfsJournal = 0;
+unsigned vfsJournalBytes = 0;
+vector<char> vfsRam;                    // obraz przy --data none
+vector<VfsWrite> vfsTx;                 // metadane biezacej transakcji
+vector<VfsExtent> vfsDeferred;          // zwalniane dopiero przy zatwierdzeniu operacji
+Dentry vfsDcache[VFS_DCACHE];
+unsigned vfsCwd = VFS_ROOT;
+string vfsCwdPath = "/";
+
+const char *vfsBase(){ return vfsOnDisk ? vfsMap.data : (vfsRam.empty() ? 0 : &vfsRam[0]); }
+size_t vfsSize(){ return vfsOnDisk ? vfsMap.size : vfsRam.size(); }
+const VfsHeader &vfsHeader(){ return *(const VfsHeader*)vfsBase(); }
+const VfsInode &vfsInode(unsigned ino){
+    return ((const VfsInode*)(vfsBase() + vfsHeader().inodeOffset))[ino];
 }
+const VfsDirEntry *vfsChildren(const VfsInode &d){ return (const VfsDirEntry*)(vfsBase() + d.offset); }
+unsigned vfsSlots(const VfsInode &d){ return d.capacity / sizeof(VfsDirEntry); }
+const unsigned *vfsChunks(const VfsInode &f){ return (const unsigned*)(vfsBase() + f.offset); }
+/* kawalki w magazynie blobow; reszta (length % VFS_CHUNK) moze byc w ogonie */
+unsigned vfsSealed(const VfsInode &f){ return (f.length + (f.tail ? 0 : VFS_CHUNK - 1)) / VFS_CHUNK; }
+const VfsSnapshot *vfsSnapshots(){ return (const VfsSnapshot*)(vfsBase() + vfsHeader().snapOffset); }
+const VfsBlob &vfsBlob(unsigned id){ return ((const VfsBlob*)(vfsBase() + vfsHeader().blobOffset))[id]; }
+const unsigned *vfsIndex(){ return (const unsigned*)(vfsBase() + vfsHeader().indexOffset); }
 
-void ls(){ 
-    setColor(11); 
-    cout<<"\nFiles:\n";
-    for(map<string,string>::iterator it=fileSystem.begin(); it!=fileSystem.end(); ++it) 
-        cout<<" - "<<it->first<<"\n"; 
-    setColor(7); 
-    cout<<"\n"; 
+bool vfsImageValid(){ return vfsSize() >= VFS_HEADER_BYTES && memcmp(vfsBase(), VFS_MAGIC, 8)==0; }
+void vfsDcacheClear(){ memset(vfsDcache, 0, sizeof vfsDcache); }
+
+/* obraz ma co najmniej end bajtow; na dysku powieksza plik i mapuje od nowa */
+void vfsReserve(size_t end){
+    if(end <= vfsSize()) return;
+    size_t size = (end + VFS_GROW - 1) / VFS_GROW * VFS_GROW;
+    if(!vfsOnDisk){ vfsRam.resize(size, 0); return; }
+    fseek(vfsFile, (long)size - 1, SEEK_SET);
+    fputc(0, vfsFile);
+    fflush(vfsFile);
+    mapFile(dataPath("vfs.img"), vfsMap);
 }
 
-void cat(const string &f){ 
-    if(fileSystem.count(f)) cout<<"\n"<<fileSystem[f]<<"\n";
-    else cout<<"\nFile not found: "<<f<<"\n";
-    cout<<"\n";
+/* dane zapisane przez vfsPut widoczne w mapowaniu */
+void vfsSync(){ if(vfsOnDisk) fflush(vfsFile); }
+
+/* zapis prosto do obrazu, z pominieciem dziennika */
+void vfsPut(unsigned off, const void *p, size_t n){
+    if(!n) return;
+    if(!vfsOnDisk){ memcpy(&vfsRam[off], p, n); return; }
+    fseek(vfsFile, (long)off, SEEK_SET);
+    fwrite(p, 1, n, vfsFile);
 }
 
-void touch(const string &f){ 
-    if(!fileSystem.count(f)){
-        fileSystem[f]="";
-        addLog("File created: "+f);
-        cout<<"\nCreated file: "<<f<<"\n\n";
-    } else {
-        cout<<"\nFile already exists: "<<f<<"\n\n";
-    }
+void vfsTxPut(unsigned off, const void *p, size_t n){
+    VfsWrite w;
+    w.offset = off;
+    w.bytes.assign((const char*)p, n);
+    vfsTx.push_back(w);
 }
 
-void writeFile(const string &f){
-    cin.ignore();
-    string t;
-    cout<<"Enter text (single line will be saved): ";
-    getline(cin,t);
-    fileSystem[f]=t;
-    addLog("File written: "+f);
-    cout<<"Saved.\n\n";
+void vfsTxHeader(const VfsHeader &h){
+    vfsTxPut(0, &h, offsetof(VfsHeader, freeList) + h.freeCount*sizeof(VfsExtent));
 }
 
-/* ===============================
-   PROCESS MANAGER (HTOP-like)
-=============================== */
-void initProcesses(){
-    processList.clear();
-    processList.push_back("kernel");
-    processList.push_back("vireonshell");
-    processList.push_back("logger");
-    processList.push_back("installer");
-    processList.push_back("netif");
-    processList.push_back("audio");
-    processList.push_back("gfx");
-    addLog("Processes initialized");
+unsigned vfsAlloc(VfsHeader &h, unsigned size);
+
+/* tablica inodow z wczesniejszej epoki nalezy do migawki: pierwszy zapis
+   inode'u w nowej epoce przenosi ja do kopii */
+void vfsTxInode(VfsHeader &h, unsigned ino, const VfsInode &node){
+    if(h.inodeEpoch < h.epoch){
+        unsigned bytes = h.inodeCapacity * sizeof(VfsInode);
+        unsigned off = vfsAlloc(h, bytes);
+        vfsPut(off, vfsBase() + h.inodeOffset, bytes);
+        h.inodeOffset = off;
+        h.inodeEpoch = h.epoch;
+    }
+    VfsInode n = node;
+    n.birth = h.epoch;
+    vfsTxPut(h.inodeOffset + ino*sizeof(VfsInode), &n, sizeof n);
 }
 
-void htop(bool verbose){
-    setColor(10);
-    cout<<"\n+------------------------------------------------------------+\n";
-    cout<<"|               VireonOS Process Monitor (htop)             |\n";
-    cout<<"+------------------------------------------------------------+\n";
-    cout<<"| PID  | NAME         | CPU% | MEM% | THREADS | STATE       |\n";
-    cout<<"+------------------------------------------------------------+\n";
-    for(size_t i=0;i<processList.size();i++){
-        int pid = 1000 + (int)i*3 + rand()%50;
-        int cpu = rand()%100;
-        int mem = rand()%100;
-        int thr = rand()%12 + 1;
-        string state = (rand()%2==0?"running":"sleeping");
-        char buf[256];
-        sprintf(buf,"| %-4d | %-12s | %3d%% | %3d%% | %6d | %-10s |",
-                pid, processList[i].c_str(), cpu, mem, thr, state.c_str());
-        cout<<buf<<"\n";
-        if(verbose){
-            cout<<"    CMD: /bin/"<<processList[i]<<" --service\n";
-            cout<<"    Uptime: "<<(rand()%360)<<"s  Started by: root\n";
+void vfsResetJournal(){
+    if(vfsJournal) fclose(vfsJournal);
+    vfsJournal = fopen(dataPath("vfs.journal").c_str(), "wb");
+    vfsJournalBytes = 0;
+}
+
+/* transakcja w dzienniku: [magic, numer, liczba zapisow, bajty, fnv1a]
+   i zapisy (offset, dlugosc, bajty); do obrazu trafia dopiero po zapisie
+   w dzienniku, a jej numer na koncu, jako txSeq naglowka */
+void vfsCommit(){
+    unsigned seq = vfsHeader().txSeq + 1;
+    if(vfsOnDisk && vfsJournal){
+        string rec;
+        for(size_t i=0;i<vfsTx.size();i++){
+            unsigned len = (unsigned)vfsTx[i].bytes.size();
+            rec.append((const char*)&vfsTx[i].offset, 4);
+            rec.append((const char*)&len, 4);
+            rec += vfsTx[i].bytes;
         }
+        unsigned hdr[5] = { VFS_TX_MAGIC, seq, (unsigned)vfsTx.size(), (unsigned)rec.size(), fnv1a(rec.data(), rec.size()) };
+        fwrite(hdr, sizeof hdr, 1, vfsJournal);
+        fwrite(rec.data(), 1, rec.size(), vfsJournal);
+        fflush(vfsJournal);
+        vfsJournalBytes += sizeof hdr + rec.size();
     }
-    cout<<"+------------------------------------------------------------+\n\n";
-    setColor(7);
+    for(size_t i=0;i<vfsTx.size();i++) vfsPut(vfsTx[i].offset, vfsTx[i].bytes.data(), vfsTx[i].bytes.size());
+    vfsPut(offsetof(VfsHeader, txSeq), &seq, sizeof seq);
+    vfsTx.clear();
+    if(!vfsOnDisk) return;
+    fflush(vfsFile);
+    if(vfsJournalBytes > VFS_JOURNAL_LIMIT) vfsResetJournal();
 }
 
-/* ===============================
-   SYSTEM LOGS
-=============================== */
-void showLogs(){
-    setColor(14);
-    cout<<"\n--- System Logs ---\n";
-    for(size_t i=0;i<systemLog.size();i++){
-        cout<<systemLog[i]<<"\n";
+/* kompletne transakcje nowsze niz txSeq obrazu sa powtarzane w kolejnosci;
+   starszych nie wolno: ich extenty mogly juz zostac zwolnione i uzyte
+   ponownie. Pierwsza uszkodzona konczy odtwarzanie. */
+int vfsReplayJournal(){
+    MappedFile j;
+    if(!mapFile(dataPath("vfs.journal"), j)) return 0;
+    size_t off = 0;
+    int applied = 0;
+    unsigned done = vfsSize() >= VFS_HEADER_BYTES ? vfsHeader().txSeq : 0;
+    while(off + 20 <= j.size){
+        unsigned hdr[5];
+        memcpy(hdr, j.data + off, sizeof hdr);
+        const char *p = j.data + off + 20;
+        if(hdr[0]!=VFS_TX_MAGIC || hdr[3] > j.size - off - 20 || fnv1a(p, hdr[3])!=hdr[4]) break;
+        off += 20 + hdr[3];
+        if(hdr[1] <= done) continue;
+        const char *end = p + hdr[3];
+        for(unsigned i=0;i<hdr[2] && p + 8 <= end;i++){
+            unsigned wo, wl;
+            memcpy(&wo, p, 4); memcpy(&wl, p + 4, 4);
+            p += 8;
+            if(wl > (size_t)(end - p)) break;
+            vfsReserve((size_t)wo + wl);
+            vfsPut(wo, p, wl);
+            p += wl;
+        }
+        vfsPut(offsetof(VfsHeader, txSeq), &hdr[1], sizeof hdr[1]);
+        done = hdr[1];
+        applied++;
     }
-    cout<<"\n";
-    setColor(7);
+    unmapFile(j);
+    if(applied) fflush(vfsFile);
+    return applied;
 }
 
-/* ===============================
-   MINI GAMES
-=============================== */
-void guessGame(){
-    srand((unsigned)time(0));
-    int secret = rand()%20+1, g;
-    cout<<"Guess number (1-20): ";
-    cin>>g;
-    if(g==secret){
-        setColor(10); cout<<"Correct! You win!\n\n";
-        addLog("guessGame: user guessed correctly");
-    } else {
-        setColor(12); cout<<"Wrong! The number was "<<secret<<"\n\n";
-        addLog("guessGame: user guessed wrong");
+unsigned vfsAlloc(VfsHeader &h, unsigned size){
+    if(!size) return 0;
+    for(unsigned i=0;i<h.freeCount;i++){
+        VfsExtent &x = h.freeList[i];
+        if(x.capacity < size) continue;
+        unsigned off = x.offset;
+        if(x.capacity > size){ x.offset += size; x.capacity -= size; }
+        else x = h.freeList[--h.freeCount];
+        return off;
     }
-    setColor(7);
+    unsigned off = h.dataEnd;
+    h.dataEnd += size;
+    vfsReserve(h.dataEnd);
+    return off;
 }
 
-/* ===============================
-   CALCULATOR
-=============================== */
-void calculator(){
-    double a,b; char op;
-    cout<<"Calculator - enter: num1 operator num2\n> ";
-    cin >> a >> op >> b;
-    double res=0;
-    switch(op){
-        case '+': res=a+b; break;
-        case '-': res=a-b; break;
-        case '*': res=a*b; break;
-        case '/': if(b!=0) res=a/b; else { cout<<"Error: division by zero\n"; return; } break;
-        default: cout<<"Unknown operator\n"; return;
+/* sasiednie wolne extenty sa sklejane; pelna lista gubi extent
+   (miejsce odzyska dopiero nowy obraz) */
+void vfsFree(VfsHeader &h, unsigned off, unsigned cap){
+    if(!cap) return;
+    for(unsigned i=0;i<h.freeCount;i++){
+        VfsExtent &x = h.freeList[i];
+        if(x.offset + x.capacity==off) x.capacity += cap;
+        else if(off + cap==x.offset){ x.offset = off; x.capacity += cap; }
+        else continue;
+        if(x.offset + x.capacity==h.dataEnd){
+            h.dataEnd = x.offset;
+            x = h.freeList[--h.freeCount];
+        }
+        return;
+    }
+    if(off + cap==h.dataEnd){ h.dataEnd = off; return; }
+    if(h.freeCount < VFS_MAX_FREE){
+        h.freeList[h.freeCount].offset = off;
+        h.freeList[h.freeCount].capacity = cap;
+        h.freeCount++;
     }
-    cout<<"Result: "<<res<<"\n\n";
+}
+
+/* offset 0 to naglowek, nigdy extent: "brak extentu" */
+void vfsFreeLater(unsigned off, unsigned cap){
+    if(!off) return;
+    VfsExtent x = { off, cap };
+    vfsDeferred.push_back(x);
+}
+
+void vfsFreeDeferred(VfsHeader &h){
+    for(size_t i=0;i<vfsDeferred.size();i++) vfsFree(h, vfsDeferred[i].offset, vfsDeferred[i].capacity);
+    vfsDeferred.clear();
+}
+
+unsigned vfsRound(size_t n){ return (unsigned)((n + VFS_ALIGN - 1) & ~(size_t)(VFS_ALIGN - 1)); }
+
+/* extent wypelniony zerami (nowa tablica dzieci) */
+unsigned vfsAllocZero(VfsHeader &h, unsigned size){
+    unsigned off = vfsAlloc(h, size);
+    vector<char> zero(size, 0);
+    vfsPut(off, &zero[0], size);
+    return off;
+}
+
+/* slot z nazwa albo pierwszy wolny slot na sciezce sondowania */
+int vfsProbe(const VfsDirEntry *tab, unsigned slots, const char *name, size_t n, unsigned hash, bool &found){
+    unsigned i = hash & (slots - 1);
+    while(tab[i].inode){
+        if(tab[i].hash==hash && memcmp(tab[i].name, name, n)==0 && tab[i].name[n]==0){ found = true; return (int)i; }
+        i = (i + 1) & (slots - 1);
+    }
+    found = false;
+    return (int)i;
+}
+
+/* dziecko katalogu dir o nazwie name[0..n); 0 gdy nie ma */
+unsigned vfsChild(unsigned dir, const char *name, size_t n){
+    if(n >= VFS_NAME_MAX) return 0;
+    unsigned hash = fnv1a(name, n);
+    Dentry &c = vfsDcache[(hash ^ dir*2654435761u) & (VFS_DCACHE-1)];
+    if(c.inode && c.dir==dir && c.hash==hash && memcmp(c.name, name, n)==0 && c.name[n]==0) return c.inode;
+    const VfsInode &d = vfsInode(dir);
+    bool found;
+    int slot = vfsProbe(vfsChildren(d), vfsSlots(d), name, n, hash, found);
+    if(!found) return 0;
+    c.dir = dir;
+    c.hash = hash;
+    c.inode = vfsChildren(d)[slot].inode;
+    memcpy(c.name, name, n);
+    c.name[n] = 0;
+    return c.inode;
+}
+
+/* sciezka (bezwzgledna albo wzgledem cwd) -> inode, 0 gdy nie istnieje;
+   canon dostaje kanoniczna postac sciezki */
+unsigned vfsWalk(const string &path, string *canon=0){
+    bool abs = !path.empty() && path[0]=='/';
+    unsigned ino = abs ? VFS_ROOT : vfsCwd;
+    string at = (abs || vfsCwdPath=="/") ? "" : vfsCwdPath;
+    size_t i = 0;
+    while(i < path.size()){
+        size_t j = path.find('/', i);
+        if(j==string::npos) j = path.size();
+        size_t n = j - i;
+        if(n==2 && path[i]=='.' && path[i+1]=='.'){
+            ino = vfsInode(ino).parent;
+            size_t k = at.rfind('/');
+            at.erase(k==string::npos ? 0 : k);
+        } else if(n > 0 && !(n==1 && path[i]=='.')){
+            if(vfsInode(ino).type!=VFS_DIR) return 0;
+            ino = vfsChild(ino, path.data() + i, n);
+            if(!ino) return 0;
+            if(canon) at += "/" + path.substr(i, n);
+        }
+        i = j + 1;
+    }
+    if(canon) *canon = at.empty() ? "/" : at;
+    return ino;
+}
+
+/* katalog, w ktorym ma powstac ostatni element sciezki; base = ten element */
+unsigned vfsWalkParent(const string &path, string &base){
+    size_t end = path.find_last_not_of('/');
+    if(end==string::npos) return 0;
+    size_t pos = path.rfind('/', end);
+    base = path.substr(pos==string::npos ? 0 : pos + 1, end - (pos==string::npos ? 0 : pos + 1) + 1);
+    unsigned dir = pos==string::npos ? vfsCwd : vfsWalk(pos==0 ? "/" : path.substr(0, pos));
+    return dir && vfsInode(dir).type==VFS_DIR ? dir : 0;
+}
+
+bool vfsValidName(const string &n){
+    return !n.empty() && n.size() < VFS_NAME_MAX && n!="." && n!=".." && n.find('/')==string::npos;
+}
+
+/* inode z wczesniejszej epoki dostaje wlasne kopie extentow; tresc pliku
+   zostaje wspolna, jego bloby dostaja tylko odwolanie z nowej tablicy */
+void vfsThaw(VfsHeader &h, VfsInode &node, map<unsigned,int> *refs){
+    if(node.birth >= h.epoch) return;
+    if(node.type==VFS_FILE){
+        const unsigned *ids = vfsChunks(node);
+        for(unsigned i=0;i<vfsSealed(node);i++) (*refs)[ids[i]]++;
+        if(node.tail){
+            unsigned tail = vfsAlloc(h, VFS_CHUNK);
+            vfsPut(tail, vfsBase() + node.tail, node.length % VFS_CHUNK);
+            node.tail = tail;
+        }
+    }
+    if(node.capacity){
+        unsigned off = vfsAlloc(h, node.capacity);
+        vfsPut(off, vfsBase() + node.offset, node.capacity);
+        node.offset = off;
+    }
+    node.birth = h.epoch;
+    vfsSync();
+}
+
+/* tablica inodow 2x wieksza w nowym extencie, przelaczona jedna transakcja */
+void vfsGrowInodes(VfsHeader &h){
+    unsigned bytes = h.inodeCapacity * sizeof(VfsInode);
+    unsigned off = vfsAllocZero(h, bytes * 2);
+    vfsPut(off, vfsBase() + h.inodeOffset, bytes);
+    if(h.inodeEpoch==h.epoch) vfsFree(h, h.inodeOffset, bytes);
+    h.inodeOffset = off;
+    h.inodeEpoch = h.epoch;
+    h.inodeCapacity *= 2;
+    vfsTxHeader(h);
+    vfsCommit();
+}
+
+/* tablica dzieci katalogu 2x wieksza, wpisy przehaszowane po zapisanym hashu */
+void vfsGrowDir(VfsHeader &h, unsigned dir){
+    VfsInode d = vfsInode(dir);
+    unsigned slots = vfsSlots(d) * 2;
+    unsigned off = vfsAlloc(h, slots * sizeof(VfsDirEntry));
+    vector<VfsDirEntry> table(slots);
+    memset(&table[0], 0, slots * sizeof(VfsDirEntry));
+    const VfsDirEntry *old = vfsChildren(d);
+    for(unsigned i=0;i<vfsSlots(d);i++){
+        if(!old[i].inode) continue;
+        unsigned k = old[i].hash & (slots - 1);
+        while(table[k].inode) k = (k + 1) & (slots - 1);
+        table[k] = old[i];
+    }
+    vfsPut(off, &table[0], slots * sizeof(VfsDirEntry));
+    if(d.birth==h.epoch) vfsFree(h, d.offset, d.capacity);
+    d.offset = off;
+    d.capacity = slots * sizeof(VfsDirEntry);
+    vfsTxInode(h, dir, d);
+    vfsTxHeader(h);
+    vfsCommit();
+}
+
+/* nowy inode w katalogu dir; wpis w katalogu trafia do biezacej transakcji,
+   node (z juz ustawiona trescia) zapisuje wolajacy razem z naglowkiem */
+unsigned vfsCreate(VfsHeader &h, unsigned dir, const string &name, unsigned type, VfsInode &node){
+    if(h.inodeCount + 1 >= h.inodeCapacity) vfsGrowInodes(h);
+    VfsInode d = vfsInode(dir);
+    if((d.length + 1) * 10 > vfsSlots(d) * 7){
+        vfsGrowDir(h, dir);
+        d = vfsInode(dir);
+    }
+    vfsThaw(h, d, 0);
+    VfsDirEntry e;
+    memset(&e, 0, sizeof e);
+    memcpy(e.name, name.data(), name.size());
+    e.hash = fnv1a(name.data(), name.size());
+    e.inode = ++h.inodeCount;
+    bool found;
+    int slot = vfsProbe(vfsChildren(d), vfsSlots(d), name.data(), name.size(), e.hash, found);
+    vfsTxPut(d.offset + slot * sizeof e, &e, sizeof e);
+    d.length++;
+    vfsTxInode(h, dir, d);
+    node.type = type;
+    node.parent = dir;
+    node.mtime = (unsigned)time(0);
+    if(type==VFS_DIR){
+        node.capacity = VFS_DIR_SLOTS * sizeof(VfsDirEntry);
+        node.offset = vfsAllocZero(h, node.capacity);
+    }
+    searchName(e.inode, dir, name, type==VFS_DIR);
+    return e.inode;
+}
+
+/* --- magazyn blobow ---
+   Indeks: tablica haszujaca id blobow (otwarte adresowanie po hash64),
+   trafienie jest potwierdzane memcmp. Nowy blob zatwierdza sie od razu
+   z refs 0; liczniki podbija dopiero transakcja pliku, ktora go uzywa. */
+void vfsGrowBlobs(VfsHeader &h){
+    unsigned bytes = h.blobCapacity * sizeof(VfsBlob);
+    unsigned off = vfsAllocZero(h, bytes * 2);
+    vfsPut(off, vfsBase() + h.blobOffset, bytes);
+    vfsFree(h, h.blobOffset, bytes);
+    h.blobOffset = off;
+    h.blobCapacity *= 2;
+    vfsTxHeader(h);
+    vfsCommit();
+}
+
+/* indeks 2x wiekszy, bez nagrobkow */
+void vfsRehashIndex(VfsHeader &h){
+    unsigned cap = h.indexCapacity * 2, mask = cap - 1;
+    vector<unsigned> table(cap, 0);
+    h.indexCount = 0;
+    for(unsigned id=1;id<=h.blobCount;id++){
+        const VfsBlob &b = vfsBlob(id);
+        if(!b.offset) continue;
+        unsigned i = b.hashLo & mask;
+        while(table[i]) i = (i + 1) & mask;
+        table[i] = id;
+        h.indexCount++;
+    }
+    unsigned off = vfsAlloc(h, cap * sizeof(unsigned));
+    vfsPut(off, &table[0], cap * sizeof(unsigned));
+    vfsFree(h, h.indexOffset, h.indexCapacity * sizeof(unsigned));
+    h.indexOffset = off;
+    h.indexCapacity = cap;
+    vfsTxHeader(h);
+    vfsCommit();
+}
+
+unsigned vfsBlobFind(const VfsHeader &h, unsigned long long hash, const char *data, size_t len){
+    const unsigned *ix = vfsIndex();
+    unsigned mask = h.indexCapacity - 1;
+    for(unsigned i=(unsigned)hash & mask; ix[i]; i=(i+1) & mask){
+        if(ix[i]==VFS_TOMB) continue;
+        const VfsBlob &b = vfsBlob(ix[i]);
+        if(b.hashLo==(unsigned)hash && b.hashHi==(unsigned)(hash >> 32) && b.length==len &&
+           memcmp(vfsBase() + b.offset, data, len)==0) return ix[i];
+    }
+    return 0;
+}
+
+/* id bloba z ta trescia. extent!=0: tresc juz lezy w tym extencie
+   (data wskazuje w obraz) i nowy blob go przejmuje bez kopiowania;
+   przy extent==0 data nie moze wskazywac w obraz (moze sie przemapowac) */
+unsigned vfsBlobIntern(VfsHeader &h, const char *data, size_t len, unsigned extent){
+    unsigned long long hash = hash64(data, len);
+    unsigned id = vfsBlobFind(h, hash, data, len);
+    if(id){ vfsFreeLater(extent, vfsRound(len)); return id; }
+    if(!h.blobFree && h.blobCount + 1 >= h.blobCapacity) vfsGrowBlobs(h);
+    if((h.indexCount + 1) * 10 > h.indexCapacity * 7) vfsRehashIndex(h);
+    if(!extent){
+        extent = vfsAlloc(h, vfsRound(len));
+        vfsPut(extent, data, len);
+    }
+    VfsBlob b;
+    b.hashLo = (unsigned)hash;
+    b.hashHi = (unsigned)(hash >> 32);
+    b.offset = extent;
+    b.length = (unsigned)len;
+    b.refs = 0;
+    b.next = 0;
+    if(h.blobFree){ id = h.blobFree; h.blobFree = vfsBlob(id).next; }
+    else id = ++h.blobCount;
+    const unsigned *ix = vfsIndex();
+    unsigned mask = h.indexCapacity - 1, slot = (unsigned)hash & mask;
+    while(ix[slot] && ix[slot]!=VFS_TOMB) slot = (slot + 1) & mask;
+    if(!ix[slot]) h.indexCount++;
+    vfsTxPut(h.blobOffset + id * sizeof b, &b, sizeof b);
+    vfsTxPut(h.indexOffset + slot * sizeof(unsigned), &id, sizeof id);
+    vfsTxHeader(h);
+    vfsCommit();
+    return id;
+}
+
+/* zmiana licznika odwolan; blob bez odwolan oddaje extent, slot indeksu i id */
+void vfsBlobRef(VfsHeader &h, unsigned id, int delta){
+    VfsBlob b = vfsBlob(id);
+    b.refs += delta;
+    if(b.refs==0){
+        const unsigned *ix = vfsIndex();
+        unsigned mask = h.indexCapacity - 1;
+        for(unsigned i=b.hashLo & mask; ix[i]; i=(i+1) & mask)
+            if(ix[i]==id){ vfsTxPut(h.indexOffset + i * sizeof(unsigned), &VFS_TOMB, sizeof VFS_TOMB); break; }
+        vfsFreeLater(b.offset, vfsRound(b.length));
+        b.offset = b.length = 0;
+        b.next = h.blobFree;
+        h.blobFree = id;
+    }
+    vfsTxPut(h.blobOffset + id * sizeof b, &b, sizeof b);
+}
+
+/* --- tresc pliku ---
+   Extent inode'u to tablica id blobow, odczyt od offsetu to dzielenie.
+   Dopisywanie idzie przez prywatny ogon: niepelny ostatni kawalek zyje
+   poza magazynem i trafia do niego (przejety bez kopiowania) dopiero,
+   gdy sie zapelni, wiec dopisanie linii nie haszuje calego kawalka. */
+
+/* ids do tablicy od pozycji base; tablica jest przenoszona, gdy brakuje
+   miejsca albo base nadpisalby wpis zatwierdzonej wersji pliku */
+void vfsTableAppend(VfsHeader &h, VfsInode &node, unsigned base, unsigned committed, const vector<unsigned> &ids){
+    if(ids.empty()) return;
+    unsigned need = (base + (unsigned)ids.size()) * sizeof(unsigned);
+    if(need > node.capacity || base < committed){
+        unsigned cap = vfsRound(max(need, node.capacity * 2));
+        unsigned off = vfsAlloc(h, cap);
+        vfsPut(off, vfsBase() + node.offset, base * sizeof(unsigned));
+        vfsFreeLater(node.offset, node.capacity);
+        node.offset = off;
+        node.capacity = cap;
+    }
+    vfsPut(node.offset + base * sizeof(unsigned), &ids[0], ids.size() * sizeof(unsigned));
+}
+
+void vfsAppendBody(VfsHeader &h, VfsInode &node, const char *data, size_t len, map<unsigned,int> &refs){
+    unsigned committed = vfsSealed(node), base = committed;
+    unsigned part = node.length % VFS_CHUNK;
+    if(part && !node.tail && len){
+        /* niepelny blob z pelnego zapisu wraca do prywatnego ogona */
+        unsigned id = vfsChunks(node)[committed - 1];
+        node.tail = vfsAlloc(h, VFS_CHUNK);
+        vfsPut(node.tail, vfsBase() + vfsBlob(id).offset, part);
+        refs[id]--;
+        base--;
+    }
+    vector<unsigned> ids;
+    while(len){
+        if(!node.tail) node.tail = vfsAlloc(h, VFS_CHUNK);
+        part = node.length % VFS_CHUNK;
+        size_t k = min(len, (size_t)(VFS_CHUNK - part));
+        vfsPut(node.tail + part, data, k);
+        node.length += (unsigned)k;
+        data += k; len -= k;
+        if(node.length % VFS_CHUNK==0){
+            vfsSync();
+            unsigned id = vfsBlobIntern(h, vfsBase() + node.tail, VFS_CHUNK, node.tail);
+            ids.push_back(id);
+            refs[id]++;
+            node.tail = 0;
+        }
+    }
+    vfsTableAppend(h, node, base, committed, ids);
+}
+
+void vfsWriteBody(VfsHeader &h, VfsInode &node, const char *data, size_t len, map<unsigned,int> &refs){
+    vector<unsigned> ids;
+    for(size_t off=0; off<len; off+=VFS_CHUNK){
+        unsigned id = vfsBlobIntern(h, data + off, min(len - off, (size_t)VFS_CHUNK), 0);
+        ids.push_back(id);
+        refs[id]++;
+    }
+    node.offset = node.capacity = node.tail = 0;
+    node.length = (unsigned)len;
+    vfsTableAppend(h, node, 0, 0, ids);
+}
+
+void vfsReleaseBody(const VfsInode &node, map<unsigned,int> &refs){
+    const unsigned *ids = vfsChunks(node);
+    for(unsigned i=0;i<vfsSealed(node);i++) refs[ids[i]]--;
+    vfsFreeLater(node.tail, VFS_CHUNK);
+    vfsFreeLater(node.offset, node.capacity);
+}
+
+/* jak vfsStream, ale do bufora; zwraca liczbe skopiowanych bajtow */
+size_t vfsRead(const VfsInode &f, size_t off, size_t len, char *out){
+    if(off >= f.length) return 0;
+    len = min(len, (size_t)f.length - off);
+    const unsigned *ids = vfsChunks(f);
+    unsigned sealed = vfsSealed(f);
+    for(size_t done=0; done<len; ){
+        size_t i = (off + done) / VFS_CHUNK, in = (off + done) % VFS_CHUNK, k = min(len - done, (size_t)VFS_CHUNK - in);
+        memcpy(out + done, vfsBase() + (i < sealed ? vfsBlob(ids[i]).offset : f.tail) + in, k);
+        done += k;
+    }
+    return len;
+}
+
+/* cala tresc w jednym kawalku pamieci: jeden kawalek prosto z mapowania,
+   wiecej skladane w buf */
+const char *vfsView(const VfsInode &f, string &buf){
+    if(f.length <= VFS_CHUNK && (f.tail || f.length==0))
+        return f.length ? vfsBase() + f.tail : "";
+    if(f.length <= VFS_CHUNK) return vfsBase() + vfsBlob(vfsChunks(f)[0]).offset;
+    buf.resize(f.length);
+    vfsRead(f, 0, f.length, &buf[0]);
+    return buf.data();
+}
+
+/* Tresc powstaje przed wpisem w katalogu: nowe bloby zatwierdzaja sie
+   same, zanim zacznie sie zbierac transakcja pliku. Extenty zastapione
+   w tej operacji sa zwalniane dopiero razem z nia. */
+bool vfsStore(const string &path, const char *data, size_t len, bool append){
+    if(len > VFS_MAX_FILE || !vfsBase()) return false;
+    VfsHeader h = vfsHeader();
+    VfsInode node;
+    memset(&node, 0, sizeof node);
+    string base;
+    unsigned dir = 0, ino = vfsWalk(path);
+    if(ino){
+        node = vfsInode(ino);
+        if(node.type!=VFS_FILE) return false;
+    } else {
+        dir = vfsWalkParent(path, base);
+        if(!dir || !vfsValidName(base)) return false;
+    }
+    if(append && node.length + len > VFS_MAX_FILE) return false;
+    char seam[2];
+    size_t seamLen = append ? vfsRead(node, node.length < 2 ? 0 : node.length - 2, 2, seam) : 0;
+    map<unsigned,int> refs;
+    if(ino) vfsThaw(h, node, &refs);
+    if(append) vfsAppendBody(h, node, data, len, refs);
+    else {
+        vfsReleaseBody(node, refs);
+        vfsWriteBody(h, node, data, len, refs);
+    }
+    if(!ino) ino = vfsCreate(h, dir, base, VFS_FILE, node);
+    for(map<unsigned,int>::iterator it=refs.begin(); it!=refs.end(); ++it)
+        if(it->second) vfsBlobRef(h, it->first, it->second);
+    vfsFreeDeferred(h);
+    node.mtime = (unsigned)time(0);
+    vfsTxInode(h, ino, node);
+    vfsTxHeader(h);
+    vfsCommit();
+    searchText(ino, string(seam, seamLen), data, len, append);
+    return true;
+}
+
+/* len bajtow od off prosto z mapowania, kawalek po kawalku */
+void vfsStream(const VfsInode &f, size_t off, size_t len, ostream &out){
+    if(off >= f.length) return;
+    len = min(len, (size_t)f.length - off);
+    const unsigned *ids = vfsChunks(f);
+    unsigned sealed = vfsSealed(f);
+    while(len){
+        size_t i = off / VFS_CHUNK, in = off % VFS_CHUNK, k = min(len, (size_t)VFS_CHUNK - in);
+        const char *p = vfsBase() + (i < sealed ? vfsBlob(ids[i]).offset : f.tail);
+        out.write(p + in, k);
+        off += k; len -= k;
+    }
+}
+
+bool vfsWrite(const string &path, const string &text){ return vfsStore(path, text.data(), text.size(), false); }
+bool vfsAppend(const string &path, const string &text){ return vfsStore(path, text.data(), text.size(), true); }
+
+bool vfsMkdir(const string &path){
+    string base;
+    unsigned dir = vfsWalkParent(path, base);
+    if(!dir || !vfsValidName(base) || vfsChild(dir, base.data(), base.size())) return false;
+    VfsHeader h = vfsHeader();
+    VfsInode node;
+    memset(&node, 0, sizeof node);
+    unsigned ino = vfsCreate(h, dir, base, VFS_DIR, node);
+    vfsTxInode(h, ino, node);
+    vfsTxHeader(h);
+    vfsCommit();
+    return true;
+}
+
+/* --- migawki --- */
+int vfsFindSnapshot(const string &name){
+    for(unsigned i=0;i<vfsHeader().snapCount;i++)
+        if(name==vfsSnapshots()[i].name) return (int)i;
+    return -1;
+}
+
+/* bitmapa zajetosci obrazu w granulach VFS_ALIGN (dla vfsCollect) */
+struct VfsBitmap {
+    vector<unsigned> bits;
+    bool test(unsigned off) const { unsigned g = off / VFS_ALIGN; return (bits[g >> 5] >> (g & 31)) & 1; }
+    void mark(unsigned off, unsigned cap){
+        if(!off || !cap) return;
+        for(unsigned g=off/VFS_ALIGN, e=(off + cap + VFS_ALIGN - 1)/VFS_ALIGN; g<e; g++) bits[g >> 5] |= 1u << (g & 31);
+    }
+};
+
+/* Odzyskanie miejsca po drzewach, ktorych nie widac z zadnego korzenia
+   (biezacego i migawek): liczniki blobow i lista wolnych extentow sa
+   liczone od nowa z tego, co osiagalne. Koszt zalezy od metadanych,
+   nie od tresci plikow. */
+void vfsCollect(VfsHeader &h){
+    VfsBitmap used;
+    used.bits.assign(h.dataEnd / VFS_ALIGN / 32 + 1, 0);
+    vector<unsigned> refs(h.blobCount + 1, 0);
+    used.mark(h.blobOffset, h.blobCapacity * sizeof(VfsBlob));
+    used.mark(h.indexOffset, h.indexCapacity * sizeof(unsigned));
+    used.mark(h.snapOffset, VFS_MAX_SNAPSHOTS * sizeof(VfsSnapshot));
+    const VfsSnapshot *snaps = vfsSnapshots();
+    for(unsigned r=0;r<=h.snapCount;r++){
+        unsigned off = r < h.snapCount ? snaps[r].inodeOffset : h.inodeOffset;
+        unsigned cap = r < h.snapCount ? snaps[r].inodeCapacity : h.inodeCapacity;
+        unsigned count = r < h.snapCount ? snaps[r].inodeCount : h.inodeCount;
+        if(used.test(off)) continue;
+        used.mark(off, cap * sizeof(VfsInode));
+        const VfsInode *tab = (const VfsInode*)(vfsBase() + off);
+        for(unsigned i=VFS_ROOT;i<=count;i++){
+            const VfsInode &n = tab[i];
+            unsigned key = n.offset ? n.offset : n.tail;
+            /* wersja wspolna z korzeniem juz przejrzanym liczy sie raz */
+            if(n.type==VFS_NONE || !key || used.test(key)) continue;
+            used.mark(n.offset, n.capacity);
+            if(n.type!=VFS_FILE) continue;
+            used.mark(n.tail, VFS_CHUNK);
+            const unsigned *ids = vfsChunks(n);
+            for(unsigned k=0;k<vfsSealed(n);k++) refs[ids[k]]++;
+        }
+    }
+    for(unsigned id=1;id<=h.blobCount;id++){
+        const VfsBlob &b = vfsBlob(id);
+        if(!b.offset) continue;
+        if(refs[id]) used.mark(b.offset, b.length);
+        if(refs[id]!=b.refs || !refs[id]) vfsBlobRef(h, id, (int)refs[id] - (int)b.refs);
+    }
+    vfsDeferred.clear();
+    unsigned end = h.dataEnd, at = VFS_HEADER_BYTES;
+    h.freeCount = 0;
+    for(unsigned g=VFS_HEADER_BYTES/VFS_ALIGN; g*VFS_ALIGN<end; g++){
+        if(!used.test(g * VFS_ALIGN)) continue;
+        if(g * VFS_ALIGN > at) vfsFree(h, at, g * VFS_ALIGN - at);
+        at = (g + 1) * VFS_ALIGN;
+    }
+    if(at < end) vfsFree(h, at, end - at);
+}
+
+/* O(1): korzen do tablicy migawek i nowa epoka; ta sama nazwa zastepuje migawke */
+bool vfsSnapshot(const string &name){
+    if(name.empty() || name.size() >= sizeof(((VfsSnapshot*)0)->name)) return false;
+    VfsHeader h = vfsHeader();
+    int slot = vfsFindSnapshot(name);
+    if(slot < 0){
+        if(h.snapCount >= VFS_MAX_SNAPSHOTS) return false;
+        slot = (int)h.snapCount++;
+    }
+    VfsSnapshot s;
+    memset(&s, 0, sizeof s);
+    memcpy(s.name, name.data(), name.size());
+    s.inodeOffset = h.inodeOffset;
+    s.inodeCapacity = h.inodeCapacity;
+    s.inodeCount = h.inodeCount;
+    s.epoch = h.epoch;
+    s.time = (unsigned)time(0);
+    bool replaced = slot < (int)vfsHeader().snapCount;
+    h.epoch++;
+    vfsTxPut(h.snapOffset + slot * sizeof s, &s, sizeof s);
+    vfsTxHeader(h);
+    vfsCommit();
+    if(replaced){
+        /* poprzednie drzewo tej nazwy moglo zostac bez korzenia */
+        vfsCollect(h);
+        vfsTxHeader(h);
+        vfsCommit();
+    }
+    return true;
+}
+
+/* biezace drzewo wraca do migawki (ktora zostaje na kolejne rollbacki) */
+bool vfsRollback(const string &name){
+    int slot = vfsFindSnapshot(name);
+    if(slot < 0) return false;
+    const VfsSnapshot &s = vfsSnapshots()[slot];
+    VfsHeader h = vfsHeader();
+    h.inodeOffset = s.inodeOffset;
+    h.inodeCapacity = s.inodeCapacity;
+    h.inodeCount = s.inodeCount;
+    h.inodeEpoch = s.epoch;
+    h.epoch++;
+    vfsCollect(h);
+    vfsTxHeader(h);
+    vfsCommit();
+    vfsDcacheClear();
+    vfsCwd = VFS_ROOT;
+    vfsCwdPath = "/";
+    searchDrop();
+    regLoad();
+    return true;
+}
+
+void vfsFormat(){
+    VfsHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, VFS_MAGIC, 8);
+    h.version = 4;
+    h.inodeOffset = VFS_HEADER_BYTES;
+    h.inodeCapacity = VFS_INODES_INITIAL;
+    h.inodeCount = VFS_ROOT;
+    unsigned rootTable = h.inodeOffset + VFS_INODES_INITIAL * sizeof(VfsInode);
+    h.blobOffset = rootTable + VFS_DIR_SLOTS * sizeof(VfsDirEntry);
+    h.blobCapacity = VFS_BLOBS_INITIAL;
+    h.indexOffset = vfsRound(h.blobOffset + VFS_BLOBS_INITIAL * sizeof(VfsBlob));
+    h.indexCapacity = VFS_INDEX_INITIAL;
+    h.snapOffset = h.indexOffset + VFS_INDEX_INITIAL * sizeof(unsigned);
+    h.dataEnd = h.snapOffset + VFS_MAX_SNAPSHOTS * sizeof(VfsSnapshot);
+    vfsReserve(h.dataEnd);
+    vector<char> zero(h.dataEnd - VFS_HEADER_BYTES, 0);
+    vfsPut(VFS_HEADER_BYTES, &zero[0], zero.size());
+    VfsInode root;
+    memset(&root, 0, sizeof root);
+    root.type = VFS_DIR;
+    root.parent = VFS_ROOT;
+    root.offset = rootTable;
+    root.capacity = VFS_DIR_SLOTS * sizeof(VfsDirEntry);
+    root.mtime = (unsigned)time(0);
+    vfsPut(h.inodeOffset + VFS_ROOT * sizeof(VfsInode), &root, sizeof root);
+    vfsPut(0, &h, sizeof h);
+    if(vfsOnDisk) fflush(vfsFile);
+}
+
+void initFS(){
+    searchDrop();
+    vfsDcacheClear();
+    vfsCwd = VFS_ROOT;
+    vfsCwdPath = "/";
+    vfsOnDisk = false;
+    if(ensureDataDir()){
+        string path = dataPath("vfs.img");
+        vfsFile = fopen(path.c_str(), "r+b");
+        if(vfsFile && mapFile(path, vfsMap) && vfsMap.size > 0 && memcmp(vfsMap.data, VFS_MAGIC, 8)!=0){
+            /* obraz w innym formacie zostaje obok, razem z jego dziennikiem nie jest odtwarzany */
+            fclose(vfsFile);
+            unmapFile(vfsMap);
+            string old = path + ".old";
+            remove(old.c_str());
+            rename(path.c_str(), old.c_str());
+            vfsResetJournal();
+            logEvent(LOG_WARN, "Filesystem image not recognized, moved to %s", "vfs.img.old");
+            vfsFile = fopen(path.c_str(), "w+b");
+        }
+        if(!vfsFile) vfsFile = fopen(path.c_str(), "w+b");
+        if(vfsFile && mapFile(path, vfsMap)){
+            vfsOnDisk = true;
+            int replayed = vfsReplayJournal();
+            if(replayed){
+                char n[16]; sprintf(n, "%d", replayed);
+                logEvent(LOG_WARN, "Filesystem journal replayed: %s transactions", n);
+            }
+            vfsResetJournal();
+        }
+    }
+    if(!vfsImageValid()){
+        vfsFormat();
+        vfsWrite("/readme.txt",
+            "VireonOS Beta\n"
+            "This is a simulated OS environment.\n");
+        vfsWrite("/about.txt",
+            "VireonOS Beta - Combined demo executable for Dev-C++ 5.11.\nContact: fake@vireonos.dev\n");
+        vfsWrite("/notes.txt", "Initial notes...\n");
+    }
+    addLog("Filesystem initialized");
+}
+
+void closeFS(){
+    if(vfsFile) fclose(vfsFile);
+    if(vfsJournal) fclose(vfsJournal);
+    vfsFile = vfsJournal = 0;
+}
+
+void ls(const string &path){ 
+    string canon;
+    unsigned ino = vfsWalk(path, &canon);
+    if(!ino || vfsInode(ino).type!=VFS_DIR){ cout<<"\nNo such directory: "<<path<<"\n\n"; return; }
+    setColor(11); 
+    cout<<"\nFiles in "<<canon<<":\n";
+    const VfsInode &d = vfsInode(ino);
+    const VfsDirEntry *tab = vfsChildren(d);
+    vector<string> names;
+    names.reserve(d.length);
+    for(unsigned i=0;i<vfsSlots(d);i++){
+        if(!tab[i].inode) continue;
+        names.push_back(tab[i].name);
+        if(vfsInode(tab[i].inode).type==VFS_DIR) names.back() += "/";
+    }
+    sort(names.begin(), names.end());
+    for(size_t i=0;i<names.size();i++)
+        cout<<" - "<<names[i]<<"\n"; 
+    setColor(7); 
+    cout<<"\n"; 
+}
+
+/* cat FILE [OFFSET [LENGTH]]: liczby na koncu to zakres bajtow */
+void cat(const string &args){
+    string f = args;
+    size_t range[2] = { 0, (size_t)-1 };
+    vector<size_t> nums;
+    while(nums.size() < 2){
+        size_t sp = f.find_last_of(' ');
+        if(sp==string::npos || f.find_last_not_of(' ', sp)==string::npos) break;
+        string tok = f.substr(sp + 1);
+        if(tok.empty() || tok.find_first_not_of("0123456789")!=string::npos) break;
+        nums.insert(nums.begin(), (size_t)strtoul(tok.c_str(), 0, 10));
+        f.erase(f.find_last_not_of(' ', sp) + 1);
+    }
+    for(size_t i=0;i<nums.size();i++) range[i] = nums[i];
+    unsigned ino = vfsWalk(f);
+    if(ino && vfsInode(ino).type==VFS_FILE){
+        cout<<"\n";
+        vfsStream(vfsInode(ino), range[0], range[1], cout);
+        cout<<"\n";
+    }
+    else if(ino) cout<<"\nIs a directory: "<<f<<"\n";
+    else cout<<"\nFile not found: "<<f<<"\n";
+    cout<<"\n";
+}
+
+void touch(const string &f){ 
+    if(vfsWalk(f)){
+        cout<<"\nFile already exists: "<<f<<"\n\n";
+    } else if(vfsWrite(f, "")){
+        logEvent(LOG_INFO, "File created: %s", f.c_str());
+        cout<<"\nCreated file: "<<f<<"\n\n";
+    } else {
+        cout<<"\nInvalid file name: "<<f<<"\n\n";
+    }
+}
+
+void writeFile(const string &f){
+    cin.ignore();
+    string t;
+    cout<<"Enter text (single line will be saved): ";
+    getline(cin,t);
+    if(!vfsWrite(f, t)){ cout<<"Cannot write file: "<<f<<"\n\n"; return; }
+    logEvent(LOG_INFO, "File written: %s", f.c_str());
+    cout<<"Saved.\n\n";
+}
+
+void makeDir(const string &path){
+    if(!vfsMkdir(path)){ cout<<"\nCannot create directory: "<<path<<"\n\n"; return; }
+    logEvent(LOG_INFO, "Directory created: %s", path.c_str());
+    cout<<"\nCreated directory: "<<path<<"\n\n";
+}
+
+void changeDir(const string &path){
+    string canon;
+    unsigned ino = vfsWalk(path.empty() ? "/" : path, &canon);
+    if(!ino || vfsInode(ino).type!=VFS_DIR){ cout<<"No such directory: "<<path<<"\n\n"; return; }
+    vfsCwd = ino;
+    vfsCwdPath = canon;
+}
+
+void takeSnapshot(const string &name){
+    long long t0 = nowMicros();
+    if(!vfsSnapshot(name)){
+        cout<<"\nCannot create snapshot: "<<name<<" (name up to 31 chars, at most "<<VFS_MAX_SNAPSHOTS<<" snapshots)\n\n";
+        return;
+    }
+    logEvent(LOG_INFO, "Snapshot created: %s", name.c_str());
+    char ms[48];
+    sprintf(ms, " (%.3f ms)\n\n", (nowMicros() - t0) / 1000.0);
+    cout<<"\nSnapshot saved: "<<name<<ms;
+}
+
+void listSnapshots(){
+    const VfsHeader &h = vfsHeader();
+    setColor(11);
+    cout<<"\n--- Snapshots ---\n";
+    if(!h.snapCount) cout<<" (none)\n";
+    for(unsigned i=0;i<h.snapCount;i++){
+        const VfsSnapshot &s = vfsSnapshots()[i];
+        const VfsInode *tab = (const VfsInode*)(vfsBase() + s.inodeOffset);
+        unsigned files = 0;
+        for(unsigned k=VFS_ROOT;k<=s.inodeCount;k++) if(tab[k].type==VFS_FILE) files++;
+        time_t when = (time_t)s.time;
+        struct tm *lt = localtime(&when);
+        char buf[128];
+        sprintf(buf," %c %-24s %04d-%02d-%02d %02d:%02d  %u files\n", s.inodeOffset==h.inodeOffset ? '*' : ' ',
+                s.name, lt->tm_year + 1900, lt->tm_mon + 1, lt->tm_mday, lt->tm_hour, lt->tm_min, files);
+        cout<<buf;
+    }
+    cout<<"\n";
+    setColor(7);
+}
+
+void rollbackTo(const string &name){
+    long long t0 = nowMicros();
+    if(!vfsRollback(name)){ cout<<"\nNo such snapshot: "<<name<<"\n\n"; return; }
+    logEvent(LOG_WARN, "Filesystem rolled back to %s", name.c_str());
+    char ms[48];
+    sprintf(ms, " (%.3f ms)\n\n", (nowMicros() - t0) / 1000.0);
+    cout<<"\nRolled back to "<<name<<ms;
+}
+
+/* df: bajty logiczne plikow wobec bajtow faktycznie zajetych w obrazie */
+void diskFree(){
+    const VfsHeader &h = vfsHeader();
+    double logical = 0, tails = 0, unique = 0, refs = 0;
+    unsigned files = 0, dirs = 0, blobs = 0;
+    for(unsigned i=VFS_ROOT;i<=h.inodeCount;i++){
+        const VfsInode &f = vfsInode(i);
+        if(f.type==VFS_DIR) dirs++;
+        if(f.type!=VFS_FILE) continue;
+        files++;
+        logical += f.length;
+        if(f.tail) tails += f.length % VFS_CHUNK;
+    }
+    for(unsigned id=1;id<=h.blobCount;id++){
+        const VfsBlob &b = vfsBlob(id);
+        if(!b.offset) continue;
+        blobs++;
+        unique += b.length;
+        refs += b.refs;
+    }
+    double stored = unique + tails;
+    char buf[160];
+    setColor(11);
+    cout<<"\n--- Disk ---\n";
+    sprintf(buf," Files            : %u in %u directories\n", files, dirs); cout<<buf;
+    sprintf(buf," Logical bytes    : %.0f\n", logical); cout<<buf;
+    sprintf(buf," Stored bytes     : %.0f (%.0f in %u unique chunks, %.0f in open tails)\n",
+            stored, unique, blobs, tails); cout<<buf;
+    sprintf(buf," Chunk references : %.0f, dedup ratio %.2fx\n", refs, stored > 0 ? logical / stored : 1.0); cout<<buf;
+    if(h.snapCount){ sprintf(buf," Snapshots        : %u (their chunks count as stored)\n", h.snapCount); cout<<buf; }
+    sprintf(buf," Image            : %u of %lu bytes used, %u free extents%s\n\n",
+            h.dataEnd, (unsigned long)vfsSize(), h.freeCount, vfsOnDisk ? "" : " (in memory)"); cout<<buf;
+    setColor(7);
+}
+
+/* ===============================
+   SEARCH (grep / find)
+   Indeks odwrocony trigramow: trigram (3 bajty, male litery) -> rosnaca
+   lista inode'ow, osobno dla tresci plikow i dla nazw. Zapytanie bierze
+   przeciecie list trigramow szukanego tekstu, a tylko te pliki sa
+   skanowane (SSE2: porownanie 16 pozycji naraz). Wzorzec z . * ^ $
+   jest wyrazeniem: z indeksu idzie jego najdluzszy staly fragment,
+   reszte sprawdza matcher na kandydackich liniach.
+
+   Indeks powstaje leniwie przy pierwszym zapytaniu (start go nie
+   kosztuje), potem vfsCreate i vfsStore aktualizuja go na biezaco:
+   dopisanie do pliku dodaje tylko trigramy nowego fragmentu.
+   Pliki binarne (z bajtem 0) i wieksze niz SEARCH_INDEX_MAX nie trafiaja
+   do indeksu: grep zawsze je skanuje.
+=============================== */
+struct SearchEntry {
+    unsigned parent;
+    string name;
+    bool dir;
+    vector<unsigned> grams;             // trigramy tresci, posortowane
+    size_t bytes;                       // dlugosc tresci
+    bool scan;                          // poza indeksem, grep skanuje zawsze
+    SearchEntry(): parent(0), dir(false), bytes(0), scan(false) {}
+};
+
+typedef map<unsigned, vector<unsigned> > Postings;
+
+bool searchReady = false;
+vector<SearchEntry> searchFiles;        // po numerze inode'u
+Postings searchContent, searchNames;
+vector<unsigned char> searchSeen;       // bitmapa 2^24 trigramow (deduplikacja)
+set<unsigned> searchScanned;            // pliki z flaga scan
+
+const size_t SEARCH_INDEX_MAX = 8u << 20;
+
+const size_t SEARCH_SHOW = 100;         // tyle wynikow wypisujemy
+
+inline unsigned char searchFold(unsigned char c){ return c>='A' && c<='Z' ? c + 32 : c; }
+
+/* rozne trigramy tekstu (po zlozeniu wielkosci liter), posortowane */
+void searchGrams(const char *p, size_t n, vector<unsigned> &out){
+    out.clear();
+    if(n < 3) return;
+    if(searchSeen.empty()) searchSeen.resize(1u << 21, 0);
+    unsigned g = (searchFold(p[0]) << 8) | searchFold(p[1]);
+    for(size_t i=2;i<n;i++){
+        g = ((g << 8) | searchFold(p[i])) & 0xFFFFFFu;
+        unsigned char &bit = searchSeen[g >> 3];
+        if(bit & (1 << (g & 7))) continue;
+        bit |= (unsigned char)(1 << (g & 7));
+        out.push_back(g);
+    }
+    for(size_t i=0;i<out.size();i++) searchSeen[out[i] >> 3] = 0;
+    sort(out.begin(), out.end());
+}
+
+void searchPost(Postings &p, unsigned g, unsigned ino){
+    vector<unsigned> &v = p[g];
+    if(v.empty() || v.back() < ino){ v.push_back(ino); return; }
+    vector<unsigned>::iterator it = lower_bound(v.begin(), v.end(), ino);
+    if(*it!=ino) v.insert(it, ino);
+}
+
+void searchUnpost(Postings &p, unsigned g, unsigned ino){
+    Postings::iterator pit = p.find(g);
+    if(pit==p.end()) return;
+    vector<unsigned> &v = pit->second;
+    vector<unsigned>::iterator it = lower_bound(v.begin(), v.end(), ino);
+    if(it!=v.end() && *it==ino) v.erase(it);
+    if(v.empty()) p.erase(pit);
+}
+
+SearchEntry &searchEntry(unsigned ino){
+    if(ino >= searchFiles.size()) searchFiles.resize(ino + 1 + ino / 2);
+    return searchFiles[ino];
+}
+
+/* hak z vfsCreate: nowy plik albo katalog */
+void searchName(unsigned ino, unsigned dir, const string &name, bool isDir){
+    if(!searchReady) return;
+    SearchEntry &e = searchEntry(ino);
+    e.parent = dir;
+    e.name = name;
+    e.dir = isDir;
+    e.grams.clear();
+    e.bytes = 0;
+    e.scan = false;
+    searchScanned.erase(ino);
+    vector<unsigned> g;
+    searchGrams(name.data(), name.size(), g);
+    for(size_t i=0;i<g.size();i++) searchPost(searchNames, g[i], ino);
+}
+
+/* hak z vfsStore: seam to ostatnie bajty pliku sprzed dopisania */
+void searchText(unsigned ino, const string &seam, const char *data, size_t len, bool append){
+    if(!searchReady) return;
+    SearchEntry &e = searchEntry(ino);
+    vector<unsigned> g;
+    e.bytes = append ? e.bytes + len : len;
+    if(!append && e.scan){ e.scan = false; searchScanned.erase(ino); }
+    if(e.scan) return;
+    if(e.bytes > SEARCH_INDEX_MAX || memchr(data, 0, len)){
+        /* binarny albo za duzy: trigramow byloby bez liku, skan jest tanszy */
+        for(size_t i=0;i<e.grams.size();i++) searchUnpost(searchContent, e.grams[i], ino);
+        vector<unsigned>().swap(e.grams);
+        e.scan = true;
+        searchScanned.insert(ino);
+        return;
+    }
+    if(!append){
+        for(size_t i=0;i<e.grams.size();i++) searchUnpost(searchContent, e.grams[i], ino);
+        searchGrams(data, len, e.grams);
+        for(size_t i=0;i<e.grams.size();i++) searchPost(searchContent, e.grams[i], ino);
+        return;
+    }
+    string s = seam;
+    s.append(data, len);
+    searchGrams(s.data(), s.size(), g);
+    size_t old = e.grams.size();
+    for(size_t i=0;i<g.size();i++){
+        if(binary_search(e.grams.begin(), e.grams.begin() + old, g[i])) continue;
+        e.grams.push_back(g[i]);
+        searchPost(searchContent, g[i], ino);
+    }
+    if(e.grams.size() > old) inplace_merge(e.grams.begin(), e.grams.begin() + old, e.grams.end());
+}
+
+void searchIndexDir(unsigned dir){
+    const VfsInode &d = vfsInode(dir);
+    const VfsDirEntry *tab = vfsChildren(d);
+    string buf;
+    for(unsigned i=0;i<vfsSlots(d);i++){
+        unsigned ino = tab[i].inode;
+        if(!ino) continue;
+        const VfsInode &f = vfsInode(ino);
+        searchName(ino, dir, tab[i].name, f.type==VFS_DIR);
+        if(f.type==VFS_DIR) searchIndexDir(ino);
+        else searchText(ino, "", vfsView(f, buf), f.length, false);
+    }
+}
+
+void searchBuild(){
+    if(searchReady) return;
+    long long t0 = nowMicros();
+    searchFiles.clear();
+    searchContent.clear();
+    searchNames.clear();
+    searchScanned.clear();
+    searchReady = true;
+    SearchEntry &root = searchEntry(VFS_ROOT);
+    root.parent = 0;
+    root.dir = true;
+    searchIndexDir(VFS_ROOT);
+    char ms[32];
+    sprintf(ms, "%.1f", (nowMicros() - t0) / 1000.0);
+    logEvent(LOG_INFO, "Search index built in %s ms", ms);
+}
+
+void searchDrop(){
+    searchReady = false;
+    searchScanned.clear();
+    searchFiles.clear();
+    searchContent.clear();
+    searchNames.clear();
+}
+
+string searchPath(unsigned ino){
+    if(ino==VFS_ROOT || !ino) return "/";
+    const SearchEntry &e = searchFiles[ino];
+    string p = searchPath(e.parent);
+    if(p!="/") p += "/";
+    return p + e.name;
+}
+
+/* trigramy wszystkich fragmentow (kazdy musi wystapic w trafieniu) */
+void searchGramsOf(const vector<string> &parts, vector<unsigned> &out){
+    vector<unsigned> g;
+    out.clear();
+    for(size_t i=0;i<parts.size();i++){
+        searchGrams(parts[i].data(), parts[i].size(), g);
+        out.insert(out.end(), g.begin(), g.end());
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+/* inode'y zawierajace wszystkie trigramy; false = brak trigramow (za krotkie) */
+bool searchCandidates(const Postings &p, const vector<string> &parts, vector<unsigned> &out){
+    vector<unsigned> g;
+    searchGramsOf(parts, g);
+    out.clear();
+    if(g.empty()) return false;
+    vector<const vector<unsigned>*> lists;
+    for(size_t i=0;i<g.size();i++){
+        Postings::const_iterator it = p.find(g[i]);
+        if(it==p.end()) return true;
+        lists.push_back(&it->second);
+    }
+    /* od najkrotszej listy: kazda nastepna tylko odsiewa */
+    for(size_t i=1;i<lists.size();i++)
+        for(size_t j=i;j>0 && lists[j]->size() < lists[j-1]->size();j--) swap(lists[j], lists[j-1]);
+    out = *lists[0];
+    for(size_t i=1;i<lists.size() && !out.empty();i++){
+        size_t k = 0;
+        for(size_t j=0;j<out.size();j++)
+            if(binary_search(lists[i]->begin(), lists[i]->end(), out[j])) out[k++] = out[j];
+        out.resize(k);
+    }
+    return true;
+}
+
+/* pierwsze wystapienie igly w stogu */
+const char *findBytes(const char *h, size_t n, const char *nd, size_t m){
+    if(m==0) return h;
+    if(m > n) return 0;
+    size_t i = 0;
+#ifdef VIREON_SSE2
+    /* pierwszy i ostatni bajt igly na 16 pozycjach naraz, memcmp tylko przy trafieniu obu */
+    const __m128i first = _mm_set1_epi8(nd[0]), last = _mm_set1_epi8(nd[m-1]);
+    for(; i + m - 1 + 16 <= n; i+=16){
+        __m128i a = _mm_loadu_si128((const __m128i*)(h + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(h + i + m - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        for(unsigned bit=0; mask; bit++, mask>>=1)
+            if((mask & 1) && memcmp(h + i + bit, nd, m)==0) return h + i + bit;
+    }
+#endif
+    while(i + m <= n){
+        const char *p = (const char*)memchr(h + i, nd[0], n - m + 1 - i);
+        if(!p) return 0;
+        if(memcmp(p, nd, m)==0) return p;
+        i = p - h + 1;
+    }
+    return 0;
+}
+
+/* matcher Kernighana-Pike'a: c . * ^ $ */
+bool reMatchHere(const char *re, const char *s, const char *end);
+
+bool reMatchStar(char c, const char *re, const char *s, const char *end){
+    for(;;){
+        if(reMatchHere(re, s, end)) return true;
+        if(s==end || (*s!=c && c!='.')) return false;
+        s++;
+    }
+}
+
+bool reMatchHere(const char *re, const char *s, const char *end){
+    if(!*re) return true;
+    if(re[1]=='*') return reMatchStar(re[0], re + 2, s, end);
+    if(re[0]=='$' && !re[1]) return s==end;
+    if(s < end && (re[0]=='.' || re[0]==*s)) return reMatchHere(re + 1, s + 1, end);
+    return false;
+}
+
+bool reMatch(const string &re, const char *s, const char *end){
+    if(re[0]=='^') return reMatchHere(re.c_str() + 1, s, end);
+    do {
+        if(reMatchHere(re.c_str(), s, end)) return true;
+    } while(s++ < end);
+    return false;
+}
+
+/* fragmenty wyrazenia, ktore musza wystapic doslownie; najdluzszy pierwszy */
+void reLiterals(const string &re, vector<string> &out){
+    string run;
+    out.clear();
+    for(size_t i=0;i<=re.size();i++){
+        char c = i < re.size() ? re[i] : 0;
+        bool lit = c && c!='.' && c!='*' && !(c=='^' && i==0) && !(c=='$' && i+1==re.size());
+        if(lit && !(i + 1 < re.size() && re[i+1]=='*')){ run += c; continue; }
+        if(run.size() > (out.empty() ? 0 : out[0].size())) out.insert(out.begin(), run);
+        else if(!run.empty()) out.push_back(run);
+        run.clear();
+    }
+}
+
+/* fragmenty globu miedzy * i ?; najdluzszy pierwszy */
+void globLiterals(const string &g, vector<string> &out){
+    string run;
+    out.clear();
+    for(size_t i=0;i<=g.size();i++){
+        if(i < g.size() && g[i]!='*' && g[i]!='?'){ run += g[i]; continue; }
+        if(run.size() > (out.empty() ? 0 : out[0].size())) out.insert(out.begin(), run);
+        else if(!run.empty()) out.push_back(run);
+        run.clear();
+    }
+}
+
+/* glob nazw: * i ? */
+bool globMatch(const char *g, const char *s){
+    if(!*g) return !*s;
+    if(*g=='*') return globMatch(g + 1, s) || (*s && globMatch(g, s + 1));
+    return *s && (*g=='?' || *g==*s) && globMatch(g + 1, s + 1);
+}
+
+/* inode lezy w poddrzewie katalogu scope (sciezka kanoniczna) */
+bool searchInScope(unsigned ino, unsigned scope){
+    for(unsigned i=ino; i && i!=VFS_ROOT; i=searchFiles[i].parent)
+        if(i==scope) return true;
+    return scope==VFS_ROOT;
+}
+
+/* grep [-i] WZORZEC: linie plikow pod biezacym katalogiem */
+void grepFiles(const string &args){
+    string pat = args;
+    bool fold = false;
+    if(pat.compare(0, 3, "-i ")==0){ fold = true; pat.erase(0, 3); }
+    if(pat.empty()){ cout<<"\nUsage: grep [-i] TEXT  (. * ^ $ make it a pattern)\n\n"; return; }
+    searchBuild();
+    long long t0 = nowMicros();
+    if(fold) for(size_t i=0;i<pat.size();i++) pat[i] = (char)searchFold(pat[i]);
+    bool regex = pat.find_first_of(".*^$")!=string::npos;
+    vector<string> parts(1, pat);
+    if(regex) reLiterals(pat, parts);
+    string lit = parts.empty() ? "" : parts[0];
+
+    vector<unsigned> cand;
+    if(!searchCandidates(searchContent, parts, cand)){
+        for(unsigned i=VFS_ROOT;i<searchFiles.size();i++)
+            if(!searchFiles[i].name.empty() && !searchFiles[i].dir) cand.push_back(i);
+    } else if(!searchScanned.empty()){
+        cand.insert(cand.end(), searchScanned.begin(), searchScanned.end());
+        sort(cand.begin(), cand.end());
+        cand.erase(unique(cand.begin(), cand.end()), cand.end());
+    }
+
+    vector<string> shown;
+    size_t lines = 0, files = 0;
+    string raw, buf;
+    for(size_t c=0;c<cand.size();c++){
+        if(!searchInScope(cand[c], vfsCwd)) continue;
+        const VfsInode &f = vfsInode(cand[c]);
+        const char *text = vfsView(f, raw), *base = text;
+        if(fold){
+            buf.assign(text, f.length);
+            for(size_t i=0;i<buf.size();i++) buf[i] = (char)searchFold(buf[i]);
+            base = buf.data();
+        }
+        const char *end = base + f.length, *line = base;
+        size_t lineNo = 1, hits = 0;
+        const char *counted = base;
+        while(line < end){
+            const char *at = lit.empty() ? line : findBytes(line, end - line, lit.data(), lit.size());
+            if(!at) break;
+            const char *ls = at;
+            while(ls > line && ls[-1]!='\n') ls--;
+            const char *le = (const char*)memchr(at, '\n', end - at);
+            if(!le) le = end;
+            if(!regex || reMatch(pat, ls, le)){
+                for(const char *p=counted; (p=(const char*)memchr(p, '\n', ls - p))!=0; p++) lineNo++;
+                counted = ls;
+                hits++;
+                if(shown.size() < SEARCH_SHOW){
+                    char num[16];
+                    sprintf(num, ":%lu: ", (unsigned long)lineNo);
+                    shown.push_back(searchPath(cand[c]) + num + string(text + (ls - base), min((size_t)(le - ls), (size_t)160)));
+                }
+            }
+            line = le + 1;
+        }
+        if(hits){ files++; lines += hits; }
+    }
+    long long us = nowMicros() - t0;
+    cout<<"\n";
+    for(size_t i=0;i<shown.size();i++) cout<<shown[i]<<"\n";
+    if(lines > shown.size()) cout<<"... "<<lines - shown.size()<<" more\n";
+    char foot[160];
+    sprintf(foot, "(%lu line(s) in %lu file(s), %lu scanned, %.3f ms)\n\n",
+            (unsigned long)lines, (unsigned long)files, (unsigned long)cand.size(), us / 1000.0);
+    setColor(11);
+    cout<<foot;
+    setColor(7);
+}
+
+/* find [DIR] NAZWA: glob po nazwach plikow i katalogow */
+void findFiles(const string &args){
+    string dir = ".", pat = args;
+    size_t sp = args.find(' ');
+    if(sp!=string::npos){
+        size_t q = args.find_first_not_of(' ', sp);
+        dir = args.substr(0, sp);
+        pat = q==string::npos ? "" : args.substr(q);
+    }
+    if(pat.empty()){ cout<<"\nUsage: find [DIR] NAME  (* and ? match any text / char)\n\n"; return; }
+    unsigned scope = vfsWalk(dir);
+    if(!scope || vfsInode(scope).type!=VFS_DIR){ cout<<"\nNo such directory: "<<dir<<"\n\n"; return; }
+    searchBuild();
+    long long t0 = nowMicros();
+    vector<string> parts;
+    globLiterals(pat, parts);
+    vector<unsigned> cand;
+    if(!searchCandidates(searchNames, parts, cand))
+        for(unsigned i=VFS_ROOT;i<searchFiles.size();i++)
+            if(!searchFiles[i].name.empty()) cand.push_back(i);
+    vector<string> found;
+    size_t total = 0;
+    for(size_t c=0;c<cand.size();c++){
+        const SearchEntry &e = searchFiles[cand[c]];
+        if(cand[c]==scope || !globMatch(pat.c_str(), e.name.c_str()) || !searchInScope(cand[c], scope)) continue;
+        if(++total <= SEARCH_SHOW) found.push_back(searchPath(cand[c]) + (e.dir ? "/" : ""));
+    }
+    long long us = nowMicros() - t0;
+    sort(found.begin(), found.end());
+    cout<<"\n";
+    for(size_t i=0;i<found.size();i++) cout<<found[i]<<"\n";
+    if(total > found.size()) cout<<"... "<<total - found.size()<<" more\n";
+    char foot[128];
+    sprintf(foot, "(%lu match(es), %lu checked, %.3f ms)\n\n",
+            (unsigned long)total, (unsigned long)cand.size(), us / 1000.0);
+    setColor(11);
+    cout<<foot;
+    setColor(7);
+}
+
+/* ===============================
+   PROCESS MANAGER (HTOP-like)
+=============================== */
+vector<int> procStack;       // gora stosu = proces, ktoremu teraz liczymy czas
+long long procMark = 0;      // nowMicros() ostatniego przelaczenia
+long long idleMicros = 0, idleSample = 0;
+long long lastSample = 0;    // nowMicros() poprzedniego htop
+int nextPid = 100;
+
+/* globalne obiekty niszcza sie w odwrotnej kolejnosci: screen (wczesniej
+   w pliku) wypisuje ostatnia klatke juz po procStack i processTable.
+   Ten znacznik gasnie przed nimi i od tej chwili proc* nic nie licza. */
+bool procAlive = true;
+struct ProcTeardown { ~ProcTeardown(){ procAlive = false; } };
+ProcTeardown procTeardown;
+
+Process *findProcess(int pid){
+    for(size_t i=0;i<processTable.size();i++) if(processTable[i].pid==pid) return &processTable[i];
+    return 0;
+}
+
+void procCharge(){
+    if(!procAlive) return;
+    long long now = nowMicros();
+    if(!procStack.empty()){
+        int pid = procStack.back();
+        if(pid==PID_IDLE) idleMicros += now - procMark;
+        else if(Process *p = findProcess(pid)) p->cpuMicros += now - procMark;
+    }
+    procMark = now;
+}
+
+void procEnter(int pid){ if(procAlive){ procCharge(); procStack.push_back(pid); } }
+void procLeave(){ if(procAlive){ procCharge(); if(!procStack.empty()) procStack.pop_back(); } }
+
+void addProcess(int pid, const string &name, const string &cmdline, size_t (*memProbe)()){
+    Process p;
+    p.pid = pid; p.name = name; p.cmdline = cmdline;
+    p.startTime = clockNow();
+    p.cpuMicros = p.sampleCpu = 0;
+    p.memBytes = 0;
+    p.memProbe = memProbe;
+    processTable.push_back(p);
+}
+
+int procSpawn(const string &name, const string &cmdline, size_t (*memProbe)()){
+    int pid = nextPid++;
+    addProcess(pid, name, cmdline, memProbe);
+    return pid;
+}
+
+void procExit(int pid){
+    for(size_t i=0;i<processTable.size();i++)
+        if(processTable[i].pid==pid){ processTable.erase(processTable.begin()+i); return; }
+}
+
+/* sondy pamieci serwisow */
+size_t fsBytes(){ return vfsOnDisk ? vfsMap.size : vfsRam.capacity(); }
+
+size_t stringsBytes(const vector<string> &v){
+    size_t n = v.capacity()*sizeof(string);
+    for(size_t i=0;i<v.size();i++) n += v[i].capacity();
+    return n;
+}
+
+size_t logBytes();
+size_t pageCacheBytes();
+size_t historyBytes();
+size_t gfxBytes(){ return screen.memoryBytes(); }
+size_t registryBytes();
+
+size_t shellBytes(){
+    size_t n = (shellCommands.cmds.capacity() + browserCommands.cmds.capacity()) * sizeof(Command)
+             + (shellCommands.slots.capacity() + browserCommands.slots.capacity()) * sizeof(int);
+    n += historyBytes() + stringsBytes(browserBookmarks) + pageCacheBytes();
+    for(size_t i=0;i<browserTabs.size();i++) n += sizeof(Tab) + browserTabs[i].title.capacity() + browserTabs[i].url.capacity();
+    return n;
+}
+
+void initProcesses(){
+    processTable.clear();
+    addProcess(PID_KERNEL,    "kernel",      "/boot/vireon-kernel", fsBytes);
+    addProcess(PID_SHELL,     "vireonshell", "/bin/vireonshell --login", shellBytes);
+    addProcess(PID_LOGGER,    "logger",      "/bin/logger --service", logBytes);
+    addProcess(PID_INSTALLER, "installer",   "/bin/installer --service", registryBytes);
+    addProcess(PID_NETIF,     "netif",       "/bin/netif --service", 0);
+    addProcess(PID_AUDIO,     "audio",       "/bin/audio --service", 0);
+    addProcess(PID_GFX,       "gfx",         "/bin/gfx --service", gfxBytes);
+    lastSample = procMark = nowMicros();
+    addLog("Processes initialized");
+}
+
+const char *procStateName(const Process &p){
+    for(size_t i=0;i<procStack.size();i++) if(procStack[i]==p.pid) return "running";
+    for(size_t i=0;i<tasks.size();i++)
+        if(tasks[i]->pid==p.pid && tasks[i]->wakeAt <= clockNow()) return "ready";
+    return "sleeping";
+}
+
+/* CPU% liczony z przyrostu zmierzonego czasu od poprzedniego htop */
+void htop(bool verbose){
+    procCharge();
+    long long now = nowMicros();
+    long long window = max(1LL, now - lastSample);
+    size_t memTotal = 0;
+    for(size_t i=0;i<processTable.size();i++){
+        Process &p = processTable[i];
+        if(p.memProbe) p.memBytes = p.memProbe();
+        memTotal += p.memBytes;
+    }
+
+    setColor(10);
+    cout<<"\n+------------------------------------------------------------+\n";
+    cout<<"|               VireonOS Process Monitor (htop)             |\n";
+    cout<<"+------------------------------------------------------------+\n";
+    cout<<"| PID  | NAME         | CPU% |   CPU ms |  MEM KB | STATE    |\n";
+    cout<<"+------------------------------------------------------------+\n";
+    for(size_t i=0;i<processTable.size();i++){
+        Process &p = processTable[i];
+        int cpu = (int)((p.cpuMicros - p.sampleCpu) * 100 / window);
+        char buf[256];
+        sprintf(buf,"| %-4d | %-12.12s | %3d%% | %8.2f | %7.1f | %-8s |",
+                p.pid, p.name.c_str(), cpu, p.cpuMicros/1000.0, p.memBytes/1024.0, procStateName(p));
+        cout<<buf<<"\n";
+        if(verbose){
+            cout<<"    CMD: "<<p.cmdline<<"\n";
+            cout<<"    Uptime: "<<(clockNow()-p.startTime)/1000000<<"s  Started by: root\n";
+        }
+        p.sampleCpu = p.cpuMicros;
+    }
+    cout<<"+------------------------------------------------------------+\n";
+    char buf[128];
+    sprintf(buf," Processes: %d | CPU busy: %d%% | Tracked memory: %.1f KB\n\n",
+            (int)processTable.size(), (int)(100 - (idleMicros - idleSample) * 100 / window), memTotal/1024.0);
+    cout<<buf;
+    idleSample = idleMicros;
+    lastSample = now;
+    setColor(7);
+}
+
+/* ===============================
+   SYSTEM LOGS
+=============================== */
+/* Pierscien LOG_CAPACITY rekordow o stalym rozmiarze, wielu producentow
+   i jeden czytelnik bez blokad. Producent bierze bilet atomicAdd na
+   logHead, slot to bilet & maska; seq nieparzyste = zapis w toku,
+   2*bilet+2 = rekord gotowy. Zapisuje sie tylko id formatu (wskaznik
+   literalu internowany w logFormats), poziom, czas i argumenty %s;
+   tekst sklada dopiero showLogs. Najstarsze wpisy sa nadpisywane. */
+const unsigned LOG_CAPACITY = 4096;     // potega dwojki
+const unsigned LOG_MAX_FORMATS = 512;   // potega dwojki
+const unsigned LOG_ARG_BYTES = 48;
+
+struct LogRecord {
+    volatile unsigned seq;
+    unsigned short msgId;
+    unsigned char level;
+    unsigned char nargs;
+    long long when;                 // time(0) w chwili zapisu
+    char args[LOG_ARG_BYTES];       // argumenty, kazdy zakonczony '\0'
+};
+
+LogRecord logRing[LOG_CAPACITY];
+volatile unsigned logHead = 0;
+const char * volatile logFormats[LOG_MAX_FORMATS];
+volatile unsigned logLost = 0;      // wpisy pominiete (pelna tablica formatow, wyscig o slot)
+
+size_t logBytes(){ return sizeof(logRing) + sizeof(logFormats); }
+
+/* id formatu = slot w tablicy otwartego adresowania kluczowanej wskaznikiem */
+int logIntern(const char *fmt){
+    unsigned h = (unsigned)(((size_t)fmt >> 3) * 2654435761u);
+    for(unsigned i=0;i<LOG_MAX_FORMATS;i++){
+        unsigned k = (h + i) & (LOG_MAX_FORMATS-1);
+        const char *cur = logFormats[k];
+        if(cur==fmt) return (int)k;
+        if(cur==0){
+            if(atomicCasPtr(&logFormats[k], 0, fmt)) return (int)k;
+            if(logFormats[k]==fmt) return (int)k;
+        }
+    }
+    return -1;
+}
+
+/* fmt musi byc literalem (trzymany jest tylko wskaznik), a1/a2 sa kopiowane */
+void logEvent(int level, const char *fmt, const char *a1, const char *a2){
+    int id = logIntern(fmt);
+    if(id < 0){ atomicAdd(&logLost, 1); return; }
+    unsigned ticket = atomicAdd(&logHead, 1);
+    LogRecord &r = logRing[ticket & (LOG_CAPACITY-1)];
+    unsigned done = 2*ticket + 2;
+    for(;;){
+        unsigned cur = r.seq;
+        if((int)(cur - done) >= 0){ atomicAdd(&logLost, 1); return; }  // slot ma juz nowszy wpis
+        if(!(cur & 1) && atomicCas(&r.seq, cur, done - 1)) break;
+    }
+    r.msgId = (unsigned short)id;
+    r.level = (unsigned char)level;
+    r.when = (long long)time(0);
+    r.nargs = 0;
+    const char *args[2] = { a1, a2 };
+    size_t used = 0;
+    for(int i=0;i<2 && args[i];i++){
+        size_t n = 0;
+        while(args[i][n] && used + n + 1 < LOG_ARG_BYTES) n++;
+        memcpy(r.args + used, args[i], n);
+        r.args[used + n] = 0;
+        used += n + 1;
+        r.nargs++;
+        if(used >= LOG_ARG_BYTES) break;
+    }
+    atomicStore(&r.seq, done);
+}
+
+void addLog(const char *msg){ logEvent(LOG_INFO, msg); }
+void addLog(const string &msg){ logEvent(LOG_INFO, "%s", msg.c_str()); }
+
+/* rekord skopiowany z pierscienia; false gdy slot zostal nadpisany */
+bool logRead(unsigned ticket, LogRecord &out){
+    const LogRecord &r = logRing[ticket & (LOG_CAPACITY-1)];
+    unsigned done = 2*ticket + 2;
+    if(atomicLoad(&r.seq)!=done) return false;
+    out.msgId = r.msgId;
+    out.level = r.level;
+    out.nargs = r.nargs;
+    out.when = r.when;
+    memcpy(out.args, r.args, LOG_ARG_BYTES);
+    atomicFence();
+    return r.seq==done;
+}
+
+string formatLog(long long when, int level, const char *fmt, const char *args, int nargs){
+    static const char *levelTag[] = { "", "WARN: ", "ERROR: " };
+    time_t t = (time_t)when;
+    struct tm *lt = localtime(&t);
+    char tbuf[32];
+    sprintf(tbuf,"[%02d:%02d:%02d] ",lt->tm_hour,lt->tm_min,lt->tm_sec);
+    string out = tbuf;
+    if(level >= 0 && level < 3) out += levelTag[level];
+    for(const char *p=fmt; *p; p++){
+        if(p[0]=='%' && p[1]=='s'){
+            if(nargs > 0){ out += args; args += strlen(args) + 1; nargs--; }
+            p++;
+        } else out += *p;
+    }
+    return out;
+}
+
+string formatLog(const LogRecord &r){
+    return formatLog(r.when, r.level, logFormats[r.msgId], r.args, r.nargs);
+}
+
+/* Trwale segmenty w dataDir:
+     log-NNNNNN.seg   LogSegHeader, potem rekordy LogDiskRecord + argumenty %s
+     log-formats.txt  teksty formatow, id formatu na dysku = numer linii
+     log-index.bin    LogIndexEntry dla pierwszego rekordu segmentu i co
+                      LOG_INDEX_STRIDE rekordow; logs --since/--tail szuka w nim
+                      binarnie i mapuje tylko segmenty od znalezionego miejsca.
+   Pierscien oproznia logFlush() na watku powloki (jedyny konsument). */
+const unsigned LOG_SEGMENT_BYTES = 1u << 20;
+const unsigned LOG_INDEX_STRIDE = 256;
+const char LOG_SEG_MAGIC[8] = { 'V','L','O','G','S','E','G','1' };
+const char LOG_IDX_MAGIC[8] = { 'V','L','O','G','I','D','X','1' };
+
+struct LogSegHeader { char magic[8]; unsigned segment; unsigned version; };
+struct LogDiskRecord {
+    unsigned short size;        // naglowek + argumenty
+    unsigned short fmt;
+    unsigned char level;
+    unsigned char nargs;
+    unsigned short reserved;
+    long long when;
+};
+struct LogIndexEntry { long long when; long long ordinal; unsigned segment; unsigned offset; };
+
+bool logStoreReady = false;
+FILE *logSegFile = 0, *logIndexFile = 0, *logFormatFile = 0;
+unsigned logSegment = 0, logSegOffset = 0;
+long long logOrdinal = 0;           // rekordy zapisane we wszystkich segmentach
+long long logBootOrdinal = 0;       // pierwszy rekord tej sesji
+unsigned logFlushed = 0;            // bilet pierwszego rekordu pierscienia do zapisu
+vector<string> logFormatTexts;
+map<string,int> logFormatIds;
+int logDiskFmt[LOG_MAX_FORMATS];    // id w pierscieniu -> id na dysku (-1 = jeszcze nie)
+
+string logSegPath(unsigned seg){
+    char name[32]; sprintf(name,"log-%06u.seg",seg);
+    return dataPath(name);
+}
+
+/* naglowek rekordu pod off; false gdy rekord uciety albo uszkodzony */
+bool logDiskAt(const MappedFile &m, size_t off, LogDiskRecord &d){
+    if(off + sizeof(LogDiskRecord) > m.size) return false;
+    memcpy(&d, m.data + off, sizeof d);
+    if(d.size < sizeof d || off + d.size > m.size) return false;
+    return d.nargs==0 || m.data[off + d.size - 1]==0;
+}
+
+bool logStartSegment(){
+    if(logSegFile) fclose(logSegFile);
+    logSegment++;
+    logSegFile = fopen(logSegPath(logSegment).c_str(), "wb");
+    if(!logSegFile) return false;
+    LogSegHeader h;
+    memcpy(h.magic, LOG_SEG_MAGIC, 8);
+    h.segment = logSegment;
+    h.version = 1;
+    fwrite(&h, sizeof h, 1, logSegFile);
+    logSegOffset = sizeof h;
+    return true;
+}
+
+void logOpenStore(){
+    if(!ensureDataDir()) return;
+    for(unsigned i=0;i<LOG_MAX_FORMATS;i++) logDiskFmt[i] = -1;
+    string fpath = dataPath("log-formats.txt"), ipath = dataPath("log-index.bin");
+    ifstream fin(fpath.c_str());
+    string line;
+    while(getline(fin, line)){
+        logFormatIds[line] = (int)logFormatTexts.size();
+        logFormatTexts.push_back(line);
+    }
+
+    /* ostatni wpis indeksu wskazuje segment, do ktorego dopisujemy;
+       uciety wpis (przerwany zapis) jest obcinany przez przepisanie indeksu */
+    MappedFile idx;
+    size_t entries = 0;
+    LogIndexEntry last;
+    bool valid = mapFile(ipath, idx) && idx.size >= 8 && memcmp(idx.data, LOG_IDX_MAGIC, 8)==0;
+    if(valid) entries = (idx.size - 8) / sizeof(LogIndexEntry);
+    if(entries) memcpy(&last, idx.data + 8 + (entries-1)*sizeof(LogIndexEntry), sizeof last);
+    if(!valid || idx.size != 8 + entries*sizeof(LogIndexEntry)){
+        string keep(entries ? idx.data + 8 : "", entries*sizeof(LogIndexEntry));
+        unmapFile(idx);
+        FILE *f = fopen(ipath.c_str(), "wb");
+        if(f){
+            fwrite(LOG_IDX_MAGIC, 1, 8, f);
+            fwrite(keep.data(), 1, keep.size(), f);
+            fclose(f);
+        }
+    }
+    unmapFile(idx);
+
+    if(entries){
+        logSegment = last.segment;
+        logOrdinal = last.ordinal;
+        MappedFile seg;
+        LogDiskRecord d;
+        size_t off = last.offset;
+        bool tailClean = mapFile(logSegPath(logSegment), seg);
+        if(tailClean){
+            while(logDiskAt(seg, off, d)){ off += d.size; logOrdinal++; }
+            tailClean = (off==seg.size);
+        }
+        unmapFile(seg);
+        /* po uszkodzonym ogonie zaczynamy nowy segment; czytelnik i tak konczy segment na pierwszym zlym rekordzie */
+        if(tailClean && off < LOG_SEGMENT_BYTES){
+            logSegFile = fopen(logSegPath(logSegment).c_str(), "ab");
+            logSegOffset = (unsigned)off;
+        }
+    }
+    if(!logSegFile && !logStartSegment()) return;
+    logFormatFile = fopen(fpath.c_str(), "ab");
+    logIndexFile = fopen(ipath.c_str(), "ab");
+    logBootOrdinal = logOrdinal;
+    logStoreReady = logFormatFile && logIndexFile;
+}
+
+void logWriteRecord(const LogRecord &r){
+    int &fmt = logDiskFmt[r.msgId];
+    if(fmt < 0){
+        string text = logFormats[r.msgId];
+        map<string,int>::iterator it = logFormatIds.find(text);
+        if(it!=logFormatIds.end()) fmt = it->second;
+        else {
+            fmt = (int)logFormatTexts.size();
+            logFormatTexts.push_back(text);
+            logFormatIds[text] = fmt;
+            fprintf(logFormatFile, "%s\n", text.c_str());
+        }
+    }
+    size_t argBytes = 0;
+    for(int i=0;i<r.nargs;i++) argBytes += strlen(r.args + argBytes) + 1;
+    LogDiskRecord d;
+    d.size = (unsigned short)(sizeof d + argBytes);
+    d.fmt = (unsigned short)fmt;
+    d.level = r.level;
+    d.nargs = r.nargs;
+    d.reserved = 0;
+    d.when = r.when;
+    if(logSegOffset + d.size > LOG_SEGMENT_BYTES && !logStartSegment()){ logStoreReady = false; return; }
+    if(logSegOffset==sizeof(LogSegHeader) || logOrdinal % LOG_INDEX_STRIDE == 0){
+        LogIndexEntry e;
+        e.when = r.when;
+        e.ordinal = logOrdinal;
+        e.segment = logSegment;
+        e.offset = logSegOffset;
+        fwrite(&e, sizeof e, 1, logIndexFile);
+    }
+    fwrite(&d, sizeof d, 1, logSegFile);
+    fwrite(r.args, 1, argBytes, logSegFile);
+    logSegOffset += d.size;
+    logOrdinal++;
+}
+
+/* ile rekordow pierscienia czeka na zapis */
+unsigned logPending(){ return logStoreReady ? atomicLoad(&logHead) - logFlushed : 0; }
+
+void logFlush(){
+    if(!logStoreReady) return;
+    unsigned head = atomicLoad(&logHead);
+    if(head==logFlushed) return;
+    procEnter(PID_LOGGER);
+    if(head - logFlushed > LOG_CAPACITY){
+        atomicAdd(&logLost, head - logFlushed - LOG_CAPACITY);
+        logFlushed = head - LOG_CAPACITY;
+    }
+    LogRecord r;
+    for(; logFlushed!=head && logStoreReady; logFlushed++)
+        if(logRead(logFlushed, r)) logWriteRecord(r);
+    fflush(logFormatFile);
+    fflush(logIndexFile);
+    fflush(logSegFile);
+    procLeave();
+}
+
+void logCloseStore(){
+    logFlush();
+    if(logSegFile) fclose(logSegFile);
+    if(logIndexFile) fclose(logIndexFile);
+    if(logFormatFile) fclose(logFormatFile);
+    logSegFile = logIndexFile = logFormatFile = 0;
+    logStoreReady = false;
+}
+
+/* --- logs [--since T] [--grep TEXT] [--tail N] [--all] --- */
+struct LogQuery {
+    long long since;        // time_t, 0 = bez ograniczenia
+    long long fromOrdinal;  // domyslnie poczatek tej sesji
+    long tail;              // 0 = wszystkie pasujace
+    string grep;
+};
+
+/* wyniki: bez --tail od razu na ekran, z --tail ostatnie N pasujacych */
+struct LogView {
+    const LogQuery &q;
+    deque<string> last;
+    long scanned, matched;
+    LogView(const LogQuery &query): q(query), scanned(0), matched(0) {}
+    void add(const string &line){
+        scanned++;
+        if(!q.grep.empty() && line.find(q.grep)==string::npos) return;
+        matched++;
+        if(q.tail <= 0){ cout<<line<<"\n"; return; }
+        last.push_back(line);
+        if((long)last.size() > q.tail) last.pop_front();
+    }
+    void finish(){
+        for(size_t i=0;i<last.size();i++) cout<<last[i]<<"\n";
+    }
+};
+
+/* "HH:MM[:SS]" dzisiaj albo "N[s|m|h|d]" temu */
+bool parseLogSince(const string &v, long long &out){
+    int h=0, m=0, sec=0;
+    if(v.find(':')!=string::npos && sscanf(v.c_str(), "%d:%d:%d", &h, &m, &sec) >= 2){
+        time_t now = time(0);
+        struct tm t = *localtime(&now);
+        t.tm_hour = h; t.tm_min = m; t.tm_sec = sec;
+        out = (long long)mktime(&t);
+        return true;
+    }
+    long n = 0; char unit = 's';
+    if(sscanf(v.c_str(), "%ld%c", &n, &unit) < 1 || n < 0) return false;
+    long mult = unit=='s' ? 1 : unit=='m' ? 60 : unit=='h' ? 3600 : unit=='d' ? 86400 : 0;
+    if(!mult) return false;
+    out = (long long)time(0) - (long long)n*mult;
+    return true;
+}
+
+bool parseLogQuery(const string &opts, LogQuery &q){
+    istringstream in(opts);
+    string tok;
+    while(in >> tok){
+        if(tok=="--since"){
+            string v;
+            if(!(in >> v) || !parseLogSince(v, q.since)) return false;
+            q.fromOrdinal = 0;
+        }
+        else if(tok=="--grep"){ if(!(in >> q.grep)) return false; }
+        else if(tok=="--tail"){ if(!(in >> q.tail) || q.tail <= 0) return false; }
+        else if(tok=="--all") q.fromOrdinal = 0;
+        else return false;
+    }
+    return true;
+}
+
+/* bez katalogu danych: tylko to, co jest jeszcze w pierscieniu */
+void logScanRing(const LogQuery &q, LogView &view){
+    unsigned head = atomicLoad(&logHead);
+    unsigned first = head > LOG_CAPACITY ? head - LOG_CAPACITY : 0;
+    if(first > 0) cout<<"("<<first<<" older entries dropped)\n";
+    LogRecord r;
+    for(unsigned t=first; t!=head; t++){
+        if(logRead(t, r) && r.when >= q.since) view.add(formatLog(r));
+    }
+}
+
+void logScanStore(const LogQuery &q, LogView &view){
+    MappedFile idx;
+    if(!mapFile(dataPath("log-index.bin"), idx) || idx.size < 8 + sizeof(LogIndexEntry)){ unmapFile(idx); return; }
+    const LogIndexEntry *ix = (const LogIndexEntry*)(idx.data + 8);
+    size_t n = (idx.size - 8) / sizeof(LogIndexEntry);
+
+    /* start: ostatni wpis indeksu przed pierwszym potrzebnym rekordem */
+    long long target = q.fromOrdinal;
+    if(q.tail > 0 && q.grep.empty()) target = max(target, logOrdinal - q.tail);
+    size_t lo = 0, hi = n;
+    while(lo < hi){ size_t mid = (lo+hi)/2; if(ix[mid].ordinal <= target) lo = mid+1; else hi = mid; }
+    size_t start = lo > 0 ? lo-1 : 0;
+    if(q.since > 0){
+        lo = 0; hi = n;
+        while(lo < hi){ size_t mid = (lo+hi)/2; if(ix[mid].when < q.since) lo = mid+1; else hi = mid; }
+        start = max(start, lo > 0 ? lo-1 : 0);
+    }
+    unsigned seg = ix[start].segment, off = ix[start].offset;
+    long long ord = ix[start].ordinal;
+    unmapFile(idx);
+
+    MappedFile m;
+    LogDiskRecord d;
+    for(; seg <= logSegment; seg++, off = sizeof(LogSegHeader)){
+        if(!mapFile(logSegPath(seg), m)) continue;
+        while(logDiskAt(m, off, d)){
+            if(ord >= target && d.when >= q.since){
+                const char *fmt = d.fmt < logFormatTexts.size() ? logFormatTexts[d.fmt].c_str() : "?";
+                view.add(formatLog(d.when, d.level, fmt, m.data + off + sizeof d, d.nargs));
+            }
+            off += d.size;
+            ord++;
+        }
+    }
+    unmapFile(m);
+}
+
+void showLogs(const string &opts){
+    LogQuery q;
+    q.since = 0;
+    q.fromOrdinal = logBootOrdinal;
+    q.tail = 0;
+    if(!parseLogQuery(opts, q)){
+        cout<<"Usage: logs [--since HH:MM[:SS]|N(s|m|h|d)] [--grep TEXT] [--tail N] [--all]\n\n";
+        return;
+    }
+    logFlush();
+    procEnter(PID_LOGGER);
+    setColor(14);
+    cout<<"\n--- System Logs ---\n";
+    LogView view(q);
+    if(logStoreReady) logScanStore(q, view);
+    else logScanRing(q, view);
+    view.finish();
+    if(!opts.empty()){
+        cout<<"("<<view.matched<<" matching of "<<view.scanned<<" scanned";
+        if(logStoreReady) cout<<", "<<logOrdinal<<" stored";
+        cout<<")\n";
+    }
+    if(logLost > 0) cout<<"("<<logLost<<" entries lost)\n";
+    cout<<"\n";
+    setColor(7);
+    procLeave();
+}
+
+/* ===============================
+   RENDERER STATS (gfxstat)
+=============================== */
+void showFrameStats(){
+    const FrameStats &st = screen.stats;
+    long cells = st.cellsSent + st.cellsSkipped;
+    char buf[128];
+    setColor(11);
+    cout<<"\n--- Renderer ---\n";
+    sprintf(buf," Frames presented : %ld\n", st.frames); cout<<buf;
+    sprintf(buf," Bytes written    : %ld (avg %ld/frame, last %ld, max %ld)\n",
+            st.bytes, st.frames ? st.bytes/st.frames : 0L, st.lastBytes, st.maxBytes); cout<<buf;
+    sprintf(buf," Frame budget     : %d bytes, exceeded in %ld frames\n", st.budget, st.overBudget); cout<<buf;
+    sprintf(buf," Cells sent       : %ld of %ld touched (%ld unchanged skipped)\n\n",
+            st.cellsSent, cells, st.cellsSkipped); cout<<buf;
+    setColor(7);
+}
+
+/* ===============================
+   MINI GAMES
+=============================== */
+void guessGame(){
+    srand((unsigned)time(0));
+    int secret = rand()%20+1, g;
+    cout<<"Guess number (1-20): ";
+    cin>>g;
+    if(g==secret){
+        setColor(10); cout<<"Correct! You win!\n\n";
+        addLog("guessGame: user guessed correctly");
+    } else {
+        setColor(12); cout<<"Wrong! The number was "<<secret<<"\n\n";
+        addLog("guessGame: user guessed wrong");
+    }
+    setColor(7);
+}
+
+/* ===============================
+   CALCULATOR
+=============================== */
+/* Wyrazenie -> tokeny -> parser Pratta -> bajtkod stosowy. Ten sam
+   bajtkod liczy jedna wartosc i cale kolumny (calc --batch): kazda
+   instrukcja przechodzi naraz blok CALC_BLOCK wierszy, wiec petle
+   sa proste i ida po dwie liczby w rejestrze SSE2. */
+const size_t CALC_BLOCK = 4096;
+
+enum CalcOp {
+    CO_CONST, CO_COL,
+    /* jednoargumentowe */
+    CO_NEG, CO_SQRT, CO_ABS, CO_EXP, CO_LN, CO_LOG10, CO_LOG2, CO_SIN, CO_COS, CO_TAN,
+    CO_ASIN, CO_ACOS, CO_ATAN, CO_FLOOR, CO_CEIL, CO_ROUND,
+    /* dwuargumentowe */
+    CO_ADD, CO_SUB, CO_MUL, CO_DIV, CO_MOD, CO_POW, CO_LT, CO_LE, CO_GT, CO_GE, CO_EQ, CO_NE,
+    CO_MIN, CO_MAX, CO_ATAN2, CO_HYPOT,
+    CO_IF
+};
+struct CalcIns { int op; int arg; };   // arg: indeks stalej albo kolumny
+struct CalcProgram {
+    vector<CalcIns> code;
+    vector<double> consts;
+    vector<int> cols;                   // pola wejscia czytane przez program
+    int depth;
+    CalcProgram(): depth(0) {}
+};
+
+struct CalcFunc { const char *name; int op; int args; };   // args -1: 2 lub wiecej
+const CalcFunc CALC_FUNCS[] = {
+    {"sqrt", CO_SQRT, 1}, {"abs", CO_ABS, 1}, {"exp", CO_EXP, 1}, {"ln", CO_LN, 1},
+    {"log", CO_LOG10, 1}, {"log2", CO_LOG2, 1}, {"sin", CO_SIN, 1}, {"cos", CO_COS, 1},
+    {"tan", CO_TAN, 1}, {"asin", CO_ASIN, 1}, {"acos", CO_ACOS, 1}, {"atan", CO_ATAN, 1},
+    {"floor", CO_FLOOR, 1}, {"ceil", CO_CEIL, 1}, {"round", CO_ROUND, 1},
+    {"pow", CO_POW, 2}, {"mod", CO_MOD, 2}, {"atan2", CO_ATAN2, 2}, {"hypot", CO_HYPOT, 2},
+    {"min", CO_MIN, -1}, {"max", CO_MAX, -1}, {"if", CO_IF, 3}
+};
+const int CALC_FUNC_COUNT = sizeof(CALC_FUNCS) / sizeof(CALC_FUNCS[0]);
+
+map<string,double> calcVars;            // zmienne uzytkownika i ans
+
+double calcRound(double x){ return x < 0 ? -floor(-x + 0.5) : floor(x + 0.5); }
+
+void calcApply1(int op, double *a, size_t n){
+    size_t i = 0;
+#ifdef VIREON_SSE2
+    const __m128d sign = _mm_set1_pd(-0.0);
+    switch(op){
+        case CO_NEG:  for(; i+2<=n; i+=2) _mm_storeu_pd(a+i, _mm_xor_pd(_mm_loadu_pd(a+i), sign)); break;
+        case CO_ABS:  for(; i+2<=n; i+=2) _mm_storeu_pd(a+i, _mm_andnot_pd(sign, _mm_loadu_pd(a+i))); break;
+        case CO_SQRT: for(; i+2<=n; i+=2) _mm_storeu_pd(a+i, _mm_sqrt_pd(_mm_loadu_pd(a+i))); break;
+    }
+#endif
+    switch(op){
+        case CO_NEG:   for(; i<n; i++) a[i] = -a[i]; break;
+        case CO_ABS:   for(; i<n; i++) a[i] = fabs(a[i]); break;
+        case CO_SQRT:  for(; i<n; i++) a[i] = sqrt(a[i]); break;
+        case CO_EXP:   for(; i<n; i++) a[i] = exp(a[i]); break;
+        case CO_LN:    for(; i<n; i++) a[i] = log(a[i]); break;
+        case CO_LOG10: for(; i<n; i++) a[i] = log10(a[i]); break;
+        case CO_LOG2:  for(; i<n; i++) a[i] = log(a[i]) / 0.69314718055994530942; break;
+        case CO_SIN:   for(; i<n; i++) a[i] = sin(a[i]); break;
+        case CO_COS:   for(; i<n; i++) a[i] = cos(a[i]); break;
+        case CO_TAN:   for(; i<n; i++) a[i] = tan(a[i]); break;
+        case CO_ASIN:  for(; i<n; i++) a[i] = asin(a[i]); break;
+        case CO_ACOS:  for(; i<n; i++) a[i] = acos(a[i]); break;
+        case CO_ATAN:  for(; i<n; i++) a[i] = atan(a[i]); break;
+        case CO_FLOOR: for(; i<n; i++) a[i] = floor(a[i]); break;
+        case CO_CEIL:  for(; i<n; i++) a[i] = ceil(a[i]); break;
+        case CO_ROUND: for(; i<n; i++) a[i] = calcRound(a[i]); break;
+    }
+}
+
+/* a = a op b; porownania daja 1 albo 0 */
+void calcApply2(int op, double *a, const double *b, size_t n){
+    size_t i = 0;
+#ifdef VIREON_SSE2
+    const __m128d one = _mm_set1_pd(1.0);
+    switch(op){
+#define CALC_SSE(OP, EXPR) case OP: for(; i+2<=n; i+=2){ __m128d x = _mm_loadu_pd(a+i), y = _mm_loadu_pd(b+i); \
+                                    _mm_storeu_pd(a+i, EXPR); } break;
+        CALC_SSE(CO_ADD, _mm_add_pd(x, y))
+        CALC_SSE(CO_SUB, _mm_sub_pd(x, y))
+        CALC_SSE(CO_MUL, _mm_mul_pd(x, y))
+        CALC_SSE(CO_DIV, _mm_div_pd(x, y))
+        /* minpd/maxpd przy NaN oddaja drugi argument; NaN ma przejsc dalej jak w petli skalarnej */
+        CALC_SSE(CO_MIN, _mm_or_pd(_mm_min_pd(x, y), _mm_cmpunord_pd(x, y)))
+        CALC_SSE(CO_MAX, _mm_or_pd(_mm_max_pd(x, y), _mm_cmpunord_pd(x, y)))
+        CALC_SSE(CO_LT,  _mm_and_pd(_mm_cmplt_pd(x, y), one))
+        CALC_SSE(CO_LE,  _mm_and_pd(_mm_cmple_pd(x, y), one))
+        CALC_SSE(CO_GT,  _mm_and_pd(_mm_cmpgt_pd(x, y), one))
+        CALC_SSE(CO_GE,  _mm_and_pd(_mm_cmpge_pd(x, y), one))
+        CALC_SSE(CO_EQ,  _mm_and_pd(_mm_cmpeq_pd(x, y), one))
+        CALC_SSE(CO_NE,  _mm_and_pd(_mm_cmpneq_pd(x, y), one))
+        CALC_SSE(CO_HYPOT, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y))))
+#undef CALC_SSE
+    }
+#endif
+    switch(op){
+        case CO_ADD:   for(; i<n; i++) a[i] += b[i]; break;
+        case CO_SUB:   for(; i<n; i++) a[i] -= b[i]; break;
+        case CO_MUL:   for(; i<n; i++) a[i] *= b[i]; break;
+        case CO_DIV:   for(; i<n; i++) a[i] /= b[i]; break;
+        case CO_MOD:   for(; i<n; i++) a[i] = fmod(a[i], b[i]); break;
+        case CO_POW:   for(; i<n; i++) a[i] = pow(a[i], b[i]); break;
+        case CO_MIN:   for(; i<n; i++) a[i] = b[i] < a[i] ? b[i] : a[i] <= b[i] ? a[i] : a[i] + b[i]; break;
+        case CO_MAX:   for(; i<n; i++) a[i] = b[i] > a[i] ? b[i] : a[i] >= b[i] ? a[i] : a[i] + b[i]; break;
+        case CO_LT:    for(; i<n; i++) a[i] = a[i] <  b[i]; break;
+        case CO_LE:    for(; i<n; i++) a[i] = a[i] <= b[i]; break;
+        case CO_GT:    for(; i<n; i++) a[i] = a[i] >  b[i]; break;
+        case CO_GE:    for(; i<n; i++) a[i] = a[i] >= b[i]; break;
+        case CO_EQ:    for(; i<n; i++) a[i] = a[i] == b[i]; break;
+        case CO_NE:    for(; i<n; i++) a[i] = a[i] != b[i]; break;
+        case CO_ATAN2: for(; i<n; i++) a[i] = atan2(a[i], b[i]); break;
+        case CO_HYPOT: for(; i<n; i++) a[i] = sqrt(a[i] * a[i] + b[i] * b[i]); break;
+    }
+}
+
+/* n wierszy; cols[k] to blok pola prog.cols[k], stk ma depth*CALC_BLOCK
+   miejsc, wynik laduje w stk[0..n) */
+void calcExec(const CalcProgram &p, const double *const *cols, size_t n, double *stk){
+    double *top = stk - CALC_BLOCK;      // szczyt stosu
+    for(size_t k=0;k<p.code.size();k++){
+        const CalcIns &in = p.code[k];
+        if(in.op==CO_CONST){
+            top += CALC_BLOCK;
+            double v = p.consts[in.arg];
+            for(size_t i=0;i<n;i++) top[i] = v;
+        } else if(in.op==CO_COL){
+            top += CALC_BLOCK;
+            memcpy(top, cols[in.arg], n * sizeof(double));
+        } else if(in.op < CO_ADD) calcApply1(in.op, top, n);
+        else if(in.op < CO_IF){
+            top -= CALC_BLOCK;
+            calcApply2(in.op, top, top + CALC_BLOCK, n);
+        } else {
+            top -= 2 * CALC_BLOCK;
+            const double *x = top + CALC_BLOCK, *y = top + 2 * CALC_BLOCK;
+            for(size_t i=0;i<n;i++) top[i] = top[i]!=0 ? x[i] : y[i];
+        }
+    }
+}
+
+/* --- parser --- */
+enum CalcTokKind { CT_END, CT_NUM, CT_NAME, CT_OP, CT_BAD };
+struct CalcParser {
+    const char *src;
+    size_t pos, tokAt;
+    CalcTokKind kind;
+    double num;
+    string text;                         // nazwa albo operator
+    string err;
+    size_t errAt;
+    CalcProgram &prog;
+    const vector<string> *header;        // nazwy kolumn; 0 = bez kolumn
+    int sp;
+    CalcParser(const string &s, CalcProgram &p, const vector<string> *h)
+        : src(s.c_str()), pos(0), tokAt(0), kind(CT_END), num(0), errAt(0), prog(p), header(h), sp(0) { next(); }
+
+    void fail(const string &msg){ if(err.empty()){ err = msg; errAt = tokAt; } }
+    bool isOp(const char *op) const { return kind==CT_OP && text==op; }
+
+    void next(){
+        while(src[pos]==' ' || src[pos]=='\t') pos++;
+        tokAt = pos;
+        char c = src[pos];
+        if(!c){ kind = CT_END; text.clear(); return; }
+        if(isdigit((unsigned char)c) || (c=='.' && isdigit((unsigned char)src[pos+1]))){
+            char *e;
+            num = strtod(src + pos, &e);
+            pos = e - src;
+            kind = CT_NUM;
+        } else if(isalpha((unsigned char)c) || c=='_'){
+            size_t b = pos;
+            while(isalnum((unsigned char)src[pos]) || src[pos]=='_') pos++;
+            text.assign(src + b, pos - b);
+            kind = CT_NAME;
+        } else {
+            static const char *two[] = {"<=", ">=", "==", "!=", "**"};
+            kind = CT_OP;
+            for(int i=0;i<5;i++) if(c==two[i][0] && src[pos+1]==two[i][1]){
+                text = i==4 ? "^" : two[i];
+                pos += 2;
+                return;
+            }
+            if(!strchr("+-*/%^()<>,=", c)){ kind = CT_BAD; text = string(1, c); pos++; return; }
+            text = string(1, c);
+            pos++;
+        }
+    }
+
+    void push(int op, int arg){
+        CalcIns in = { op, arg };
+        prog.code.push_back(in);
+        if(++sp > prog.depth) prog.depth = sp;
+    }
+    void pushConst(double v){ prog.consts.push_back(v); push(CO_CONST, (int)prog.consts.size() - 1); }
+    bool isConst(size_t fromEnd) const {
+        return prog.code.size() >= fromEnd && prog.code[prog.code.size() - fromEnd].op==CO_CONST;
+    }
+    double constAt(size_t fromEnd) const { return prog.consts[prog.code[prog.code.size() - fromEnd].arg]; }
+    /* stale zwijane od razu: argumenty operatora to zawsze koncowka kodu */
+    void emit(int op){
+        int args = op < CO_ADD ? 1 : op < CO_IF ? 2 : 3;
+        bool fold = true;
+        for(int i=1;i<=args;i++) if(!isConst(i)) fold = false;
+        if(fold){
+            double a = constAt(args), b = args > 1 ? constAt(args - 1) : 0, c = args > 2 ? constAt(1) : 0;
+            if(op < CO_ADD) calcApply1(op, &a, 1);
+            else if(op < CO_IF) calcApply2(op, &a, &b, 1);
+            else a = a!=0 ? b : c;
+            for(int i=0;i<args;i++){ prog.code.pop_back(); prog.consts.pop_back(); sp--; }
+            pushConst(a);
+            return;
+        }
+        CalcIns in = { op, 0 };
+        prog.code.push_back(in);
+        sp -= args - 1;
+    }
+
+    static int binaryOp(const string &t, int &lbp){
+        static const struct { const char *t; int op, bp; } ops[] = {
+            {"<", CO_LT, 10}, {"<=", CO_LE, 10}, {">", CO_GT, 10}, {">=", CO_GE, 10},
+            {"==", CO_EQ, 10}, {"!=", CO_NE, 10}, {"+", CO_ADD, 20}, {"-", CO_SUB, 20},
+            {"*", CO_MUL, 30}, {"/", CO_DIV, 30}, {"%", CO_MOD, 30}, {"^", CO_POW, 50}
+        };
+        for(int i=0;i<12;i++) if(t==ops[i].t){ lbp = ops[i].bp; return ops[i].op; }
+        lbp = 0;
+        return -1;
+    }
+
+    void name(const string &id, size_t at){
+        if(header){
+            string low = toLowerStr(id);
+            for(size_t i=0;i<header->size();i++) if((*header)[i]==low){ column((int)i); return; }
+        }
+        if(header && id.size() > 1 && id[0]=='c' && id.find_first_not_of("0123456789", 1)==string::npos){
+            int n = atoi(id.c_str() + 1);
+            if(n >= 1){ column(n - 1); return; }
+        }
+        if(id=="pi"){ pushConst(3.14159265358979323846); return; }
+        if(id=="e"){ pushConst(2.71828182845904523536); return; }
+        map<string,double>::const_iterator v = calcVars.find(id);
+        if(v!=calcVars.end()){ pushConst(v->second); return; }
+        tokAt = at;
+        fail("unknown name '" + id + "'");
+        pushConst(0);
+    }
+    void column(int field){
+        size_t k = find(prog.cols.begin(), prog.cols.end(), field) - prog.cols.begin();
+        if(k==prog.cols.size()) prog.cols.push_back(field);
+        push(CO_COL, (int)k);
+    }
+
+    void call(const string &id, size_t at){
+        int f = 0;
+        while(f < CALC_FUNC_COUNT && id!=CALC_FUNCS[f].name) f++;
+        if(f==CALC_FUNC_COUNT){ tokAt = at; fail("unknown function '" + id + "'"); }
+        next();                          // '('
+        int args = 0;
+        if(!isOp(")")){
+            while(true){
+                expr(0);
+                args++;
+                if(f < CALC_FUNC_COUNT && CALC_FUNCS[f].args < 0 && args >= 2) emit(CALC_FUNCS[f].op);
+                if(!isOp(",")) break;
+                next();
+            }
+        }
+        if(!isOp(")")){ fail("expected ')'"); return; }
+        next();
+        if(f==CALC_FUNC_COUNT) return;
+        const CalcFunc &fn = CALC_FUNCS[f];
+        if(fn.args < 0 ? args < 2 : args!=fn.args){
+            char buf[64];
+            sprintf(buf, fn.args < 0 ? "%s() takes at least 2 arguments" : "%s() takes %d argument(s)", fn.name, fn.args);
+            tokAt = at;
+            fail(buf);
+            return;
+        }
+        if(fn.args >= 0) emit(fn.op);
+    }
+
+    void prefix(){
+        if(kind==CT_NUM){ pushConst(num); next(); return; }
+        if(kind==CT_NAME){
+            string id = text;
+            size_t at = tokAt;
+            next();
+            if(isOp("(")) call(id, at);
+            else name(id, at);
+            return;
+        }
+        if(isOp("(")){
+            next();
+            expr(0);
+            if(!isOp(")")){ fail("expected ')'"); return; }
+            next();
+            return;
+        }
+        if(isOp("-")){ next(); expr(40); emit(CO_NEG); return; }
+        if(isOp("+")){ next(); expr(40); return; }
+        fail(kind==CT_END ? "unexpected end of expression" : "unexpected '" + text + "'");
+        pushConst(0);
+    }
+
+    /* Pratt: lewy operand, potem operatory silniejsze niz rbp; ^ wiaze w prawo */
+    void expr(int rbp){
+        prefix();
+        while(err.empty()){
+            int lbp, op = kind==CT_OP ? binaryOp(text, lbp) : -1;
+            if(op < 0 || lbp <= rbp) break;
+            next();
+            expr(op==CO_POW ? lbp - 1 : lbp);
+            emit(op);
+        }
+    }
+
+    /* cale wejscie; target dostaje nazwe przy "x = ..." */
+    bool parse(string *target){
+        if(target && kind==CT_NAME){
+            size_t at = tokAt;
+            string id = text;
+            next();
+            if(isOp("=")){
+                if(id=="pi" || id=="e"){ tokAt = at; fail("cannot assign to a constant"); return false; }
+                *target = id;
+                next();
+            } else { pos = at; next(); }
+        }
+        expr(0);
+        if(err.empty() && kind!=CT_END) fail(kind==CT_BAD || kind==CT_OP ? "unexpected '" + text + "'" : "expected an operator");
+        return err.empty();
+    }
+};
+
+void calcShowError(const string &expr, const CalcParser &p){
+    setColor(12);
+    cout<<"  "<<expr<<"\n  "<<string(p.errAt, ' ')<<"^ "<<p.err<<"\n";
+    setColor(7);
+}
+
+string calcFormat(double v){
+    char buf[48];
+    if(v!=v) return "undefined";
+    if(v - v!=0) return v > 0 ? "infinity" : "-infinity";
+    sprintf(buf, "%.12g", v);
+    return buf;
+}
+
+/* jedna linia trybu interaktywnego: wyrazenie albo przypisanie */
+void calcEvalLine(const string &line){
+    CalcProgram prog;
+    string target;
+    CalcParser p(line, prog, 0);
+    if(!p.parse(&target)){ calcShowError(line, p); return; }
+    vector<double> stk(prog.depth * CALC_BLOCK);
+    calcExec(prog, 0, 1, &stk[0]);
+    double v = stk[0];
+    if(v!=v || v - v!=0){
+        setColor(12);
+        cout<<(v!=v ? "Error: undefined result" : "Error: division by zero or overflow")<<"\n";
+        setColor(7);
+        return;
+    }
+    if(!target.empty()) calcVars[target] = v;
+    calcVars["ans"] = v;
+    cout<<(target.empty() ? "" : target + " ")<<"= "<<calcFormat(v)<<"\n";
+}
+
+/* --- kolumny liczb (calc --batch) --- */
+bool calcSep(char c){ return c==' ' || c=='\t' || c==',' || c==';' || c=='\r'; }
+
+/* szybka sciezka: do 15 cyfr bez wykladnika wynik jest dokladny
+   (mantysa < 2^53, potega 10 z tabeli), reszta idzie przez strtod */
+bool calcParseField(const char *s, const char *e, double &v){
+    static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char *p = s;
+    bool neg = false;
+    if(p < e && (*p=='-' || *p=='+')){ neg = *p=='-'; p++; }
+    unsigned long long m = 0;
+    int digits = 0, frac = 0;
+    while(p < e && (unsigned)(*p - '0') < 10){ m = m * 10 + (*p - '0'); digits++; p++; }
+    if(p < e && *p=='.'){
+        p++;
+        while(p < e && (unsigned)(*p - '0') < 10){ m = m * 10 + (*p - '0'); digits++; frac++; p++; }
+    }
+    if(p==e && digits > 0 && digits <= 15){
+        v = (double)m / POW10[frac];
+        if(neg) v = -v;
+        return true;
+    }
+    char buf[64];
+    if(e - s >= (ptrdiff_t)sizeof(buf)) return false;
+    memcpy(buf, s, e - s);
+    buf[e - s] = 0;
+    char *end;
+    v = strtod(buf, &end);
+    return end==buf + (e - s) && end!=buf;
+}
+
+struct CalcReader {
+    const char *p, *end;
+    vector<int> slotOf;                  // pole -> kolumna programu albo -1
+    size_t needed, skipped;
+    CalcReader(const char *data, size_t n): p(data), end(data + n), needed(0), skipped(0) {}
+
+    /* nastepna linia; false na koncu danych */
+    bool line(const char *&b, const char *&e){
+        if(p >= end) return false;
+        b = p;
+        e = (const char*)memchr(p, '\n', end - p);
+        if(!e) e = end;
+        p = e + 1;
+        return true;
+    }
+    /* do max wierszy do buf (kolumna k od buf + k*CALC_BLOCK) */
+    size_t fill(double *buf, size_t max){
+        size_t rows = 0;
+        const char *b, *e;
+        while(rows < max && line(b, e)){
+            size_t got = 0, f = 0;
+            bool ok = true, any = false;
+            while(b < e && f < slotOf.size()){
+                while(b < e && calcSep(*b)) b++;
+                if(b==e) break;
+                const char *s = b;
+                while(b < e && !calcSep(*b)) b++;
+                any = true;
+                int k = slotOf[f++];
+                if(k < 0) continue;
+                if(!calcParseField(s, b, buf[k * CALC_BLOCK + rows])){ ok = false; break; }
+                got++;
+            }
+            while(!any && b < e){ if(!calcSep(*b)) any = true; b++; }
+            if(!any) continue;           // pusta linia
+            if(!ok || got < needed){ skipped++; continue; }
+            rows++;
+        }
+        return rows;
+    }
+};
+
+/* zrodlo danych: plik VFS albo host:SCIEZKA (mapowany) */
+bool calcOpenData(const string &path, MappedFile &m, string &copy, const char *&data, size_t &n){
+    if(path.compare(0, 5, "host:")==0){
+        if(!mapFile(path.substr(5), m)) return false;
+        data = m.data ? m.data : "";
+        n = m.size;
+        return true;
+    }
+    unsigned ino = vfsWalk(path);
+    if(!ino || vfsInode(ino).type!=VFS_FILE) return false;
+    data = vfsView(vfsInode(ino), copy);
+    n = vfsInode(ino).length;
+    return true;
+}
+
+/* pierwsza niepusta linia z polem nieliczbowym to naglowek z nazwami kolumn */
+bool calcHeader(CalcReader &r, vector<string> &names){
+    const char *save = r.p, *b, *e;
+    while(r.line(b, e)){
+        vector<string> fields;
+        bool numeric = true;
+        while(b < e){
+            while(b < e && calcSep(*b)) b++;
+            if(b==e) break;
+            const char *s = b;
+            double v;
+            while(b < e && !calcSep(*b)) b++;
+            fields.push_back(toLowerStr(string(s, b)));
+            if(!calcParseField(s, b, v)) numeric = false;
+        }
+        if(fields.empty()) continue;
+        if(numeric) break;
+        names = fields;
+        return true;
+    }
+    r.p = save;
+    return false;
+}
+
+void calcBatch(const string &path, const string &expr){
+    MappedFile m;
+    string copy;
+    const char *data;
+    size_t size;
+    if(!calcOpenData(path, m, copy, data, size)){ cout<<"No such file: "<<path<<"\n\n"; return; }
+    long long t0 = nowMicros();
+    CalcReader rd(data, size);
+    vector<string> header;
+    bool hasHeader = calcHeader(rd, header);
+    CalcProgram prog;
+    CalcParser p(expr, prog, &header);
+    if(!p.parse(0)){ calcShowError(expr, p); cout<<"\n"; unmapFile(m); return; }
+    int fields = 0;
+    for(size_t k=0;k<prog.cols.size();k++) fields = max(fields, prog.cols[k] + 1);
+    rd.slotOf.assign(max(fields, 1), -1);
+    for(size_t k=0;k<prog.cols.size();k++) rd.slotOf[prog.cols[k]] = (int)k;
+    rd.needed = prog.cols.size();
+
+    vector<double> in(max((size_t)1, prog.cols.size()) * CALC_BLOCK), stk(max(1, prog.depth) * CALC_BLOCK);
+    vector<const double*> cols(prog.cols.size());
+    for(size_t k=0;k<cols.size();k++) cols[k] = &in[k * CALC_BLOCK];
+    size_t rows = 0, bad = 0;
+    double sum = 0, lo = HUGE_VAL, hi = -HUGE_VAL;
+    long long evalUs = 0;
+    while(true){
+        size_t n = rd.fill(&in[0], CALC_BLOCK);
+        if(!n) break;
+        long long e0 = nowMicros();
+        calcExec(prog, cols.empty() ? 0 : &cols[0], n, &stk[0]);
+        const double *r = &stk[0];
+        double s0 = 0, s1 = 0;
+        size_t i = 0;
+        for(; i+2<=n; i+=2){             // dwie sumy czesciowe, zeby petla nie czekala na dodawanie
+            double a = r[i], b = r[i+1];
+            if(a - a==0){ s0 += a; if(a < lo) lo = a; if(a > hi) hi = a; } else bad++;
+            if(b - b==0){ s1 += b; if(b < lo) lo = b; if(b > hi) hi = b; } else bad++;
+        }
+        for(; i<n; i++){
+            double a = r[i];
+            if(a - a==0){ s0 += a; if(a < lo) lo = a; if(a > hi) hi = a; } else bad++;
+        }
+        sum += s0 + s1;
+        rows += n;
+        evalUs += nowMicros() - e0;
+    }
+    long long totalUs = max(1LL, nowMicros() - t0);
+    unmapFile(m);
+    size_t good = rows - bad;
+    if(good) calcVars["ans"] = sum;
+
+    char buf[160];
+    asciiBorder("CALC BATCH: " + path, 64, 11);
+    setColor(11);
+    cout<<" Expression : "<<expr<<"\n";
+    sprintf(buf, " Rows       : %lu", (unsigned long)rows); cout<<buf;
+    if(hasHeader) cout<<" (header: "<<header.size()<<" columns)";
+    if(rd.skipped){ sprintf(buf, ", %lu skipped", (unsigned long)rd.skipped); cout<<buf; }
+    if(bad){ sprintf(buf, ", %lu undefined", (unsigned long)bad); cout<<buf; }
+    cout<<"\n";
+    if(good){
+        cout<<" Sum        : "<<calcFormat(sum)<<"\n";
+        cout<<" Mean       : "<<calcFormat(sum / good)<<"\n";
+        cout<<" Min / max  : "<<calcFormat(lo)<<" / "<<calcFormat(hi)<<"\n";
+    }
+    sprintf(buf, " Time       : %.1f ms (evaluate %.1f ms, %.0f Mrows/s)\n\n", totalUs / 1000.0, evalUs / 1000.0,
+            rows / (double)max(1LL, evalUs)); cout<<buf;
+    setColor(7);
+    addLog("calc: batch over " + path);
+}
+
+void calcShowVars(){
+    if(calcVars.empty()){ cout<<"No variables yet (x = 2*pi)\n"; return; }
+    for(map<string,double>::const_iterator i=calcVars.begin(); i!=calcVars.end(); ++i)
+        cout<<"  "<<i->first<<" = "<<calcFormat(i->second)<<"\n";
+}
+
+/* calc                     tryb interaktywny
+   calc EXPR                jedno wyrazenie
+   calc --batch FILE [EXPR] wyrazenie po wierszach pliku (domyslnie c1) */
+void calculator(const string &arg){
+    if(arg.compare(0, 7, "--batch")==0){
+        string rest = trim(arg.substr(7));
+        size_t sp = rest.find(' ');
+        if(rest.empty()){ cout<<"Usage: calc --batch FILE [EXPR]\n\n"; return; }
+        calcBatch(rest.substr(0, sp), sp==string::npos ? "c1" : trim(rest.substr(sp + 1)));
+        return;
+    }
+    if(arg=="vars"){ calcShowVars(); cout<<"\n"; return; }
+    if(!arg.empty()){ calcEvalLine(arg); cout<<"\n"; return; }
+    cout<<"Calculator - expressions like 2*(3+4)^2, sqrt(2), x = 5. 'vars' lists variables, empty line quits.\n";
+    string line;
+    while(true){
+        cout<<"calc> ";
+        waitForInput();
+        if(!getline(cin, line)) break;
+        line = trim(line);
+        if(line.empty() || line=="exit" || line=="quit") break;
+        if(line=="vars") calcShowVars();
+        else calcEvalLine(line);
+    }
+    cout<<"\n";
+}
+
+/* ===============================
+   NOTES APP
+=============================== */
+void notesApp(){
+    cin.ignore();
+    string line;
+    cout<<"Notes - enter lines. Single '.' on a line to finish.\n";
+    while(true){
+        getline(cin,line);
+        if(line==".") break;
+        vfsAppend("/notes.txt", line + "\n");
+        addLog("Note added");
+    }
+    cout<<"Notes saved to notes.txt\n\n";
+}
+
+/* ===============================
+   PAINT (ASCII)
+=============================== */
+void paintHeader(Task &){ asciiBorder("PAINT - ASCII CANVAS",48,12); }
+
+/* cale plotno rysowane w kazdej klatce; na terminal ida tylko zmiany */
+bool paintStep(Task &t){
+    if(t.frame >= t.frames) return false;
+    string &row = t.rows[t.frame];
+    for(int x=0;x<40;x++) row[2+x] = (rand()%3==0? '#' : ' ');
+    t.frame++;
+    return true;
+}
+
+void paintFinish(Task &t){
+    if(!t.foreground) return;
+    asciiBorder("END PAINT",48,12);
+    cout<<"\n";
+}
+
+const TaskKind paintTask = { false, paintHeader, paintStep, paintFinish };
+
+void paint(){
+    Task *t = createTask(&paintTask, "paint", 60, 8);
+    t->rows.assign(8, "| " + string(40,' ') + " |");
+    launchTask(t, launchBackground);
+}
+
+/* ===============================
+   MUSIC PLAYER (FAKE)
+=============================== */
+void musicHeader(Task &){
+    asciiBorder("MUSICPLAYER",48,13);
+    cout<<" Now playing: 'Synthetic Waves' [demo]\n\n";
+}
+
+/* korektor: 30 slupkow po 6 wierszy, poziomy bladza o +-1 na klatke */
+bool musicStep(Task &t){
+    if(t.frame >= t.frames) return false;
+    if(t.frame > 0)
+        for(int j=0;j<30;j++) t.vals[j] = max(0, min(6, t.vals[j] + rand()%3 - 1));
+    for(int r=0;r<6;r++){
+        string &line = t.rows[r];
+        for(int j=0;j<30;j++)
+            line[3+j] = (t.vals[j] > 5-r) ? ((j%2) ? '+' : '~') : ' ';
+    }
+    t.frame++;
+    return true;
+}
+
+void musicFinish(Task &t){
+    if(t.foreground){
+        asciiBorder("END MUSIC",48,13);
+        cout<<"\n";
+    }
+    addLog("musicPlayer: played Synthetic Waves");
+}
+
+const TaskKind musicTask = { false, musicHeader, musicStep, musicFinish };
+
+void musicPlayer(){
+    Task *t = createTask(&musicTask, "musicplayer", 120, 12);
+    t->rows.assign(6, string(33,' '));
+    t->vals.resize(30);
+    for(int j=0;j<30;j++) t->vals[j] = rand()%7;
+    launchTask(t, launchBackground);
+}
+
+/* ===============================
+   YOUTUBE ASCII (demo player)
+=============================== */
+void videoHeader(Task &){ cout<<"Playing video...\n"; }
+
+bool videoStep(Task &t){
+    if(t.frame >= t.frames) return false;
+    string &pix = t.rows[1];
+    if(t.frame > 0)
+        for(int k=0;k<5;k++){ int b = rand()%40; pix[b] = (pix[b]=='*') ? ' ' : '*'; }
+    char num[32]; sprintf(num, "Frame %d: [", t.frame+1);
+    t.rows[0] = num + pix + "]";
+    t.frame++;
+    return true;
+}
+
+void videoFinish(Task &t){
+    if(t.foreground) cout<<"\nVideo ended.\n\n";
+}
+
+const TaskKind videoTask = { true, videoHeader, videoStep, videoFinish };
+
+void youtubePlayer(){
+    asciiBorder("YOUTUBE ASCII BETA",64,9);
+    cout<<"Select demo video (1-5):\n1) Funny Cats\n2) Coding Tutorial\n3) VireonOS Demo\n4) ASCII Music\n5) Retro DOS\nChoose: ";
+    int ch=0; cin>>ch; cin.ignore();
+    if(ch < 1 || ch > 5){ cout<<"Invalid\n"; return; }
+    loadingBar("Preparing video",24,13);
+    Task *t = createTask(&videoTask, "youtube", 120, 15);
+    /* rows[0] = wiersz na ekranie, rows[1] = piksele */
+    t->rows.resize(2);
+    t->rows[1] = string(40,' ');
+    for(int b=0;b<40;b++) if(rand()%3==0) t->rows[1][b] = '*';
+    launchTask(t, launchBackground);
+}
+
+/* ===============================
+   PACKAGE REGISTRY
+   Nazwy paczek sa internowane: id = indeks w names, a tablica z otwarta
+   adresacja (probkowanie liniowe) zamienia nazwe na id. Czy paczka jest
+   zainstalowana, mowi flaga per id; listy wg rodzaju trzymaja kolejnosc
+   instalacji do wyswietlania. Stan zapisuje /var/lib/packages.db w VFS,
+   wiec migawki i rollback obejmuja go razem z /pkg.
+=============================== */
+enum PkgKind { PKG_APP, PKG_ENV, PKG_LIB, PKG_KINDS };
+const char *PKG_KIND_NAMES[PKG_KINDS] = { "app", "env", "lib" };
+const char *PKG_DB = "/var/lib/packages.db";
+
+struct Registry {
+    vector<string> names;           // id -> nazwa
+    vector<unsigned> hashes;        // id -> fnv1a(nazwa)
+    vector<int> slots;              // id+1, 0 = pusty; rozmiar 2^k
+    vector<char> installed;         // id -> zainstalowana
+    vector<string> versions;        // id -> zainstalowana wersja
+    vector<int> lists[PKG_KINDS];   // zainstalowane wg rodzaju, kolejnosc instalacji
+};
+Registry registry;
+
+int pkgKindOf(const string &s){
+    for(int k=0;k<PKG_KINDS;k++) if(s==PKG_KIND_NAMES[k]) return k;
+    return -1;
+}
+
+/* slot nazwy albo pierwszy pusty na jej sciezce probkowania */
+size_t regSlot(const string &name, unsigned hash){
+    size_t mask = registry.slots.size() - 1, i = hash & mask;
+    while(int id = registry.slots[i]){
+        if(registry.hashes[id-1]==hash && registry.names[id-1]==name) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+int regFind(const string &name){
+    if(registry.slots.empty()) return -1;
+    return registry.slots[regSlot(name, fnv1a(name.data(), name.size()))] - 1;
+}
+
+int regIntern(const string &name){
+    Registry &r = registry;
+    /* zapelnienie najwyzej 1/2: przebuduj na dwa razy wieksza tablice */
+    if((r.names.size() + 1) * 2 > r.slots.size()){
+        r.slots.assign(max((size_t)64, r.slots.size() * 2), 0);
+        for(size_t id=0;id<r.names.size();id++) r.slots[regSlot(r.names[id], r.hashes[id])] = (int)id + 1;
+    }
+    unsigned hash = fnv1a(name.data(), name.size());
+    size_t s = regSlot(name, hash);
+    if(r.slots[s]) return r.slots[s] - 1;
+    r.slots[s] = (int)r.names.size() + 1;
+    r.names.push_back(name);
+    r.hashes.push_back(hash);
+    r.installed.push_back(0);
+    r.versions.push_back("");
+    return (int)r.names.size() - 1;
+}
+
+bool regInstalled(int id){ return id >= 0 && registry.installed[id]; }
+bool regInstalled(const string &name){ return regInstalled(regFind(name)); }
+const string &regName(int id){ return registry.names[id]; }
+const vector<int> &regList(int kind){ return registry.lists[kind]; }
+
+void regAdd(int id, int kind, const string &version){
+    if(registry.installed[id]) return;
+    registry.installed[id] = 1;
+    registry.versions[id] = version;
+    registry.lists[kind].push_back(id);
+}
+
+/* caly stan od nowa: NAZWA WERSJA RODZAJ, w kolejnosci instalacji */
+bool regSave(){
+    string text;
+    for(int k=0;k<PKG_KINDS;k++)
+        for(size_t i=0;i<registry.lists[k].size();i++){
+            int id = registry.lists[k][i];
+            text += registry.names[id] + " " + registry.versions[id] + " " + PKG_KIND_NAMES[k] + "\n";
+        }
+    vfsMkdir("/var");
+    vfsMkdir("/var/lib");
+    return vfsWrite(PKG_DB, text);
+}
+
+/* stan z bazy w VFS (przy starcie i po rollback); internowane nazwy zostaja */
+void regLoad(){
+    Registry &r = registry;
+    r.installed.assign(r.names.size(), 0);
+    for(int k=0;k<PKG_KINDS;k++) r.lists[k].clear();
+    unsigned ino = vfsWalk(PKG_DB);
+    if(!ino || vfsInode(ino).type!=VFS_FILE) return;
+    string buf;
+    const VfsInode &f = vfsInode(ino);
+    istringstream in(string(vfsView(f, buf), f.length));
+    string name, version, kind;
+    while(in>>name>>version>>kind){
+        int k = pkgKindOf(kind);
+        if(k >= 0) regAdd(regIntern(name), k, version);
+    }
+}
+
+bool regEmpty(){
+    for(int k=0;k<PKG_KINDS;k++) if(!registry.lists[k].empty()) return false;
+    return true;
+}
+
+size_t registryBytes(){
+    Registry &r = registry;
+    size_t n = stringsBytes(r.names) + stringsBytes(r.versions) + r.hashes.capacity()*sizeof(unsigned)
+             + r.slots.capacity()*sizeof(int) + r.installed.capacity();
+    for(int k=0;k<PKG_KINDS;k++) n += r.lists[k].capacity()*sizeof(int);
+    return n;
+}
+
+/* ===============================
+   PACKAGES - manifest, zaleznosci, instalacja rownolegla
+   Manifest ma jedna paczke na linie: NAZWA WERSJA ROZMIAR_KB RODZAJ ZALEZNOSCI
+   (rodzaj app/env/lib, zaleznosci po przecinku albo "-", '#' = komentarz).
+   Instalacja bierze domkniecie zaleznosci, porzadkuje je topologicznie
+   (Kahn) i puszcza na pule workerow: paczka startuje, gdy skoncza sie
+   wszystkie jej zaleznosci; z gotowych najpierw ta z najdluzsza sciezka.
+   Workery to sloty jednego zadania schedulera, nie watki systemu.
+=============================== */
+const char *PKG_MANIFEST = "/etc/packages.txt";
+const int PKG_JOBS = 4, PKG_MAX_JOBS = 16;
+const int PKG_BAR = 20;
+
+const char *PKG_DEFAULT =
+    "# VireonOS package manifest\n"
+    "# NAME VERSION SIZE_KB KIND(app|env|lib) DEPS(a,b|-)\n"
+    "libc 2.1 2048 lib -\n"
+    "libgfx 1.4 4096 lib libc\n"
+    "libaudio 1.0 1536 lib libc\n"
+    "libnet 3.2 2560 lib libc\n"
+    "libui 1.7 3072 lib libgfx\n"
+    "TextEditor 1.2 900 app libui\n"
+    "WebBrowser 5.0 8192 app libui,libnet\n"
+    "MusicPlayer 2.3 1800 app libui,libaudio\n"
+    "Calculator 1.0 300 app libui\n"
+    "Paint 1.5 1200 app libui\n"
+    "Notes 1.1 400 app libui\n"
+    "SystemMonitor 0.9 700 app libui\n"
+    "MiniGames 3.0 5000 app libui,libaudio\n"
+    "DevKit 4.2 12000 app libc,TextEditor\n"
+    "GUI_Basic 1.0 6000 env libui\n"
+    "GUI_Advanced 2.0 9000 env GUI_Basic\n"
+    "Desktop_3D 0.8 15000 env GUI_Advanced,libgfx\n"
+    "RetroConsole 1.3 2000 env libc\n";
+
+struct Package {
+    string name, version;
+    int id, kind;           // id w rejestrze, PkgKind
+    int sizeKb;
+    vector<int> deps;       // indeksy w manifescie
+    vector<int> users;      // paczki, ktore zaleza od tej
+};
+struct Manifest {
+    string source;
+    vector<Package> pkgs;
+    map<string,int> byName;
+};
+Manifest manifest;
+
+int pkgFind(const string &name){
+    map<string,int>::const_iterator it = manifest.byName.find(name);
+    return it==manifest.byName.end() ? -1 : it->second;
+}
+
+/* dwa przejscia: najpierw nazwy, potem zaleznosci (kolejnosc linii dowolna) */
+bool pkgParse(const string &text, Manifest &m, string &err){
+    istringstream in(text);
+    string line;
+    vector<string> depText;
+    vector<int> depLine;
+    int ln = 0;
+    while(getline(in, line)){
+        ln++;
+        size_t hash = line.find('#');
+        if(hash!=string::npos) line.erase(hash);
+        istringstream ls(line);
+        Package p;
+        string kind, deps, extra;
+        if(!(ls>>p.name)) continue;
+        char buf[96];
+        if(!(ls>>p.version>>p.sizeKb>>kind>>deps) || (ls>>extra) || p.sizeKb < 0
+           || (p.kind = pkgKindOf(kind)) < 0){
+            sprintf(buf, "line %d: expected NAME VERSION SIZE_KB app|env|lib DEPS", ln);
+            err = buf; return false;
+        }
+        if(m.byName.count(p.name)){
+            sprintf(buf, "line %d: duplicate package ", ln);
+            err = buf + p.name; return false;
+        }
+        p.id = regIntern(p.name);
+        m.byName[p.name] = (int)m.pkgs.size();
+        m.pkgs.push_back(p);
+        depText.push_back(deps=="-" ? "" : deps);
+        depLine.push_back(ln);
+    }
+    for(size_t i=0;i<m.pkgs.size();i++){
+        istringstream ds(depText[i]);
+        string d;
+        while(getline(ds, d, ',')){
+            if(d.empty()) continue;
+            map<string,int>::const_iterator it = m.byName.find(d);
+            if(it==m.byName.end() || it->second==(int)i){
+                char buf[64]; sprintf(buf, "line %d: ", depLine[i]);
+                err = buf + m.pkgs[i].name + (it==m.byName.end() ? " needs unknown package " : " depends on itself ") + d;
+                return false;
+            }
+            m.pkgs[i].deps.push_back(it->second);
+            m.pkgs[it->second].users.push_back((int)i);
+        }
+    }
+    return true;
+}
+
+/* path puste = /etc/packages.txt (tworzony z domyslnego); inaczej plik VFS albo hosta */
+bool pkgLoad(const string &path, string &err){
+    string src = path.empty() ? PKG_MANIFEST : path, text;
+    unsigned ino = vfsWalk(src);
+    if(ino && vfsInode(ino).type==VFS_FILE){
+        string buf;
+        const VfsInode &f = vfsInode(ino);
+        text.assign(vfsView(f, buf), f.length);
+    } else if(path.empty()){
+        text = PKG_DEFAULT;
+        vfsMkdir("/etc");
+        vfsWrite(src, text);
+    } else {
+        ifstream in(src.c_str(), ios::binary);
+        if(!in){ err = "cannot open " + src; return false; }
+        ostringstream ss; ss<<in.rdbuf();
+        text = ss.str();
+        src = "host:" + src;
+    }
+    Manifest m;
+    if(!pkgParse(text, m, err)){ err = src + ": " + err; return false; }
+    m.source = src;
+    manifest = m;
+    return true;
+}
+
+/* udawana praca instalacji w ms: staly narzut + rozpakowanie */
+int pkgWorkMs(const Package &p){ return 250 + p.sizeKb / 16; }
+
+/* domkniecie zaleznosci bez zainstalowanych, w porzadku topologicznym */
+bool pkgPlan(const vector<int> &want, vector<int> &order, string &err){
+    vector<char> in(manifest.pkgs.size(), 0);
+    vector<int> stack;
+    for(size_t i=0;i<want.size();i++) stack.push_back(want[i]);
+    while(!stack.empty()){
+        int p = stack.back(); stack.pop_back();
+        if(in[p] || regInstalled(manifest.pkgs[p].id)) continue;
+        in[p] = 1;
+        for(size_t d=0;d<manifest.pkgs[p].deps.size();d++) stack.push_back(manifest.pkgs[p].deps[d]);
+    }
+    vector<int> indeg(manifest.pkgs.size(), 0);
+    size_t total = 0;
+    for(size_t p=0;p<in.size();p++){
+        if(!in[p]) continue;
+        total++;
+        for(size_t d=0;d<manifest.pkgs[p].deps.size();d++) if(in[manifest.pkgs[p].deps[d]]) indeg[p]++;
+    }
+    order.clear();
+    for(size_t p=0;p<in.size();p++) if(in[p] && indeg[p]==0) order.push_back((int)p);
+    for(size_t k=0;k<order.size();k++){
+        const vector<int> &u = manifest.pkgs[order[k]].users;
+        for(size_t j=0;j<u.size();j++) if(in[u[j]] && --indeg[u[j]]==0) order.push_back(u[j]);
+    }
+    if(order.size() < total){
+        err = "dependency cycle:";
+        for(size_t p=0;p<in.size();p++) if(in[p] && indeg[p] > 0) err += " " + manifest.pkgs[p].name;
+        return false;
+    }
+    return true;
+}
+
+/* stan biezacej instalacji (jedna naraz) */
+struct PkgWorker { int pkg; long long startAt, doneAt; };
+struct PkgRun {
+    bool active, failed;
+    string error;
+    vector<int> order;
+    vector<int> waiting;                    // niezakonczone zaleznosci, per paczka manifestu
+    vector<long long> path;                 // najdluzsza sciezka do konca planu (us)
+    priority_queue< pair<long long,int> > ready;
+    vector<PkgWorker> workers;
+    vector<int> done;
+    long long startAt, serialUs;
+};
+PkgRun pkgRun;
+
+string pkgBar(long long num, long long den){
+    int fill = den > 0 ? (int)(num * PKG_BAR / den) : PKG_BAR;
+    if(fill > PKG_BAR) fill = PKG_BAR;
+    return "[" + string(fill,'#') + string(PKG_BAR - fill,' ') + "]";
+}
+
+void pkgRows(Task &t){
+    PkgRun &r = pkgRun;
+    long long now = clockNow();
+    char line[160];
+    sprintf(line, "Total %s %4d/%-4d %3d%%", pkgBar(r.done.size(), r.order.size()).c_str(),
+            (int)r.done.size(), (int)r.order.size(), (int)(r.done.size() * 100 / max((size_t)1, r.order.size())));
+    t.rows[0] = line;
+    for(size_t w=0;w<r.workers.size();w++){
+        const PkgWorker &k = r.workers[w];
+        if(k.pkg < 0){ sprintf(line, " #%-2d %-16s idle", (int)w+1, ""); t.rows[w+1] = line; continue; }
+        const Package &p = manifest.pkgs[k.pkg];
+        long long span = k.doneAt - k.startAt;
+        sprintf(line, " #%-2d %-16.16s %s %3d%%", (int)w+1, p.name.c_str(),
+                pkgBar(now - k.startAt, span).c_str(), (int)(span > 0 ? min(100LL, (now - k.startAt) * 100 / span) : 100));
+        t.rows[w+1] = line;
+    }
+}
+
+string pkgReceipt(const Package &p){
+    string rec = p.name + " " + p.version + "\nkind " + PKG_KIND_NAMES[p.kind] + "\ndeps";
+    for(size_t d=0;d<p.deps.size();d++) rec += " " + manifest.pkgs[p.deps[d]].name;
+    return rec + "\n";
+}
+
+/* paczka gotowa: zwolnij zalezne (pokwitowanie dopiero przy zatwierdzeniu) */
+void pkgComplete(int pkg){
+    PkgRun &r = pkgRun;
+    const Package &p = manifest.pkgs[pkg];
+    r.done.push_back(pkg);
+    for(size_t u=0;u<p.users.size();u++)
+        if(--r.waiting[p.users[u]]==0) r.ready.push(make_pair(r.path[p.users[u]], p.users[u]));
+}
+
+bool pkgStep(Task &t){
+    PkgRun &r = pkgRun;
+    if(t.frame >= t.frames && r.done.size() < r.order.size()) return false;   // kill
+    long long now = clockNow(), next = -1;
+    bool busy = false;
+    for(size_t w=0;w<r.workers.size();w++){
+        PkgWorker &k = r.workers[w];
+        if(k.pkg >= 0 && k.doneAt <= now){ pkgComplete(k.pkg); k.pkg = -1; }
+        if(k.pkg < 0 && !r.failed && !r.ready.empty()){
+            k.pkg = r.ready.top().second;
+            r.ready.pop();
+            k.startAt = now;
+            k.doneAt = now + (long long)pkgWorkMs(manifest.pkgs[k.pkg]) * 1000;
+        }
+        if(k.pkg >= 0){
+            busy = true;
+            if(next < 0 || k.doneAt < next) next = k.doneAt;
+        }
+    }
+    pkgRows(t);
+    if(!busy) return false;
+    /* animacja co 50 ms, ale nie przesypiaj konca instalacji */
+    t.delayMs = (int)max(1LL, min(50LL, (next - now + 999) / 1000));
+    t.frame = (int)r.done.size();
+    return true;
+}
+
+/* transakcja: instalacja pisze tylko przy zatwierdzeniu (pokwitowania,
+   potem baza); przerwana niczego nie zostawia, a reszty VFS nie dotyka */
+void pkgFinish(Task &t){
+    PkgRun &r = pkgRun;
+    r.active = false;
+    if(t.foreground && screen.canRewind()) drawTask(t);   // ostatnia klatka
+    if(!r.failed && r.done.size()==r.order.size()){
+        for(size_t i=0;i<r.done.size() && !r.failed;i++){
+            const Package &p = manifest.pkgs[r.done[i]];
+            if(!vfsWrite("/pkg/" + p.name, pkgReceipt(p))){ r.failed = true; r.error = "cannot write /pkg/" + p.name; }
+            else regAdd(p.id, p.kind, p.version);
+        }
+        if(!r.failed && !regSave()){ r.failed = true; r.error = string("cannot write ") + PKG_DB; }
+    }
+    if(r.failed || r.done.size() < r.order.size()){
+        if(r.error.empty()) r.error = "interrupted";
+        regLoad();                          // baza nie zostala zapisana: stan sprzed instalacji
+        logEvent(LOG_ERROR, "Install failed: %s", r.error.c_str());
+        if(t.foreground) cout<<"\nInstall failed ("<<r.error<<"), nothing was installed.\n\n";
+        return;
+    }
+    for(size_t i=0;i<r.done.size();i++)
+        logEvent(LOG_INFO, "Installed package: %s", manifest.pkgs[r.done[i]].name.c_str());
+    if(!t.foreground) return;
+    long long us = clockNow() - r.startAt;
+    char line[160];
+    sprintf(line, "\nInstalled %d package(s) on %d worker(s) in %.1f s (sequential %.1f s, %.1fx)\n\n",
+            (int)r.done.size(), (int)r.workers.size(), us / 1e6, r.serialUs / 1e6,
+            us > 0 ? (double)r.serialUs / us : 1.0);
+    cout<<line;
+}
+
+const TaskKind pkgTask = { false, 0, pkgStep, pkgFinish };
+
+/* trwajaca instalacja trzyma indeksy manifestu: do jej konca nie wolno
+   wczytac innego */
+bool pkgBusy(){
+    if(pkgRun.active) cout<<"Another install is running.\n\n";
+    return pkgRun.active;
+}
+
+/* instaluje want razem z zaleznosciami; false = nic nie ruszono */
+bool pkgInstall(const vector<int> &want, int jobs){
+    PkgRun &r = pkgRun;
+    if(pkgBusy()) return false;
+    string err;
+    vector<int> order;
+    if(!pkgPlan(want, order, err)){ cout<<"Cannot install: "<<err<<"\n\n"; return false; }
+    if(order.empty()){ cout<<"Nothing to install, all selected packages are present.\n\n"; return false; }
+    jobs = max(1, min(jobs, PKG_MAX_JOBS));
+    r = PkgRun();
+    r.order = order;
+    r.waiting.assign(manifest.pkgs.size(), 0);
+    r.path.assign(manifest.pkgs.size(), 0);
+    r.serialUs = 0;
+    vector<char> in(manifest.pkgs.size(), 0);
+    for(size_t i=0;i<order.size();i++) in[order[i]] = 1;
+    long long critical = 0;
+    for(size_t i=order.size(); i-- > 0;){
+        int p = order[i];
+        long long own = (long long)pkgWorkMs(manifest.pkgs[p]) * 1000, tailUs = 0;
+        for(size_t u=0;u<manifest.pkgs[p].users.size();u++)
+            tailUs = max(tailUs, r.path[manifest.pkgs[p].users[u]]);
+        r.path[p] = own + tailUs;
+        r.serialUs += own;
+        critical = max(critical, r.path[p]);
+        for(size_t d=0;d<manifest.pkgs[p].deps.size();d++) if(in[manifest.pkgs[p].deps[d]]) r.waiting[p]++;
+    }
+    for(size_t i=0;i<order.size();i++) if(r.waiting[order[i]]==0) r.ready.push(make_pair(r.path[order[i]], order[i]));
+    PkgWorker idle = { -1, 0, 0 };
+    r.workers.assign(jobs, idle);
+    char line[160];
+    sprintf(line, "Plan: %d package(s), %d worker(s), critical path %.1f s, sequential %.1f s\n",
+            (int)order.size(), jobs, critical / 1e6, r.serialUs / 1e6);
+    cout<<line;
+    /* punkt powrotu przed zmianami: rollback pre-install */
+    if(vfsSnapshot("pre-install")) addLog("Snapshot created: pre-install");
+    vfsMkdir("/pkg");
+    r.active = true;
+    r.startAt = clockNow();
+    Task *t = createTask(&pkgTask, "install", 0, (int)order.size());
+    t->color = 10;
+    t->rows.resize(jobs + 1);
+    pkgRows(*t);
+    launchTask(t, launchBackground);
+    return true;
+}
+
+/* install PKG... | --all  [--jobs N] [--manifest PATH] */
+void installPackages(const string &args){
+    istringstream in(args);
+    string w, path, err;
+    vector<string> names;
+    int jobs = PKG_JOBS;
+    bool all = false;
+    while(in>>w){
+        if(w=="--all") all = true;
+        else if(w=="--jobs"){ if(!(in>>jobs) || jobs < 1){ cout<<"\n--jobs needs a number\n\n"; return; } }
+        else if(w=="--manifest"){ if(!(in>>path)){ cout<<"\n--manifest needs a path\n\n"; return; } }
+        else names.push_back(w);
+    }
+    if(!all && names.empty()){ cout<<"\nUsage: install PKG...|--all [--jobs N] [--manifest PATH]\n\n"; return; }
+    if(pkgBusy()) return;
+    if(!pkgLoad(path, err)){ cout<<"\nManifest error: "<<err<<"\n\n"; return; }
+    vector<int> want;
+    for(size_t i=0;i<names.size();i++){
+        int p = pkgFind(names[i]);
+        if(p < 0){ cout<<"\nUnknown package: "<<names[i]<<" (see "<<manifest.source<<")\n\n"; return; }
+        want.push_back(p);
+    }
+    if(all) for(size_t i=0;i<manifest.pkgs.size();i++) want.push_back((int)i);
+    cout<<"\n";
+    procEnter(PID_INSTALLER);
+    pkgInstall(want, jobs);
+    procLeave();
+}
+
+/* packages: zainstalowane wg rodzaju, w kolejnosci instalacji */
+void listPackages(){
+    static const char *titles[PKG_KINDS] = { "Programs", "Environments", "Libraries" };
+    setColor(11);
+    cout<<"\n--- Packages ---\n";
+    setColor(7);
+    if(regEmpty()) cout<<" (none, run install or installer)\n";
+    for(int k=0;k<PKG_KINDS;k++){
+        const vector<int> &ids = regList(k);
+        if(ids.empty()) continue;
+        cout<<titles[k]<<":\n";
+        for(size_t i=0;i<ids.size();i++){
+            char line[128];
+            sprintf(line, "  %-16s %s\n", regName(ids[i]).c_str(), registry.versions[ids[i]].c_str());
+            cout<<line;
+        }
+    }
+    cout<<"\n";
+}
+
+/* ===============================
+   INSTALLER (expanded) - C++98-compatible
+=============================== */
+/* false = koniec wejscia (skrypt, potok): wybor anulowany */
+bool pkgMenu(const char *title, int kind, vector<int> &want){
+    vector<int> items;
+    for(size_t i=0;i<manifest.pkgs.size();i++) if(manifest.pkgs[i].kind==kind) items.push_back((int)i);
+    cout<<"\nAvailable "<<title<<"s:\n";
+    for(size_t i=0;i<items.size();i++){
+        const Package &p = manifest.pkgs[items[i]];
+        char line[128];
+        sprintf(line, " %2d) %-16s %-6s %6d KB%s\n", (int)i+1, p.name.c_str(), p.version.c_str(), p.sizeKb,
+                regInstalled(p.id) ? "  (installed)" : "");
+        cout<<line;
+    }
+    cout<<"  0) finish selection\n";
+    int choice;
+    while(true){
+        cout<<"Select "<<toLowerStr(title)<<" number to install (0 to finish): ";
+        if(!(cin>>choice)){
+            if(cin.eof()){ cout<<"\n"; return false; }
+            cin.clear(); cin.ignore(1024, '\n'); cout<<"Invalid selection\n"; continue;
+        }
+        if(choice==0) return true;
+        if(choice < 1 || choice > (int)items.size()){ cout<<"Invalid selection\n"; continue; }
+        const Package &p = manifest.pkgs[items[choice-1]];
+        if(regInstalled(p.id) || find(want.begin(), want.end(), items[choice-1])!=want.end())
+            cout<<p.name<<" already selected or installed.\n";
+        else {
+            want.push_back(items[choice-1]);
+            cout<<p.name<<" selected.\n";
+        }
+    }
+}
+
+void installer(){
+    procEnter(PID_INSTALLER);
+    asciiBorder("VIREON INSTALLER",60,11);
+    smallLogo("installer");
+    addLog("Installer launched");
+    string err;
+    if(pkgBusy()){ procLeave(); return; }
+    if(!pkgLoad("", err)){
+        cout<<"Manifest error: "<<err<<"\n\n";
+        procLeave();
+        return;
+    }
+    cout<<"Manifest: "<<manifest.source<<" ("<<manifest.pkgs.size()<<" packages)\n";
+
+    /* wybor najpierw, potem jedna instalacja z zaleznosciami */
+    vector<int> want;
+    if(!pkgMenu("Program", PKG_APP, want) || !pkgMenu("Environment", PKG_ENV, want)){
+        cout<<"Selection cancelled.\n\n";
+        addLog("Installer cancelled");
+        procLeave();
+        return;
+    }
+    cout<<"\n";
+    if(!want.empty()){
+        bool bg = launchBackground;
+        launchBackground = false;
+        pkgInstall(want, PKG_JOBS);
+        launchBackground = bg;
+    }
+
+    cout<<"Auto-configure startup services? (y/n): ";
+    char yn = 'n'; cin>>yn;             // koniec wejscia = nie
+    if(tolower(yn)=='y'){
+        loadingBar("Configuring services", 20, 14);
+        addLog("Services configured");
+        cout<<"Services configured.\n\n";
+    }
+
+    cout<<"Installation finished. Installed items:\n";
+    for(size_t i=0;i<regList(PKG_APP).size();i++) cout<<" - "<<regName(regList(PKG_APP)[i])<<"\n";
+    for(size_t i=0;i<regList(PKG_ENV).size();i++) cout<<" - "<<regName(regList(PKG_ENV)[i])<<"\n";
+    cout<<"\n";
+    addLog("Installer finished");
+    procLeave();
+}
+
+/* ===============================
+   ENVIRONMENT CHANGE
+=============================== */
+void changeEnvironment(){
+    const vector<int> &envs = regList(PKG_ENV);
+    cout<<"Available Environments:\n";
+    for(size_t i=0;i<envs.size();i++){
+        cout<<" "<<i+1<<") "<<regName(envs[i])<<"\n";
+    }
+    cout<<"Select number: ";
+    int c; cin>>c;
+    if(c>=1 && c <= (int)envs.size()){
+        currentEnvironment = regName(envs[c-1]);
+        logEvent(LOG_INFO, "Environment changed to %s", currentEnvironment.c_str());
+        cout<<"Environment set to "<<currentEnvironment<<"\n\n";
+    } else {
+        cout<<"Invalid choice or no environments installed.\n\n";
+    }
+}
+
+/* ===============================
+   WSM / COMMANDS TABLE (visually improved)
+=============================== */
+void drawCommandsTable(){
+    asciiBorder("COMMANDS REFERENCE",72,14);
+    setColor(14);
+
+    const vector<Command> &cmds = shellCommands.cmds;
+    vector<const char*> groups;
+    for(size_t i=0;i<cmds.size();i++){
+        bool seen = false;
+        for(size_t g=0;g<groups.size();g++) if(strcmp(groups[g], cmds[i].group)==0){ seen = true; break; }
+        if(!seen) groups.push_back(cmds[i].group);
+    }
+
+    for(size_t g=0;g<groups.size();g++){
+        cout<<"["<<groups[g]<<"]\n";
+        for(size_t i=0;i<cmds.size();i++){
+            if(cmds[i].hidden || strcmp(cmds[i].group, groups[g])!=0) continue;
+            char line[256];
+            sprintf(line, "  %-16s - %s\n", cmds[i].usage, cmds[i].desc);
+            cout<<line;
+        }
+        cout<<"\n";
+    }
+    setColor(7);
+    asciiBorder("END COMMANDS",72,14);
+}
+
+/* ===============================
+   FASTFETCH / EXTENDED
+=============================== */
+void fastfetch(){
+    setColor(13);
+    cout<<OS_NAME<<" | "<<KERNEL_VERSION<<" | User: "<<CURRENT_USER<<" | Env: "<<currentEnvironment<<" | Uptime: "<<getUptime()<<"\n\n";
+    setColor(7);
+}
+
+void extendedFastfetch(){
+    asciiBorder("EXTENDED SYSTEM INFO",60,13);
+    setColor(13);
+    cout<<" OS: "<<OS_NAME<<"\n";
+    cout<<" Kernel: "<<KERNEL_VERSION<<"\n";
+    cout<<" User: "<<CURRENT_USER<<"\n";
+    cout<<" Environment: "<<currentEnvironment<<"\n";
+    cout<<" Uptime: "<<getUptime()<<"\n";
+    cout<<" Installed Programs:\n   ";
+    const vector<int> &apps = regList(PKG_APP), &envs = regList(PKG_ENV);
+    for(size_t i=0;i<apps.size();i++){
+        cout<<regName(apps[i])<<"  ";
+        if((i+1)%4==0) cout<<"\n   ";
+    }
+    cout<<"\n Installed Environments:\n   ";
+    for(size_t i=0;i<envs.size();i++){
+        cout<<regName(envs[i])<<"  ";
+    }
+    cout<<"\n";
+    setColor(7);
+    asciiBorder("END EXTENDED INFO",60,13);
 }
 
 /* ===============================
-   NOTES APP
+   BROWSER HISTORY
+   Adresy sa internowane: id w tablicy z otwarta adresacja (jak rejestr
+   paczek; usuwanie przesuwa wpisy wstecz, bez nagrobkow). Wizyty ida do
+   pierscienia HISTORY_KEEP ostatnich; adres bez zachowanej wizyty wypada
+   z historii, a jego id wraca do puli. Frecency to log2 sumy 2^(t/HALF)
+   po wizytach, t = czas scienny (time(0), jak w logu: przezywa restart
+   hosta i nie zalezy od zegara wirtualnego ani "clock fast"); rosnie tylko przy wizycie, a uplyw czasu nie zmienia
+   kolejnosci. Autouzupelnianie: skompresowane drzewo prefiksowe (radix),
+   kazdy wezel zna najwieksza frecency w poddrzewie, wiec top-k to
+   przeszukiwanie "najpierw najlepszy" bez przegladania calego poddrzewa.
+   Karty maja wlasne stosy back/forward (adresy, najwyzej TAB_STACK).
 =============================== */
-void notesApp(){
-    cin.ignore();
-    string line;
-    cout<<"Notes - enter lines. Single '.' on a line to finish.\n";
+const unsigned HISTORY_KEEP = 1u << 20;            // zachowane wizyty
+const double HISTORY_HALF_LIFE = 3*24*3600.0;      // s
+const int HISTORY_SUGGEST = 8;
+const size_t TAB_STACK = 50;
+const double FRECENCY_NONE = -1e300;
+
+struct HistoryUrl {
+    string url;
+    unsigned hash;
+    unsigned visits;            // wizyty w pierscieniu
+    unsigned total;             // wszystkie wizyty
+    long long lastVisit;        // time(0) ostatniej wizyty
+    double frecency;            // log2 sumy 2^(t/HALF)
+    int node;                   // wezel drzewa; -1 = id wolne
+};
+struct TrieNode {
+    string label;               // fragment adresu od rodzica
+    int parent, child, sibling;
+    int url;                    // id adresu konczacego sie tutaj, -1 = brak
+    double best;                // najwieksza frecency w poddrzewie
+};
+struct History {
+    vector<HistoryUrl> urls;
+    vector<int> freeIds;
+    vector<int> slots;          // id+1, 0 = pusty; rozmiar 2^k
+    size_t live;                // adresy w historii
+    vector<TrieNode> nodes;     // nodes[0] = korzen
+    vector<int> freeNodes;
+    vector<unsigned> ring;      // id adresow wizyt
+    size_t ringHead;            // najstarsza wizyta, gdy pierscien pelny
+    History(): live(0), ringHead(0) {}
+};
+History history;
+
+/* log2(2^a + 2^b) bez przepelnien */
+double logAdd2(double a, double b){
+    if(a < b) swap(a, b);
+    if(b <= FRECENCY_NONE) return a;
+    return a + log(1.0 + pow(2.0, b - a)) / log(2.0);
+}
+
+int trieNew(const string &label, int parent){
+    TrieNode n;
+    n.label = label; n.parent = parent; n.child = n.sibling = n.url = -1; n.best = FRECENCY_NONE;
+    if(!history.freeNodes.empty()){
+        int i = history.freeNodes.back(); history.freeNodes.pop_back();
+        history.nodes[i] = n;
+        return i;
+    }
+    history.nodes.push_back(n);
+    return (int)history.nodes.size() - 1;
+}
+
+int trieChild(int n, char c){
+    for(int k = history.nodes[n].child; k >= 0; k = history.nodes[k].sibling)
+        if(history.nodes[k].label[0]==c) return k;
+    return -1;
+}
+
+void trieReplaceChild(int parent, int from, int to){
+    vector<TrieNode> &N = history.nodes;
+    if(N[parent].child==from){ N[to].sibling = N[from].sibling; N[parent].child = to; return; }
+    for(int k = N[parent].child; k >= 0; k = N[k].sibling)
+        if(N[k].sibling==from){ N[to].sibling = N[from].sibling; N[k].sibling = to; return; }
+}
+
+void trieUnlink(int parent, int n){
+    vector<TrieNode> &N = history.nodes;
+    if(N[parent].child==n){ N[parent].child = N[n].sibling; return; }
+    for(int k = N[parent].child; k >= 0; k = N[k].sibling)
+        if(N[k].sibling==n){ N[k].sibling = N[n].sibling; return; }
+}
+
+/* best od n w gore: po wzroscie wystarczy porownanie, po spadku liczymy od nowa */
+void trieRaise(int n, double f){
+    for(; n >= 0 && history.nodes[n].best < f; n = history.nodes[n].parent) history.nodes[n].best = f;
+}
+
+void trieRecompute(int n){
+    vector<TrieNode> &N = history.nodes;
+    for(; n >= 0; n = N[n].parent){
+        double b = N[n].url >= 0 ? history.urls[N[n].url].frecency : FRECENCY_NONE;
+        for(int k = N[n].child; k >= 0; k = N[k].sibling) b = max(b, N[k].best);
+        N[n].best = b;
+    }
+}
+
+int trieInsert(const string &s, int id){
+    vector<TrieNode> &N = history.nodes;
+    if(N.empty()) trieNew("", -1);
+    int n = 0;
+    size_t pos = 0;
+    while(pos < s.size()){
+        int c = trieChild(n, s[pos]);
+        if(c < 0){
+            int leaf = trieNew(s.substr(pos), n);
+            N[leaf].sibling = N[n].child;
+            N[n].child = leaf;
+            n = leaf;
+            break;
+        }
+        const string &lab = N[c].label;
+        size_t l = 0;
+        while(l < lab.size() && pos + l < s.size() && lab[l]==s[pos+l]) l++;
+        if(l < lab.size()){
+            /* podzial krawedzi: wspolny poczatek jako nowy wezel posredni */
+            int mid = trieNew(lab.substr(0, l), n);
+            trieReplaceChild(n, c, mid);
+            N[c].label.erase(0, l);
+            N[c].parent = mid;
+            N[c].sibling = -1;
+            N[mid].child = c;
+            N[mid].best = N[c].best;
+            c = mid;
+        }
+        n = c;
+        pos += l;
+    }
+    N[n].url = id;
+    return n;
+}
+
+void trieRemove(int n){
+    vector<TrieNode> &N = history.nodes;
+    N[n].url = -1;
+    /* pusty lisc znika; wezel bez adresu z jednym dzieckiem skleja sie z nim */
+    while(n > 0 && N[n].url < 0 && N[n].child < 0){
+        int p = N[n].parent;
+        trieUnlink(p, n);
+        history.freeNodes.push_back(n);
+        string().swap(N[n].label);
+        n = p;
+    }
+    if(n > 0 && N[n].url < 0 && N[N[n].child].sibling < 0){
+        int c = N[n].child, p = N[n].parent;
+        N[c].label = N[n].label + N[c].label;
+        N[c].parent = p;
+        trieReplaceChild(p, n, c);
+        history.freeNodes.push_back(n);
+        string().swap(N[n].label);
+        n = p;
+    }
+    trieRecompute(n);
+}
+
+size_t historySlot(const string &url, unsigned hash){
+    size_t mask = history.slots.size() - 1, i = hash & mask;
+    while(int id = history.slots[i]){
+        const HistoryUrl &u = history.urls[id-1];
+        if(u.hash==hash && u.url==url) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+int historyFind(const string &url){
+    if(history.slots.empty()) return -1;
+    return history.slots[historySlot(url, fnv1a(url.data(), url.size()))] - 1;
+}
+
+int historyIntern(const string &url){
+    History &h = history;
+    if((h.live + 1) * 2 > h.slots.size()){
+        h.slots.assign(max((size_t)64, h.slots.size() * 2), 0);
+        for(size_t id=0;id<h.urls.size();id++)
+            if(h.urls[id].node >= 0) h.slots[historySlot(h.urls[id].url, h.urls[id].hash)] = (int)id + 1;
+    }
+    unsigned hash = fnv1a(url.data(), url.size());
+    size_t s = historySlot(url, hash);
+    if(h.slots[s]) return h.slots[s] - 1;
+    int id;
+    if(!h.freeIds.empty()){ id = h.freeIds.back(); h.freeIds.pop_back(); }
+    else { id = (int)h.urls.size(); h.urls.push_back(HistoryUrl()); }
+    HistoryUrl &u = h.urls[id];
+    u.url = url; u.hash = hash; u.visits = u.total = 0; u.lastVisit = 0; u.frecency = FRECENCY_NONE;
+    u.node = trieInsert(url, id);
+    h.slots[s] = id + 1;
+    h.live++;
+    return id;
+}
+
+/* usuniecie z przesunieciem wstecz: kolejne wpisy klastra wracaja blizej domu */
+void historyForget(int id){
+    History &h = history;
+    HistoryUrl &u = h.urls[id];
+    size_t mask = h.slots.size() - 1, i = historySlot(u.url, u.hash), j = i;
     while(true){
-        getline(cin,line);
-        if(line==".") break;
-        fileSystem["notes.txt"] += line + "\n";
-        addLog("Note added");
+        j = (j + 1) & mask;
+        if(!h.slots[j]) break;
+        size_t home = h.urls[h.slots[j]-1].hash & mask;
+        if(((j - home) & mask) >= ((j - i) & mask)){ h.slots[i] = h.slots[j]; i = j; }
     }
-    cout<<"Notes saved to notes.txt\n\n";
+    h.slots[i] = 0;
+    trieRemove(u.node);
+    u.node = -1;
+    string().swap(u.url);
+    h.freeIds.push_back(id);
+    h.live--;
+}
+
+/* wizyta do pierscienia bez zmiany frecency (tez przy odtwarzaniu sesji) */
+void historyRingPush(int id){
+    History &h = history;
+    h.urls[id].visits++;
+    if(h.ring.size() < HISTORY_KEEP){ h.ring.push_back((unsigned)id); return; }
+    unsigned old = h.ring[h.ringHead];
+    h.ring[h.ringHead] = (unsigned)id;
+    h.ringHead = (h.ringHead + 1) % HISTORY_KEEP;
+    if(--h.urls[old].visits==0) historyForget((int)old);
+}
+
+void historyVisitId(int id){
+    HistoryUrl &u = history.urls[id];
+    long long now = (long long)time(0);
+    u.frecency = logAdd2(u.frecency, now / HISTORY_HALF_LIFE);
+    u.total++;
+    u.lastVisit = now;
+    trieRaise(u.node, u.frecency);
+    historyRingPush(id);
+}
+
+void historyVisit(const string &url){ historyVisitId(historyIntern(url)); }
+
+void historyClear(){ history = History(); }
+
+/* i-ta wizyta od najstarszej */
+int historyAt(size_t i){ return (int)history.ring[(history.ringHead + i) % history.ring.size()]; }
+
+/* najwyzej k adresow z prefiksem, malejaco wg frecency */
+void historySuggest(const string &prefix, int k, vector<int> &out){
+    out.clear();
+    const vector<TrieNode> &N = history.nodes;
+    if(N.empty()) return;
+    int n = 0;
+    size_t pos = 0;
+    while(pos < prefix.size()){
+        int c = trieChild(n, prefix[pos]);
+        if(c < 0) return;
+        const string &lab = N[c].label;
+        size_t l = 0;
+        while(l < lab.size() && pos + l < prefix.size() && lab[l]==prefix[pos+l]) l++;
+        if(pos + l < prefix.size() && l < lab.size()) return;
+        n = c;
+        pos += l;
+    }
+    /* kolejka: (wynik, (1 = adres wezla / 0 = poddrzewo, wezel)); przy remisie
+       adres wygrywa z poddrzewem, inaczej rowne wyniki rozwinelyby cale drzewo */
+    priority_queue< pair<double, pair<int,int> > > q;
+    q.push(make_pair(N[n].best, make_pair(0, n)));
+    while(!q.empty() && (int)out.size() < k){
+        pair<double, pair<int,int> > top = q.top(); q.pop();
+        const TrieNode &t = N[top.second.second];
+        if(top.second.first){ out.push_back(t.url); continue; }
+        if(t.url >= 0) q.push(make_pair(history.urls[t.url].frecency, make_pair(1, top.second.second)));
+        for(int c = t.child; c >= 0; c = N[c].sibling) q.push(make_pair(N[c].best, make_pair(0, c)));
+    }
+}
+
+/* biezaca frecency jako liczba "swiezych wizyt" */
+double historyScore(int id){
+    return pow(2.0, history.urls[id].frecency - (double)time(0) / HISTORY_HALF_LIFE);
+}
+
+size_t historyBytes(){
+    const History &h = history;
+    size_t n = h.urls.capacity()*sizeof(HistoryUrl) + h.nodes.capacity()*sizeof(TrieNode)
+             + h.slots.capacity()*sizeof(int) + h.ring.capacity()*sizeof(unsigned)
+             + (h.freeIds.capacity() + h.freeNodes.capacity())*sizeof(int);
+    for(size_t i=0;i<h.urls.size();i++) n += h.urls[i].url.capacity();
+    for(size_t i=0;i<h.nodes.size();i++) n += h.nodes[i].label.capacity();
+    return n;
 }
 
 /* ===============================
-   PAINT (ASCII)
+   PAGE CACHE
+   Strony przegladarki renderuja sie raz do bufora (znak + kolor na znak),
+   a potem sa tylko kopiowane na ekran jednym blit. Cache po URL z LRU na
+   liscie wbudowanej w sloty (prev/next), limit w bajtach; najdawniej
+   uzyta strona wypada pierwsza. refresh renderuje strone od nowa.
 =============================== */
-void paint(){
-    asciiBorder("PAINT - ASCII CANVAS",48,12);
-    for(int y=0;y<8;y++){
-        cout<<"| ";
-        for(int x=0;x<40;x++){
-            cout<<(rand()%3==0? '#' : ' ');
+const size_t PAGE_CACHE_BUDGET = 256*1024;
+
+struct CachedPage {
+    string url, text, attrs;
+    string stamp;                   // wersja zrodla (file://), inna = nieaktualna
+    vector<string> links;           // linki [n] tak, jak je narysowano
+    int prev, next;                 // LRU: head = ostatnio uzyta
+    bool prefetched;                // z prefetch, jeszcze nie ogladana
+};
+struct PageCache {
+    vector<CachedPage> slots;
+    vector<int> freeSlots;
+    map<string,int> index;
+    int head, tail;
+    size_t bytes, budget;
+    size_t prefetchBytes;           // strony z prefetch jeszcze nie ogladane
+    long hits, misses, evictions, uncached;
+    long prefetched, prefetchHits, prefetchWasted, prefetchCancelled;
+    long long renderMicros, blitMicros;
+    PageCache(): head(-1), tail(-1), bytes(0), budget(PAGE_CACHE_BUDGET), prefetchBytes(0),
+                 hits(0), misses(0), evictions(0), uncached(0),
+                 prefetched(0), prefetchHits(0), prefetchWasted(0), prefetchCancelled(0), renderMicros(0), blitMicros(0) {}
+};
+PageCache pageCache;
+
+/* cout do bufora strony; kolor bierze z biezacego atrybutu ekranu */
+class PageCapture : public streambuf {
+public:
+    string text, attrs, stamp;
+    vector<string> links;
+protected:
+    virtual int overflow(int c){
+        if(c != EOF){ text += (char)c; attrs += (char)screen.getAttr(); }
+        return c==EOF ? 0 : c;
+    }
+    virtual streamsize xsputn(const char *s, streamsize n){
+        text.append(s, (size_t)n);
+        attrs.append((size_t)n, (char)screen.getAttr());
+        return n;
+    }
+};
+
+void browserRender(const string &u, vector<string> *links);
+
+/* linki ostatnio pokazanej strony: follow N bierze numer z tego, co widac */
+string pageShownUrl;
+vector<string> pageShownLinks;
+
+size_t pageBytes(const CachedPage &p){
+    size_t n = sizeof(CachedPage) + p.url.size() + p.text.size() + p.attrs.size() + p.stamp.size();
+    for(size_t i=0;i<p.links.size();i++) n += sizeof(string) + p.links[i].size();
+    return n;
+}
+
+/* file:// zalezy od pliku w VFS: inode, dlugosc, czas i polozenie tresci;
+   brak pliku to tez wersja ("-"). Pozostale strony sie nie zmieniaja. */
+string pageStamp(const string &url){
+    if(url.compare(0, 7, "file://")!=0) return "";
+    unsigned ino = vfsWalk(url.substr(7));
+    if(!ino || vfsInode(ino).type!=VFS_FILE) return "-";
+    const VfsInode &f = vfsInode(ino);
+    char buf[80];
+    sprintf(buf, "%u:%u:%u:%u:%u", ino, f.length, f.mtime, f.offset, f.tail);
+    return buf;
+}
+
+void pageUnlink(int i){
+    PageCache &c = pageCache;
+    CachedPage &p = c.slots[i];
+    if(p.prev >= 0) c.slots[p.prev].next = p.next; else c.head = p.next;
+    if(p.next >= 0) c.slots[p.next].prev = p.prev; else c.tail = p.prev;
+}
+
+void pagePushFront(int i){
+    PageCache &c = pageCache;
+    c.slots[i].prev = -1;
+    c.slots[i].next = c.head;
+    if(c.head >= 0) c.slots[c.head].prev = i; else c.tail = i;
+    c.head = i;
+}
+
+void pageRemove(int i){
+    PageCache &c = pageCache;
+    CachedPage &p = c.slots[i];
+    pageUnlink(i);
+    if(p.prefetched){ c.prefetchWasted++; c.prefetchBytes -= pageBytes(p); }
+    c.bytes -= pageBytes(p);
+    c.index.erase(p.url);
+    string().swap(p.url); string().swap(p.text); string().swap(p.attrs);
+    string().swap(p.stamp); vector<string>().swap(p.links);
+    c.freeSlots.push_back(i);
+}
+
+void pageEvictTo(size_t budget){
+    PageCache &c = pageCache;
+    while(c.bytes > budget && c.tail >= 0){ pageRemove(c.tail); c.evictions++; }
+}
+
+void pageForget(const string &url){
+    map<string,int>::iterator it = pageCache.index.find(url);
+    if(it!=pageCache.index.end()) pageRemove(it->second);
+}
+
+/* renderuje strone do slotu; -1 gdy jest wieksza niz caly limit (wtedy out) */
+int pageInsert(const string &url, PageCapture &cap){
+    PageCache &c = pageCache;
+    CachedPage p;
+    p.url = url;
+    p.text.swap(cap.text);
+    p.attrs.swap(cap.attrs);
+    p.stamp = cap.stamp;
+    p.links = cap.links;
+    size_t need = pageBytes(p);
+    if(need > c.budget){ cap.text.swap(p.text); cap.attrs.swap(p.attrs); c.uncached++; return -1; }
+    pageEvictTo(c.budget - need);
+    int i;
+    if(!c.freeSlots.empty()){ i = c.freeSlots.back(); c.freeSlots.pop_back(); }
+    else { i = (int)c.slots.size(); c.slots.push_back(CachedPage()); }
+    c.slots[i].url.swap(p.url);
+    c.slots[i].text.swap(p.text);
+    c.slots[i].attrs.swap(p.attrs);
+    c.slots[i].stamp.swap(p.stamp);
+    c.slots[i].links.swap(p.links);
+    c.slots[i].prefetched = false;
+    c.index[url] = i;
+    c.bytes += need;
+    pagePushFront(i);
+    return i;
+}
+
+/* render do bufora i do cache, bez ekranu */
+int pageRender(const string &url, PageCapture &cap){
+    long long t0 = nowMicros();
+    cap.stamp = pageStamp(url);         // przed odczytem: zmiana w trakcie da nowy render
+    streambuf *out = cout.rdbuf(&cap);
+    int keep = screen.getAttr();
+    browserRender(url, &cap.links);
+    setColor(keep);
+    cout.rdbuf(out);
+    pageCache.renderMicros += nowMicros() - t0;
+    return pageInsert(url, cap);
+}
+
+/* trafienie: tylko blit; chybienie: render do bufora, wstawienie, blit */
+void pageShow(const string &url){
+    PageCache &c = pageCache;
+    map<string,int>::iterator it = c.index.find(url);
+    int i;
+    PageCapture cap;
+    if(it!=c.index.end() && c.slots[it->second].stamp!=pageStamp(url)){
+        pageRemove(it->second);         // plik sie zmienil
+        it = c.index.end();
+    }
+    if(it!=c.index.end()){
+        i = it->second;
+        c.hits++;
+        if(c.slots[i].prefetched){
+            c.prefetchHits++;
+            c.prefetchBytes -= pageBytes(c.slots[i]);
+            c.slots[i].prefetched = false;
         }
-        cout<<" |\n";
-        msleep(60);
+        pageUnlink(i);
+        pagePushFront(i);
+    } else {
+        c.misses++;
+        i = pageRender(url, cap);
     }
-    asciiBorder("END PAINT",48,12);
-    cout<<"\n";
+    long long t0 = nowMicros();
+    if(i >= 0) screen.blit(c.slots[i].text, c.slots[i].attrs);
+    else screen.blit(cap.text, cap.attrs);
+    c.blitMicros += nowMicros() - t0;
+    pageShownUrl = url;
+    pageShownLinks = i >= 0 ? c.slots[i].links : cap.links;
+}
+
+size_t pageCacheBytes(){ return pageCache.bytes + pageCache.slots.capacity()*sizeof(CachedPage); }
+
+void showPageStats(){
+    const PageCache &c = pageCache;
+    long total = c.hits + c.misses;
+    char buf[128];
+    setColor(11);
+    cout<<"\n--- Page cache ---\n";
+    sprintf(buf," Pages cached     : %lu (%lu / %lu bytes)\n", (unsigned long)c.index.size(),
+            (unsigned long)c.bytes, (unsigned long)c.budget); cout<<buf;
+    sprintf(buf," Hits / misses    : %ld / %ld (%.1f%% hit)\n", c.hits, c.misses,
+            total ? 100.0 * c.hits / total : 0.0); cout<<buf;
+    sprintf(buf," Evicted / too big: %ld / %ld\n", c.evictions, c.uncached); cout<<buf;
+    sprintf(buf," Prefetched       : %ld (%ld used, %ld evicted unused, %ld cancelled)\n",
+            c.prefetched, c.prefetchHits, c.prefetchWasted, c.prefetchCancelled); cout<<buf;
+    sprintf(buf," Avg render       : %.3f ms per page\n", c.misses + c.prefetched ?
+            c.renderMicros / 1000.0 / (c.misses + c.prefetched) : 0.0); cout<<buf;
+    sprintf(buf," Avg blit         : %.3f ms per view\n\n", total ? c.blitMicros / 1000.0 / total : 0.0); cout<<buf;
+    setColor(7);
+}
+
+/* browser stats | browser budget BYTES */
+bool pageCacheCommand(const string &args){
+    char word[16]; long b = 0;
+    int n = sscanf(args.c_str(), "%15s %ld", word, &b);
+    if(n>=1 && toLowerStr(word)=="stats"){ showPageStats(); return true; }
+    if(n==2 && toLowerStr(word)=="budget" && b > 0){
+        pageCache.budget = (size_t)b;
+        pageEvictTo(pageCache.budget);
+        cout<<"Page cache budget set to "<<b<<" bytes\n\n";
+        return true;
+    }
+    return false;
 }
 
 /* ===============================
-   MUSIC PLAYER (FAKE)
+   PREFETCH
+   Prawdopodobne nastepne strony (wyniki wyszukiwania, inne karty,
+   back/forward aktywnej karty, zakladki) renderuja sie w tle do cache
+   stron. Pula PREFETCH_WORKERS zadan schedulera bierze zlecenia z jednej
+   kolejki; krok renderuje strony najwyzej przez PREFETCH_SLICE_US i oddaje
+   sterowanie, wiec prompt nie czeka. Zlecenie niesie token (epoke z chwili
+   planowania): nawigacja podbija epoke, a zlecenie ze stara epoka jest
+   porzucane zamiast renderowane. Nieogladane strony z prefetch zajmuja
+   najwyzej polowe limitu cache, zeby nie wypychaly ogladanych.
 =============================== */
-void musicPlayer(){
-    asciiBorder("MUSICPLAYER",48,13);
-    cout<<" Now playing: 'Synthetic Waves' [demo]\n\n";
-    for(int i=0;i<12;i++){
-        cout<<"   ";
-        for(int j=0;j<30;j++){
-            if(rand()%3==0) cout<<((j%2) ? '+' : '~'); else cout<<' ';
+const int PREFETCH_WORKERS = 2;
+const int PREFETCH_MAX = 12;                 // zlecen na jedna nawigacje
+const long long PREFETCH_SLICE_US = 2000;
+
+struct PrefetchJob { string url; unsigned token; };
+struct Prefetcher {
+    deque<PrefetchJob> queue;   // w kolejnosci priorytetu
+    unsigned epoch;             // biezacy token
+    int workers;                // zywe zadania puli
+    Prefetcher(): epoch(0), workers(0) {}
+};
+Prefetcher prefetcher;
+
+bool prefetchStep(Task &t){
+    Prefetcher &p = prefetcher;
+    if(t.frame >= t.frames) return false;    // kill
+    PageCache &c = pageCache;
+    long long t0 = nowMicros();
+    while(!p.queue.empty() && nowMicros() - t0 < PREFETCH_SLICE_US){
+        PrefetchJob j = p.queue.front();
+        p.queue.pop_front();
+        /* stara epoka albo brak miejsca: porzucone */
+        if(j.token != p.epoch || c.prefetchBytes >= c.budget / 2){ c.prefetchCancelled++; continue; }
+        if(c.index.count(j.url)) continue;   // w miedzyczasie obejrzana
+        PageCapture cap;
+        int i = pageRender(j.url, cap);
+        if(i >= 0){
+            c.slots[i].prefetched = true;
+            c.prefetchBytes += pageBytes(c.slots[i]);
+            c.prefetched++;
+        }
+        t.frame++;
+    }
+    t.frames = t.frame + (int)p.queue.size();
+    return !p.queue.empty();
+}
+
+void prefetchFinish(Task &){ prefetcher.workers--; }
+
+const TaskKind prefetchTask = { false, 0, prefetchStep, prefetchFinish };
+
+/* uniewaznia zlecenia w kolejce; zadania puli porzuca je przy nastepnym kroku */
+void prefetchCancel(){ prefetcher.epoch++; }
+
+/* nowy plan po nawigacji: first (np. wyniki wyszukiwania), potem reszta */
+void prefetchPlan(const vector<string> &first){
+    Prefetcher &p = prefetcher;
+    prefetchCancel();
+    vector<string> want(first);
+    for(size_t i=0;i<browserTabs.size();i++)
+        if((int)i != activeTabIndex) want.push_back(browserTabs[i].url);
+    if(activeTabIndex >= 0 && activeTabIndex < (int)browserTabs.size()){
+        const Tab &t = browserTabs[activeTabIndex];
+        if(!t.back.empty()) want.push_back(t.back.back());
+        if(!t.fwd.empty()) want.push_back(t.fwd.back());
+    }
+    for(size_t i=browserBookmarks.size();i-- > 0;) want.push_back(browserBookmarks[i]);
+    set<string> seen;
+    if(activeTabIndex >= 0 && activeTabIndex < (int)browserTabs.size()) seen.insert(browserTabs[activeTabIndex].url);
+    int n = 0;
+    for(size_t i=0;i<want.size() && n < PREFETCH_MAX;i++){
+        if(want[i].empty() || !seen.insert(want[i]).second || pageCache.index.count(want[i])) continue;
+        PrefetchJob j;
+        j.url = want[i];
+        j.token = p.epoch;
+        p.queue.push_back(j);
+        n++;
+    }
+    while(p.workers < min(PREFETCH_WORKERS, n)){
+        Task *t = createTask(&prefetchTask, "prefetch", 0, (int)p.queue.size());
+        t->quiet = true;
+        p.workers++;
+        launchTask(t, true);
+    }
+}
+
+/* ===============================
+   DOWNLOADS
+   Menedzer pobran: transfer to zadanie schedulera, ktore w kroku
+   przepisuje kawalki DL_CHUNK ze zrodla na koniec pliku w VFS (dopisanie
+   = jedna transakcja dziennika) przez najwyzej DL_SLICE_US i oddaje
+   sterowanie. Naraz biegnie DL_ACTIVE transferow, reszta czeka w kolejce.
+   Zrodla:
+     host:SCIEZKA   plik hosta (mapowany)
+     file://SCIEZKA plik w VFS
+     inne           serwer petli zwrotnej: deterministyczne bajty, rozmiar
+                    z ?size=N[K|M|G] albo z haszu adresu
+   Wznowienie zaczyna od dlugosci pliku docelowego, wiec pauza (albo kill
+   zadania) niczego nie traci. Lista transferow zyje w /var/lib/downloads.db;
+   po restarcie niedokonczone sa wstrzymane.
+=============================== */
+const int DL_ACTIVE = 3;
+const size_t DL_CHUNK = 64u << 10;
+const long long DL_SLICE_US = 4000;
+const char *DL_DB = "/var/lib/downloads.db";
+const char *DL_DIR = "/downloads";
+
+enum DlState { DL_QUEUED, DL_RUNNING, DL_PAUSED, DL_DONE, DL_FAILED, DL_STATES };
+const char *DL_STATE_NAMES[DL_STATES] = { "queued", "running", "paused", "done", "failed" };
+
+struct Transfer {
+    int id;
+    string url, dest;
+    int state;
+    unsigned long long total, done;
+    int pid;                        // zadanie, 0 = brak
+    long long startedAt;            // nowMicros() przy (wznowieniu)
+    unsigned long long runBytes;    // bajty od wznowienia
+    double rate;                    // B/s biezacego albo ostatniego przebiegu
+    string error;
+};
+vector<Transfer> transfers;
+int dlNextId = 1;
+bool dlLoaded = false;
+
+Transfer *dlFind(int id){
+    for(size_t i=0;i<transfers.size();i++) if(transfers[i].id==id) return &transfers[i];
+    return 0;
+}
+
+/* 64K, 10M, 1G; 0 gdy zle */
+unsigned long long dlParseSize(const string &s){
+    char *end;
+    double v = strtod(s.c_str(), &end);
+    unsigned long long m = 1;
+    if(*end=='k' || *end=='K') m = 1ULL << 10;
+    else if(*end=='m' || *end=='M') m = 1ULL << 20;
+    else if(*end=='g' || *end=='G') m = 1ULL << 30;
+    else if(*end) return 0;
+    return v > 0 ? (unsigned long long)(v * m) : 0;
+}
+
+string dlSize(double b){
+    char buf[32];
+    if(b >= 1 << 20) sprintf(buf, "%.1f MB", b / (1 << 20));
+    else if(b >= 1 << 10) sprintf(buf, "%.1f KB", b / (1 << 10));
+    else sprintf(buf, "%.0f B", b);
+    return buf;
+}
+
+/* rozmiar zrodla; false (err) gdy go nie ma */
+bool dlSourceSize(const string &url, unsigned long long &size, string &err){
+    if(url.compare(0, 5, "host:")==0){
+        MappedFile m;
+        if(!mapFile(url.substr(5), m)){ err = "cannot open " + url.substr(5); return false; }
+        size = m.size;
+        unmapFile(m);
+    } else if(url.compare(0, 7, "file://")==0){
+        unsigned ino = vfsWalk(url.substr(7));
+        if(!ino || vfsInode(ino).type!=VFS_FILE){ err = "no such file: " + url.substr(7); return false; }
+        size = vfsInode(ino).length;
+    } else {
+        size_t q = url.find("?size=");
+        if(q!=string::npos){
+            size = dlParseSize(url.substr(q + 6));
+            if(!size){ err = "bad size in " + url; return false; }
+        } else size = (64u << 10) + fnv1a(url.data(), url.size()) % (960u << 10);
+    }
+    if(size > VFS_MAX_FILE){ err = "larger than the file size limit"; return false; }
+    return true;
+}
+
+/* serwer petli zwrotnej: bajt zalezy tylko od adresu i pozycji
+   (slowo 64-bit na kazde 8 bajtow, mlodszy bajt pierwszy) */
+void dlLoopFill(const string &url, unsigned long long off, char *out, size_t n){
+    unsigned long long seed = hash64(url.data(), url.size());
+    for(size_t i=0;i<n;){
+        unsigned long long x = (seed ^ (off / 8 * 0x9E3779B97F4A7C15ULL)) | 1;
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        size_t in = off % 8, k = min(n - i, (size_t)8 - in);
+        for(size_t b=0;b<k;b++) out[i+b] = (char)(x >> (8 * (in + b)));
+        i += k; off += k;
+    }
+}
+
+/* nazwa w DL_DIR z ostatniego czlonu adresu; przy kolizji name-2.ext, name-3.ext... */
+string dlDestFor(const string &url){
+    string u = url.substr(0, url.find('?'));
+    while(!u.empty() && u[u.size()-1]=='/') u.erase(u.size()-1);
+    string base = u.substr(u.find_last_of("/:") + 1), name;
+    for(size_t i=0;i<base.size() && name.size() < VFS_NAME_MAX - 8;i++){
+        char c = base[i];
+        name += isalnum((unsigned char)c) || c=='.' || c=='-' || c=='_' ? c : '_';
+    }
+    if(name.empty() || name[0]=='.') name = "download" + name;
+    size_t dot = name.rfind('.');
+    string stem = dot==string::npos || dot==0 ? name : name.substr(0, dot);
+    string ext = dot==string::npos || dot==0 ? "" : name.substr(dot);
+    for(int n=1;;n++){
+        string path = string(DL_DIR) + "/" + name;
+        bool taken = vfsWalk(path)!=0;
+        for(size_t i=0;i<transfers.size() && !taken;i++) taken = transfers[i].dest==path;
+        if(!taken) return path;
+        char num[16]; sprintf(num, "-%d", n + 1);
+        name = stem + num + ext;
+    }
+}
+
+/* linia: ID STAN ROZMIAR DLUGOSC_CELU CEL ADRES; cel z dlugoscia, adres
+   do konca linii, bo oba moga zawierac spacje */
+bool dlSave(){
+    string text;
+    for(size_t i=0;i<transfers.size();i++){
+        const Transfer &t = transfers[i];
+        char head[96];
+        sprintf(head, "%d %s %llu %lu ", t.id, DL_STATE_NAMES[t.state], t.total, (unsigned long)t.dest.size());
+        text += head + t.dest + " " + t.url + "\n";
+    }
+    vfsMkdir("/var");
+    vfsMkdir("/var/lib");
+    return vfsWrite(DL_DB, text);
+}
+
+/* lista z bazy przy pierwszym uzyciu; niedokonczone czekaja na resume */
+void dlLoad(){
+    if(dlLoaded) return;
+    dlLoaded = true;
+    unsigned ino = vfsWalk(DL_DB);
+    if(!ino || vfsInode(ino).type!=VFS_FILE) return;
+    string buf;
+    const VfsInode &f = vfsInode(ino);
+    istringstream in(string(vfsView(f, buf), f.length));
+    Transfer t;
+    string state, line;
+    while(getline(in, line)){
+        istringstream ls(line);
+        unsigned long len;
+        if(!(ls>>t.id>>state>>t.total>>len) || ls.get()!=' ' || !len || len > line.size()) continue;
+        t.dest.resize(len);
+        if(!ls.read(&t.dest[0], len) || ls.get()!=' ' || !getline(ls, t.url) || t.url.empty()) continue;
+        t.state = DL_PAUSED;
+        for(int s=0;s<DL_STATES;s++) if(state==DL_STATE_NAMES[s]) t.state = s;
+        if(t.state==DL_QUEUED || t.state==DL_RUNNING) t.state = DL_PAUSED;
+        unsigned d = vfsWalk(t.dest);
+        t.done = d ? vfsInode(d).length : 0;
+        t.pid = 0; t.startedAt = 0; t.runBytes = 0; t.rate = 0;
+        transfers.push_back(t);
+        dlNextId = max(dlNextId, t.id + 1);
+    }
+}
+
+void dlFail(Transfer &t, const string &why){
+    t.state = DL_FAILED;
+    t.error = why;
+    logEvent(LOG_WARN, "Download failed: %s (%s)", t.url.c_str(), why.c_str());
+}
+
+/* kawalki ze zrodla do VFS az do konca limitu czasu kroku */
+bool dlStep(Task &task){
+    Transfer *tp = dlFind(task.vals[0]);
+    if(!tp || tp->state!=DL_RUNNING) return false;
+    Transfer &t = *tp;
+    if(task.frame >= task.frames){ t.state = DL_PAUSED; return false; }   // kill = pauza
+    bool fromHost = t.url.compare(0, 5, "host:")==0, fromVfs = t.url.compare(0, 7, "file://")==0;
+    unsigned src = fromVfs ? vfsWalk(t.url.substr(7)) : 0;
+    MappedFile host;
+    if(fromHost && !mapFile(t.url.substr(5), host)){ dlFail(t, "source vanished"); return false; }
+    vector<char> buf(DL_CHUNK);
+    long long t0 = nowMicros();
+    while(t.done < t.total && nowMicros() - t0 < DL_SLICE_US){
+        size_t n = (size_t)min((unsigned long long)DL_CHUNK, t.total - t.done);
+        const char *p = &buf[0];
+        if(fromHost){
+            if(t.done + n > host.size){ dlFail(t, "source shrank"); break; }
+            p = host.data + t.done;
+        } else if(fromVfs){
+            if(!src || vfsRead(vfsInode(src), (size_t)t.done, n, &buf[0]) != n){ dlFail(t, "source shrank"); break; }
+        } else dlLoopFill(t.url, t.done, &buf[0], n);
+        /* plik docelowy musi konczyc sie tam, gdzie skonczylismy (rollback, zapis) */
+        unsigned d = vfsWalk(t.dest);
+        if((d ? vfsInode(d).length : 0) != t.done){ dlFail(t, "destination changed"); break; }
+        if(!vfsStore(t.dest, p, n, true)){ dlFail(t, "write failed"); break; }
+        t.done += n;
+        t.runBytes += n;
+    }
+    unmapFile(host);
+    long long us = nowMicros() - t.startedAt;
+    if(us > 0) t.rate = t.runBytes * 1e6 / us;
+    task.frame = t.total ? (int)(t.done * 100 / t.total) : 100;
+    if(t.state!=DL_RUNNING) return false;
+    if(t.done >= t.total){ t.state = DL_DONE; return false; }
+    return true;
+}
+
+void dlPump();
+
+void dlFinish(Task &task){
+    Transfer *t = dlFind(task.vals[0]);
+    if(t){
+        t->pid = 0;
+        char head[48];
+        if(t->state==DL_DONE){
+            sprintf(head, "Download %d finished: ", t->id);
+            taskNotices.push_back(head + t->dest + " (" + dlSize((double)t->total) + ", " + dlSize(t->rate) + "/s)");
+            logEvent(LOG_INFO, "Download finished: %s -> %s", t->url.c_str(), t->dest.c_str());
+        } else if(t->state==DL_FAILED){
+            sprintf(head, "Download %d failed: ", t->id);
+            taskNotices.push_back(head + t->error);
         }
+    }
+    dlSave();
+    dlPump();
+}
+
+const TaskKind dlTask = { false, 0, dlStep, dlFinish };
+
+/* uruchamia czekajace, az DL_ACTIVE biegnie */
+void dlPump(){
+    int running = 0;
+    for(size_t i=0;i<transfers.size();i++) if(transfers[i].state==DL_RUNNING) running++;
+    for(size_t i=0;i<transfers.size() && running < DL_ACTIVE;i++){
+        Transfer &t = transfers[i];
+        if(t.state!=DL_QUEUED) continue;
+        unsigned d = vfsWalk(t.dest);
+        t.done = d ? vfsInode(d).length : 0;    // wznowienie od bajtu, na ktorym stanelismy
+        if(t.done > t.total){ dlFail(t, "destination larger than source"); continue; }
+        if(!d && !vfsWrite(t.dest, "")){ dlFail(t, "cannot create " + t.dest); continue; }
+        t.state = DL_RUNNING;
+        t.startedAt = nowMicros();
+        t.runBytes = 0;
+        Task *task = createTask(&dlTask, "download", 0, 100);
+        task->quiet = true;
+        task->vals.push_back(t.id);
+        t.pid = task->pid;
+        running++;
+        launchTask(task, true);
+    }
+}
+
+/* kolejkuje pobranie; dest puste = DL_DIR/nazwa z adresu */
+int dlAdd(const string &url, const string &dest){
+    dlLoad();
+    Transfer t;
+    string err;
+    if(!dlSourceSize(url, t.total, err)){ cout<<"Download failed: "<<err<<"\n\n"; return 0; }
+    vfsMkdir(DL_DIR);
+    t.dest = dest.empty() ? dlDestFor(url) : dest;
+    string base;
+    if(!vfsWalkParent(t.dest, base) || !vfsValidName(base)){ cout<<"Download failed: bad destination "<<t.dest<<"\n\n"; return 0; }
+    if(vfsWalk(t.dest)){ cout<<"Download failed: "<<t.dest<<" exists\n\n"; return 0; }
+    t.id = dlNextId++;
+    t.url = url;
+    t.state = DL_QUEUED;
+    t.done = 0; t.pid = 0; t.startedAt = 0; t.runBytes = 0; t.rate = 0;
+    transfers.push_back(t);
+    cout<<"Download "<<t.id<<" queued: "<<url<<" -> "<<t.dest<<" ("<<dlSize((double)t.total)<<")\n\n";
+    logEvent(LOG_INFO, "Download queued: %s -> %s", url.c_str(), t.dest.c_str());
+    dlSave();
+    dlPump();
+    return t.id;
+}
+
+void dlList(){
+    dlLoad();
+    if(transfers.empty()){ cout<<"No downloads\n\n"; return; }
+    char line[160];
+    double total = 0;
+    sprintf(line, " %-4s %-8s %6s %-21s %-11s %-8s %s\n", "ID", "STATE", "DONE", "BYTES", "RATE", "ETA", "DEST");
+    cout<<line;
+    for(size_t i=0;i<transfers.size();i++){
+        const Transfer &t = transfers[i];
+        string bytes = dlSize((double)t.done) + "/" + dlSize((double)t.total);
+        string rate = t.rate > 0 ? dlSize(t.rate) + "/s" : "-";
+        char eta[16] = "-";
+        if(t.state==DL_RUNNING && t.rate > 0) sprintf(eta, "%.1f s", (t.total - t.done) / t.rate);
+        if(t.state==DL_RUNNING) total += t.rate;
+        sprintf(line, " %-4d %-8s %5.1f%% %-21s %-11s %-8s ", t.id, DL_STATE_NAMES[t.state],
+                t.total ? 100.0 * t.done / t.total : 100.0, bytes.c_str(), rate.c_str(), eta);
+        cout<<line<<t.dest;
+        if(t.state==DL_FAILED) cout<<"  ("<<t.error<<")";
         cout<<"\n";
-        msleep(120);
     }
-    asciiBorder("END MUSIC",48,13);
-    cout<<"\n";
-    addLog("musicPlayer: played Synthetic Waves");
+    cout<<"("<<transfers.size()<<" transfer(s), "<<dlSize(total)<<"/s now)\n\n";
+}
+
+/* pause/resume ID|all */
+void dlSetPaused(const string &which, bool pause){
+    int changed = 0, id = atoi(which.c_str());
+    for(size_t i=0;i<transfers.size();i++){
+        Transfer &t = transfers[i];
+        if(which!="all" && t.id!=id) continue;
+        if(pause && (t.state==DL_RUNNING || t.state==DL_QUEUED)){
+            if(t.state==DL_RUNNING) if(Task *task = findTask(t.pid)) task->wakeAt = clockNow();
+            t.state = DL_PAUSED;
+            changed++;
+        } else if(!pause && (t.state==DL_PAUSED || t.state==DL_FAILED) && !t.pid){
+            t.state = DL_QUEUED;
+            t.error.clear();
+            changed++;
+        }
+    }
+    if(!changed){ cout<<"Nothing to "<<(pause ? "pause" : "resume")<<"\n\n"; return; }
+    cout<<(pause ? "Paused " : "Resumed ")<<changed<<" download(s)\n\n";
+    /* wstrzymane zadania koncza sie przy najblizszym kroku */
+    if(pause) runDueTasks();
+    dlSave();
+    dlPump();
+}
+
+/* downloads [add URL [DEST] | pause ID|all | resume ID|all | cancel ID | clear] */
+void downloadsCommand(const string &args){
+    dlLoad();
+    istringstream in(args);
+    string op, a, b;
+    in>>op>>a>>b;
+    op = toLowerStr(op);
+    if(op.empty() || op=="list") dlList();
+    else if(op=="add" && !a.empty()) dlAdd(a, b);
+    else if((op=="pause" || op=="resume") && !a.empty()) dlSetPaused(a, op=="pause");
+    else if(op=="cancel" && !a.empty()){
+        Transfer *t = dlFind(atoi(a.c_str()));
+        if(!t){ cout<<"No such download: "<<a<<"\n\n"; return; }
+        int id = t->id, pid = t->pid;
+        transfers.erase(transfers.begin() + (t - &transfers[0]));
+        /* zadanie bez transferu konczy sie przy najblizszym kroku */
+        if(Task *task = pid ? findTask(pid) : 0){ task->wakeAt = clockNow(); runDueTasks(); }
+        cout<<"Cancelled download "<<id<<" (partial file kept)\n\n";
+        dlSave();
+        dlPump();
+    } else if(op=="clear"){
+        size_t before = transfers.size();
+        for(size_t i=transfers.size();i-- > 0;)
+            if(transfers[i].state==DL_DONE || transfers[i].state==DL_FAILED) transfers.erase(transfers.begin()+i);
+        cout<<"Cleared "<<before - transfers.size()<<" finished download(s)\n\n";
+        dlSave();
+    } else cout<<"Usage: downloads [add URL [DEST] | pause ID|all | resume ID|all | cancel ID | clear]\n\n";
 }
 
 /* ===============================
-   INSTALLER (expanded) - C++98-compatible
+   HTML
+   Tokenizer strumieniowy: token to wskazniki do zrodla (nazwa, surowe
+   atrybuty, tekst), bez kopii i bez alokacji na token. Komentarze,
+   doctype i tresc <script>/<style> sa pomijane. Layout pisze na cout
+   w siatce HTML_WIDTH kolumn: slowa sa zawijane, bloki (p, div, li,
+   h1-h6, pre, tr...) zaczynaja nowa linie, naglowki, linki i wyroznienia
+   maja wlasne kolory, linki dostaja numer [n] i lista adresow idzie pod
+   strone (follow N otwiera n-ty). Strony wbudowane to tez HTML, file://
+   czyta dokument z VFS.
 =============================== */
-void installer(){
-    asciiBorder("VIREON INSTALLER",60,11);
-    smallLogo("installer");
-    addLog("Installer launched");
-    installedPrograms.clear();
-    installedEnvironments.clear();
-
-    vector<string> programs;
-    programs.push_back("TextEditor");
-    programs.push_back("WebBrowser");
-    programs.push_back("MusicPlayer");
-    programs.push_back("Calculator");
-    programs.push_back("Paint");
-    programs.push_back("Notes");
-    programs.push_back("SystemMonitor");
-    programs.push_back("MiniGames");
-    programs.push_back("DevKit");
-
-    vector<string> envs;
-    envs.push_back("GUI_Basic");
-    envs.push_back("GUI_Advanced");
-    envs.push_back("Desktop_3D");
-    envs.push_back("RetroConsole");
-
-    cout<<"Available Programs:\n";
-    for(size_t i=0;i<programs.size();i++){
-        printf(" %2d) %s\n", (int)i+1, programs[i].c_str());
+const int HTML_WIDTH = 64;
+
+enum HtmlTokenType { HTML_TEXT, HTML_OPEN, HTML_CLOSE };
+struct HtmlToken {
+    int type;
+    const char *name; size_t nameLen;     // znacznik jak w zrodle
+    const char *attrs; size_t attrsLen;   // surowe atrybuty
+    const char *text; size_t textLen;     // HTML_TEXT, encje nierozwiniete
+    bool selfClose;
+};
+
+inline bool htmlSpace(char c){ return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\f'; }
+
+bool htmlNameChar(char c){ return isalnum((unsigned char)c) || c=='-' || c==':' || c=='_'; }
+
+bool htmlNameIs(const char *s, size_t n, const char *lower){
+    size_t i = 0;
+    for(; i<n && lower[i]; i++) if(tolower((unsigned char)s[i]) != lower[i]) return false;
+    return i==n && !lower[i];
+}
+
+/* pierwsze "</name" od p (bez wielkosci liter), end gdy brak */
+const char *htmlFindClose(const char *p, const char *end, const char *name, size_t n){
+    for(; p + 2 + n <= end; p++){
+        p = (const char*)memchr(p, '<', end - p);
+        if(!p || p + 2 + n > end) break;
+        if(p[1]=='/' && htmlNameIs(p + 2, n, name) && (p + 2 + n==end || !htmlNameChar(p[2+n]))) return p;
     }
-    cout<<"  0) finish selection\n";
-    int choice;
-    while(true){
-        cout<<"Select program number to install (0 to finish): ";
-        cin>>choice;
-        if(choice==0) break;
-        if(choice>=1 && choice <= (int)programs.size()){
-            string p = programs[choice-1];
-            bool already = false;
-            for(size_t k=0;k<installedPrograms.size();k++){
-                if(installedPrograms[k] == p){ already = true; break; }
+    return end;
+}
+
+const char *htmlFind(const char *p, const char *end, const char *what){
+    size_t n = strlen(what);
+    for(; p + n <= end; p++){
+        p = (const char*)memchr(p, what[0], end - p);
+        if(!p || p + n > end) break;
+        if(memcmp(p, what, n)==0) return p;
+    }
+    return end;
+}
+
+struct HtmlTokenizer {
+    const char *p, *end;
+    HtmlTokenizer(const char *s, size_t n): p(s), end(s + n) {}
+
+    bool next(HtmlToken &t){
+        while(p < end){
+            if(*p != '<' || p + 1 >= end || !(isalpha((unsigned char)p[1]) || p[1]=='/' || p[1]=='!' || p[1]=='?')){
+                /* tekst do nastepnego '<' (samotny '<' zostaje tekstem) */
+                const char *s = p;
+                const char *q = (const char*)memchr(p + 1, '<', end - p - 1);
+                p = q ? q : end;
+                t.type = HTML_TEXT; t.text = s; t.textLen = p - s;
+                return true;
+            }
+            if(p + 4 <= end && memcmp(p, "<!--", 4)==0){
+                const char *q = htmlFind(p + 4, end, "-->");
+                p = q==end ? end : q + 3;
+                continue;
             }
-            if(!already){
-                loadingBar("Installing "+p, 28, 10);
-                installedPrograms.push_back(p);
-                addLog("Installed program: "+p);
-                cout<<p<<" installed.\n\n";
+            if(p[1]=='!' || p[1]=='?'){
+                const char *q = (const char*)memchr(p, '>', end - p);
+                p = q ? q + 1 : end;
+                continue;
+            }
+            bool close = p[1]=='/';
+            const char *s = p + (close ? 2 : 1), *n = s;
+            while(n < end && htmlNameChar(*n)) n++;
+            /* atrybuty do '>' poza cudzyslowami */
+            const char *a = n;
+            char quote = 0;
+            for(; a < end; a++){
+                if(quote){ if(*a==quote) quote = 0; }
+                else if(*a=='"' || *a=='\'') quote = *a;
+                else if(*a=='>') break;
+            }
+            t.type = close ? HTML_CLOSE : HTML_OPEN;
+            t.name = s; t.nameLen = n - s;
+            t.attrs = n; t.attrsLen = a - n;
+            t.selfClose = a > n && a[-1]=='/';
+            p = a < end ? a + 1 : end;
+            if(!close && (htmlNameIs(s, n - s, "script") || htmlNameIs(s, n - s, "style")))
+                p = htmlFindClose(p, end, htmlNameIs(s, n - s, "script") ? "script" : "style", n - s);
+            return true;
+        }
+        return false;
+    }
+};
+
+/* wartosc atrybutu (surowa, bez cudzyslowow); false gdy go nie ma */
+bool htmlAttr(const HtmlToken &t, const char *name, const char *&val, size_t &len){
+    const char *p = t.attrs, *end = t.attrs + t.attrsLen;
+    while(p < end){
+        while(p < end && !htmlNameChar(*p)) p++;
+        const char *n = p;
+        while(p < end && htmlNameChar(*p)) p++;
+        size_t nl = p - n;
+        while(p < end && isspace((unsigned char)*p)) p++;
+        const char *v = p;
+        size_t vl = 0;
+        if(p < end && *p=='='){
+            p++;
+            while(p < end && isspace((unsigned char)*p)) p++;
+            if(p < end && (*p=='"' || *p=='\'')){
+                char q = *p++;
+                v = p;
+                while(p < end && *p != q) p++;
+                vl = p - v;
+                if(p < end) p++;
             } else {
-                cout<<p<<" already installed.\n";
+                v = p;
+                while(p < end && !isspace((unsigned char)*p) && *p!='>') p++;
+                vl = p - v;
             }
-        } else {
-            cout<<"Invalid selection\n";
+        }
+        if(nl && htmlNameIs(n, nl, name)){ val = v; len = vl; return true; }
+    }
+    return false;
+}
+
+enum HtmlTag {
+    TAG_OTHER, TAG_P, TAG_DIV, TAG_BR, TAG_HR, TAG_H1, TAG_H2, TAG_H3, TAG_H4, TAG_H5, TAG_H6,
+    TAG_UL, TAG_OL, TAG_LI, TAG_A, TAG_PRE, TAG_B, TAG_EM, TAG_CODE, TAG_TITLE, TAG_HEAD,
+    TAG_TABLE, TAG_TR, TAG_TD, TAG_TH, TAG_BLOCKQUOTE, TAG_IMG, TAG_BODY, TAG_BLOCK
+};
+struct HtmlTagName { const char *name; int tag; };
+const HtmlTagName HTML_TAGS[] = {
+    {"p",TAG_P}, {"a",TAG_A}, {"li",TAG_LI}, {"br",TAG_BR}, {"div",TAG_DIV}, {"b",TAG_B},
+    {"strong",TAG_B}, {"i",TAG_EM}, {"em",TAG_EM}, {"code",TAG_CODE}, {"tt",TAG_CODE},
+    {"h1",TAG_H1}, {"h2",TAG_H2}, {"h3",TAG_H3}, {"h4",TAG_H4}, {"h5",TAG_H5}, {"h6",TAG_H6},
+    {"ul",TAG_UL}, {"ol",TAG_OL}, {"td",TAG_TD}, {"th",TAG_TH}, {"tr",TAG_TR}, {"table",TAG_TABLE},
+    {"pre",TAG_PRE}, {"hr",TAG_HR}, {"img",TAG_IMG}, {"title",TAG_TITLE}, {"head",TAG_HEAD},
+    {"blockquote",TAG_BLOCKQUOTE}, {"section",TAG_BLOCK}, {"article",TAG_BLOCK}, {"header",TAG_BLOCK},
+    {"footer",TAG_BLOCK}, {"nav",TAG_BLOCK}, {"main",TAG_BLOCK}, {"dl",TAG_BLOCK}, {"dt",TAG_BLOCK},
+    {"dd",TAG_BLOCK}, {"body",TAG_BODY}, {"html",TAG_BLOCK}
+};
+
+int htmlTag(const char *s, size_t n){
+    if(n==0 || n > 10) return TAG_OTHER;
+    for(size_t i=0;i<sizeof HTML_TAGS / sizeof HTML_TAGS[0];i++)
+        if(HTML_TAGS[i].name[0]==tolower((unsigned char)s[0]) && htmlNameIs(s, n, HTML_TAGS[i].name)) return HTML_TAGS[i].tag;
+    return TAG_OTHER;
+}
+
+/* &amp; &#65; &#x41; ...: dopisuje rozwiniecie, zwraca zjedzone bajty (0 = to nie encja) */
+size_t htmlEntity(const char *p, const char *end, string &out){
+    const char *semi = (const char*)memchr(p, ';', min((size_t)(end - p), (size_t)10));
+    if(!semi) return 0;
+    const char *n = p + 1;
+    size_t len = semi - n;
+    if(len > 1 && n[0]=='#'){
+        unsigned long c = n[1]=='x' || n[1]=='X' ? strtoul(string(n + 2, len - 2).c_str(), 0, 16)
+                                                 : strtoul(string(n + 1, len - 1).c_str(), 0, 10);
+        out += c==160 ? ' ' : c >= 32 && c < 127 ? (char)c : '?';
+        return semi - p + 1;
+    }
+    static const char *const names[][2] = {
+        {"amp","&"}, {"lt","<"}, {"gt",">"}, {"quot","\""}, {"apos","'"}, {"nbsp"," "},
+        {"copy","(c)"}, {"reg","(R)"}, {"mdash","--"}, {"ndash","-"}, {"hellip","..."},
+        {"laquo","<<"}, {"raquo",">>"}, {"middot","*"}, {"bull","*"}, {"trade","(TM)"}
+    };
+    for(size_t i=0;i<sizeof names / sizeof names[0];i++)
+        if(htmlNameIs(n, len, names[i][0])){ out += names[i][1]; return semi - p + 1; }
+    return 0;
+}
+
+/* uklad strony: slowa z kolorem na znak, zawijane do szerokosci */
+struct HtmlLayout {
+    ostream &out;
+    int width;
+    string line, lineAttr;      // biezaca linia
+    string tail, tailAttr;      // przenoszony koniec linii (bufor wielokrotnego uzytku)
+    size_t wordAt;              // poczatek slowa w budowie w line, npos = brak
+    bool wordAfterText;         // przed slowem cos juz bylo (slowo moze zejsc nizej)
+    bool space;                 // odstep przed nastepnym slowem
+    bool filled;                // w linii jest cos poza wcieciem
+    bool blank;                 // ostatnia wypisana linia byla pusta
+    int margin;                 // wciecie nowych linii
+    int indent;                 // poziom zagniezdzenia list i cytatow
+    vector< pair<int,int> > colors;   // stos (znacznik, kolor), back() = biezacy
+    vector<int> lists;          // -1 = ul, inaczej licznik ol
+    int pre, heading;           // glebokosc <pre>, poziom naglowka
+    bool preLead;               // pierwszy \n po <pre> sie pomija
+    bool inHead, inTitle;
+    string title;
+    vector<string> links;
+
+    HtmlLayout(ostream &o, int w): out(o), width(w), wordAt(string::npos), wordAfterText(false), space(false), filled(false), blank(true), margin(0),
+        indent(0), pre(0), heading(0), preLead(false), inHead(false), inTitle(false) { colors.push_back(make_pair(TAG_OTHER, 7)); }
+
+    int color() const { return colors.back().second; }
+    void push(int tag, int c){ colors.push_back(make_pair(tag, c)); }
+    /* zamkniecie zdejmuje najblizszy wpis tego znacznika; bez pary nic nie robi */
+    bool pop(int tag){
+        for(size_t i=colors.size();i-- > 1;)
+            if(colors[i].first==tag){ colors.erase(colors.begin()+i); return true; }
+        return false;
+    }
+    /* wciecie rosnie o 4 na poziom, ale najwyzej do polowy szerokosci */
+    void setIndent(int level){
+        indent = level;
+        margin = min(indent * 4, width / 2);
+        line.assign(margin, ' ');
+        lineAttr.assign(margin, 7);
+    }
+
+    void flushLine(){
+        size_t i = 0;
+        while(i < line.size()){
+            size_t j = i;
+            while(j < line.size() && lineAttr[j]==lineAttr[i]) j++;
+            setColor((unsigned char)lineAttr[i]);
+            out.write(line.data() + i, j - i);
+            i = j;
+        }
+        setColor(7);
+        out<<'\n';
+        blank = !filled;
+        line.assign(margin, ' ');
+        lineAttr.assign(margin, 7);
+        space = filled = false;
+    }
+    bool lineEmpty() const { return !filled; }
+
+    /* slowo powstaje od razu w line; dopiero na koncu sprawdzamy, czy sie zmiescilo */
+    void beginWord(){
+        if(wordAt!=string::npos) return;
+        if(filled && space){ line += ' '; lineAttr += (char)7; }
+        space = false;
+        wordAfterText = filled;
+        wordAt = line.size();
+        filled = true;
+    }
+    void carry(size_t at){
+        tail.assign(line, at, string::npos);
+        tailAttr.assign(lineAttr, at, string::npos);
+        line.resize(at); lineAttr.resize(at);
+        flushLine();
+        line += tail; lineAttr += tailAttr;
+        filled = true;
+    }
+    void putWord(){
+        if(wordAt==string::npos) return;
+        if(wordAfterText && line.size() > (size_t)width){
+            size_t at = wordAt;
+            if(at > 0 && line[at-1]==' ') { line.erase(at-1, 1); lineAttr.erase(at-1, 1); at--; }
+            carry(at);
+        }
+        /* slowo dluzsze niz linia: tniemy */
+        size_t cut = (size_t)max(width, margin + 8);
+        while(line.size() > cut) carry(cut);
+        wordAt = string::npos;
+    }
+    void addChar(char c){ beginWord(); line += c; lineAttr += (char)color(); }
+    void addText(const char *s, size_t n, int c){ beginWord(); line.append(s, n); lineAttr.append(n, (char)c); }
+    bool addEntity(const char *p, const char *end, size_t &k){
+        beginWord();
+        k = htmlEntity(p, end, line);
+        lineAttr.resize(line.size(), (char)color());
+        return k > 0;
+    }
+
+    void breakLine(){ putWord(); if(!lineEmpty()) flushLine(); }
+    void blankLine(){ breakLine(); if(!blank){ out<<'\n'; blank = true; } }
+
+    void text(const char *s, size_t n){
+        if(inTitle){ title.append(s, n); return; }
+        if(inHead) return;
+        const char *end = s + n;
+        for(const char *p = s; p < end; p++){
+            char c = *p;
+            if(!pre && heading!=1 && c!='&' && !htmlSpace(c)){
+                /* cale slowo naraz */
+                const char *q = p + 1;
+                while(q < end && *q!='&' && !htmlSpace(*q)) q++;
+                addText(p, q - p, color());
+                p = q - 1;
+                continue;
+            }
+            if(pre){
+                if(preLead){ preLead = false; if(c=='\n') continue; }
+                if(c=='\n'){ putWord(); flushLine(); }
+                else if(c=='\t'){ do addChar(' '); while(line.size() % 4); }
+                else if(c=='&'){ size_t k; if(addEntity(p, end, k)) p += k - 1; else addChar(c); }
+                else if(c!='\r'){ addChar(c); if(line.size() >= (size_t)width){ putWord(); flushLine(); } }
+                continue;
+            }
+            if(htmlSpace(c)){ putWord(); if(filled) space = true; continue; }
+            if(c=='&'){
+                size_t k;
+                if(addEntity(p, end, k)){ p += k - 1; continue; }
+            }
+            if(heading==1) c = (char)toupper((unsigned char)c);
+            addChar(c);
+        }
+    }
+
+    void open(const HtmlToken &t){
+        int tag = htmlTag(t.name, t.nameLen);
+        switch(tag){
+        case TAG_HEAD: inHead = true; break;
+        case TAG_BODY: inHead = false; breakLine(); break;
+        case TAG_TITLE: inTitle = true; title.clear(); break;
+        case TAG_P: case TAG_TABLE: blankLine(); break;
+        case TAG_DIV: case TAG_BLOCK: case TAG_TR: breakLine(); break;
+        case TAG_BR: putWord(); flushLine(); break;
+        case TAG_HR: {
+            breakLine();
+            size_t n = (size_t)max(0, width - margin);
+            line.append(n, '-'); lineAttr.append(n, 8);
+            filled = true;
+            flushLine();
+            break;
+        }
+        case TAG_H1: case TAG_H2: case TAG_H3: case TAG_H4: case TAG_H5: case TAG_H6:
+            blankLine();
+            heading = tag - TAG_H1 + 1;
+            push(tag, heading==1 ? 14 : heading==2 ? 11 : 10);
+            break;
+        case TAG_UL: case TAG_OL: breakLine(); lists.push_back(tag==TAG_UL ? -1 : 0); setIndent(indent + 1); break;
+        case TAG_LI: {
+            breakLine();
+            char bullet[16] = "  * ";
+            if(!lists.empty() && lists.back() >= 0) sprintf(bullet, "%2d. ", ++lists.back() % 100);
+            size_t at = line.size() >= 4 ? line.size() - 4 : 0;
+            for(size_t i=0;i<4 && at + i < line.size();i++){ line[at+i] = bullet[i]; lineAttr[at+i] = 8; }
+            space = false;
+            filled = true;
+            break;
+        }
+        case TAG_BLOCKQUOTE: blankLine(); setIndent(indent + 1); push(tag, 8); break;
+        case TAG_PRE: blankLine(); pre++; preLead = true; break;
+        case TAG_A: {
+            const char *v; size_t n;
+            if(!t.selfClose && htmlAttr(t, "href", v, n)){
+                links.push_back(string(v, n));
+                push(tag, 11);
+            }
+            break;
+        }
+        case TAG_B: push(tag, 15); break;
+        case TAG_EM: push(tag, 13); break;
+        case TAG_CODE: push(tag, 10); break;
+        case TAG_TD: case TAG_TH:
+            putWord();
+            if(!lineEmpty()){ space = false; line += " | "; lineAttr += string(3, 8); }
+            if(tag==TAG_TH) push(tag, 15);
+            break;
+        case TAG_IMG: {
+            const char *v; size_t n;
+            if(htmlAttr(t, "alt", v, n) && n){ addText("[img: ", 6, 8); addText(v, n, 8); addText("]", 1, 8); }
+            break;
+        }
         }
     }
 
-    cout<<"\nAvailable Environments:\n";
-    for(size_t i=0;i<envs.size();i++){
-        printf(" %2d) %s\n", (int)i+1, envs[i].c_str());
-    }
-    cout<<"  0) finish selection\n";
-    while(true){
-        cout<<"Select environment number to install (0 to finish): ";
-        cin>>choice;
-        if(choice==0) break;
-        if(choice>=1 && choice <= (int)envs.size()){
-            string e = envs[choice-1];
-            bool already = false;
-            for(size_t k=0;k<installedEnvironments.size();k++){
-                if(installedEnvironments[k] == e){ already = true; break; }
+    void close(const HtmlToken &t){
+        int tag = htmlTag(t.name, t.nameLen);
+        switch(tag){
+        case TAG_HEAD: inHead = false; break;
+        case TAG_TITLE: {
+            if(!inTitle) break;
+            inTitle = false;
+            /* tytul jako pierwsza linia strony */
+            bool saveHead = inHead;
+            inHead = false;
+            push(tag, 15);
+            text(title.data(), title.size());
+            pop(tag);
+            blankLine();
+            inHead = saveHead;
+            break;
+        }
+        case TAG_P: case TAG_TABLE: blankLine(); break;
+        case TAG_DIV: case TAG_BLOCK: case TAG_TR: case TAG_LI: breakLine(); break;
+        case TAG_H1: case TAG_H2: case TAG_H3: case TAG_H4: case TAG_H5: case TAG_H6:
+            if(!heading) break;
+            putWord();
+            if(heading <= 2 && !lineEmpty()){
+                size_t n = line.size() - min(line.size(), (size_t)margin);
+                flushLine();
+                line.append(n, heading==1 ? '=' : '-');
+                lineAttr.append(n, (char)color());
+                filled = true;
             }
-            if(!already){
-                loadingBar("Installing env "+e, 24, 9);
-                installedEnvironments.push_back(e);
-                addLog("Installed environment: "+e);
-                cout<<e<<" installed.\n\n";
-            } else {
-                cout<<e<<" already installed.\n";
+            pop(tag);
+            heading = 0;
+            blankLine();
+            break;
+        case TAG_UL: case TAG_OL:
+            if(lists.empty()) break;
+            breakLine();
+            lists.pop_back();
+            setIndent(indent - 1);
+            if(lists.empty()) blankLine();
+            break;
+        case TAG_BLOCKQUOTE:
+            if(!pop(tag)) break;
+            blankLine();
+            setIndent(indent - 1);
+            break;
+        case TAG_PRE: if(pre){ putWord(); if(!lineEmpty()) flushLine(); pre--; blankLine(); } break;
+        case TAG_A:
+            if(pop(tag)){
+                char num[16]; sprintf(num, "[%d]", (int)links.size());
+                addText(num, strlen(num), 8);
             }
-        } else {
-            cout<<"Invalid selection\n";
+            break;
+        case TAG_B: case TAG_EM: case TAG_CODE: case TAG_TH: pop(tag); break;
         }
     }
 
-    cout<<"Auto-configure startup services? (y/n): ";
-    char yn; cin>>yn;
-    if(tolower(yn)=='y'){
-        loadingBar("Configuring services", 20, 14);
-        addLog("Services configured");
-        cout<<"Services configured.\n\n";
+    void finish(){
+        breakLine();
+        if(!links.empty()){
+            blankLine();
+            setColor(8);
+            out<<"Links:\n";
+            for(size_t i=0;i<links.size();i++) out<<" ["<<i+1<<"] "<<links[i]<<"\n";
+            setColor(7);
+        }
     }
+};
 
-    cout<<"Installation finished. Installed items:\n";
-    for(size_t i=0;i<installedPrograms.size();i++) cout<<" - "<<installedPrograms[i]<<"\n";
-    for(size_t i=0;i<installedEnvironments.size();i++) cout<<" - "<<installedEnvironments[i]<<"\n";
-    cout<<"\n";
-    addLog("Installer finished");
+/* parsowanie i uklad dokumentu na out */
+void htmlRender(const char *src, size_t n, ostream &out, int width){
+    HtmlLayout lay(out, width);
+    HtmlTokenizer tok(src, n);
+    HtmlToken t;
+    while(tok.next(t)){
+        if(t.type==HTML_TEXT) lay.text(t.text, t.textLen);
+        else if(t.type==HTML_OPEN){ lay.open(t); if(t.selfClose) lay.close(t); }
+        else lay.close(t);
+    }
+    lay.finish();
 }
 
-/* ===============================
-   ENVIRONMENT CHANGE
-=============================== */
-void changeEnvironment(){
-    cout<<"Available Environments:\n";
-    for(size_t i=0;i<installedEnvironments.size();i++){
-        cout<<" "<<i+1<<") "<<installedEnvironments[i]<<"\n";
-    }
-    cout<<"Select number: ";
-    int c; cin>>c;
-    if(c>=1 && c <= (int)installedEnvironments.size()){
-        currentEnvironment = installedEnvironments[c-1];
-        addLog("Environment changed to "+currentEnvironment);
-        cout<<"Environment set to "<<currentEnvironment<<"\n\n";
-    } else {
-        cout<<"Invalid choice or no environments installed.\n\n";
-    }
+/* adresy linkow w kolejnosci numerow [n] */
+void htmlLinks(const char *src, size_t n, vector<string> &out){
+    HtmlTokenizer tok(src, n);
+    HtmlToken t;
+    const char *v; size_t len;
+    while(tok.next(t))
+        if(t.type==HTML_OPEN && !t.selfClose && htmlNameIs(t.name, t.nameLen, "a") && htmlAttr(t, "href", v, len))
+            out.push_back(string(v, len));
 }
 
-/* ===============================
-   WSM / COMMANDS TABLE (visually improved)
-=============================== */
-void drawCommandsTable(){
-    asciiBorder("COMMANDS REFERENCE",72,14);
-    setColor(14);
+/* strony wbudowane: pierwszy pasujacy fragment adresu wygrywa */
+struct SitePage { const char *match, *html; };
+const SitePage SITE_PAGES[] = {
+    { "vireonos.com",
+      "<html><head><title>VireonOS</title></head><body>\n"
+      "<pre> /\\/\\ VIREON  /\\/\\</pre>\n"
+      "<h1>VireonOS</h1>\n<p>Welcome to VireonOS official ASCII page!</p>\n"
+      "<ul>\n<li>Projects: <a href=\"github.com/fireon/vireonos\">VireonOS</a>, VireonTools, VireonArt</li>\n"
+      "<li>Follow the fake dev announcements.</li>\n</ul>\n</body></html>\n" },
+    { "github.com",
+      "<html><head><title>GitHub</title></head><body>\n<h2>GitHub - Fake Repositories</h2>\n<ul>\n"
+      "<li><a href=\"github.com/fireon/vireonos\">fireon/vireonos</a></li>\n"
+      "<li><a href=\"github.com/guest/demo\">guest/demo</a></li>\n"
+      "<li><a href=\"github.com/tools/ascii-suite\">tools/ascii-suite</a></li>\n</ul>\n</body></html>\n" },
+    { "youtube",
+      "<html><head><title>YouTube Beta</title></head><body>\n<h2>YouTube Beta - Video Player (ASCII)</h2>\n"
+      "<p>Type <code>play</code> to play sample, or <code>download</code> to fake-download.</p>\n</body></html>\n" },
+    { "video",
+      "<html><head><title>YouTube Beta</title></head><body>\n<h2>YouTube Beta - Video Player (ASCII)</h2>\n"
+      "<p>Type <code>play</code> to play sample, or <code>download</code> to fake-download.</p>\n</body></html>\n" },
+    { "example.com",
+      "<html><head><title>Example Page</title></head><body>\n<h2>Example Page</h2>\n"
+      "<p>Lorem ipsum dolor sit amet, ascii content demo.</p>\n</body></html>\n" },
+    { "search.fake",
+      "<html><head><title>Search</title></head><body>\n<p>Search engine placeholder page.</p>\n</body></html>\n" }
+};
 
-    vector< pair<string, vector< pair<string,string> > > > table;
-
-    vector< pair<string,string> > sys;
-    sys.push_back(make_pair(string("help"), string("Show help")));
-    sys.push_back(make_pair(string("ver"), string("Version info")));
-    sys.push_back(make_pair(string("whoami"), string("Current user")));
-    sys.push_back(make_pair(string("uptime"), string("System uptime")));
-    sys.push_back(make_pair(string("neofetch"), string("Full info")));
-    table.push_back(make_pair(string("System"), sys));
-
-    vector< pair<string,string> > files;
-    files.push_back(make_pair(string("ls"), string("List files")));
-    files.push_back(make_pair(string("cat FILE"), string("Show file")));
-    files.push_back(make_pair(string("touch FILE"), string("Create file")));
-    files.push_back(make_pair(string("write FILE"), string("Write to file")));
-    table.push_back(make_pair(string("Files"), files));
-
-    vector< pair<string,string> > procs;
-    procs.push_back(make_pair(string("ps"), string("Process list (htop)")));
-    procs.push_back(make_pair(string("htop"), string("Detailed htop view")));
-    table.push_back(make_pair(string("Processes"), procs));
-
-    vector< pair<string,string> > apps;
-    apps.push_back(make_pair(string("browser"), string("Open browser")));
-    apps.push_back(make_pair(string("youtube"), string("YouTube ascii")));
-    apps.push_back(make_pair(string("paint"), string("Paint")));
-    apps.push_back(make_pair(string("musicplayer"), string("Music player")));
-    apps.push_back(make_pair(string("notes"), string("Notes")));
-    apps.push_back(make_pair(string("calculator"), string("Calculator")));
-    table.push_back(make_pair(string("Apps"), apps));
-
-    vector< pair<string,string> > maint;
-    maint.push_back(make_pair(string("installer"), string("Run installer")));
-    maint.push_back(make_pair(string("envchange"), string("Change environment")));
-    maint.push_back(make_pair(string("logs"), string("Show logs")));
-    maint.push_back(make_pair(string("cls"), string("Clear screen")));
-    maint.push_back(make_pair(string("exit"), string("Shutdown")));
-    table.push_back(make_pair(string("Maintenance"), maint));
-
-    for(size_t i=0;i<table.size();i++){
-        string cat = table[i].first;
-        cout<<"["<<cat<<"]\n";
-        for(size_t j=0;j<table[i].second.size();j++){
-            string cmd = table[i].second[j].first;
-            string desc = table[i].second[j].second;
-            printf("  %-16s - %s\n", cmd.c_str(), desc.c_str());
+string htmlEscape(const string &s){
+    string r;
+    for(size_t i=0;i<s.size();i++){
+        if(s[i]=='<') r += "&lt;";
+        else if(s[i]=='>') r += "&gt;";
+        else if(s[i]=='&') r += "&amp;";
+        else r += s[i];
+    }
+    return r;
+}
+
+/* zrodlo HTML strony; false = file:// bez pliku (src to wtedy strona bledu) */
+bool pageSource(const string &u, string &src){
+    if(u.compare(0, 7, "file://")==0){
+        unsigned ino = vfsWalk(u.substr(7));
+        if(ino && vfsInode(ino).type==VFS_FILE){
+            string buf;
+            const VfsInode &f = vfsInode(ino);
+            src.assign(vfsView(f, buf), f.length);
+            return true;
         }
-        cout<<"\n";
+        src = "<h2>File not found</h2><p>No such file in the filesystem: <code>" + htmlEscape(u.substr(7)) + "</code></p>";
+        return false;
     }
-    setColor(7);
-    asciiBorder("END COMMANDS",72,14);
+    for(size_t i=0;i<sizeof SITE_PAGES / sizeof SITE_PAGES[0];i++)
+        if(u.find(SITE_PAGES[i].match)!=string::npos){ src = SITE_PAGES[i].html; return true; }
+    src = "<html><head><title>" + htmlEscape(u) + "</title></head><body><p>Generic page for: " + htmlEscape(u) +
+          "<br>[ASCII CONTENT FOLLOWS]</p><pre>";
+    for(int i=0;i<6;i++) src += " ~~~ " + string(40-(i*2),'~') + "\n";
+    src += "</pre></body></html>";
+    return true;
 }
 
-/* ===============================
-   FASTFETCH / EXTENDED
-=============================== */
-void fastfetch(){
-    setColor(13);
-    cout<<OS_NAME<<" | "<<KERNEL_VERSION<<" | User: "<<CURRENT_USER<<" | Env: "<<currentEnvironment<<" | Uptime: "<<getUptime()<<"\n\n";
-    setColor(7);
+/* link z bazy strony: wzgledny do katalogu file://, absolutny /x do korzenia VFS */
+string htmlResolve(const string &base, const string &href){
+    string h = href.substr(0, href.find('#'));
+    if(h.empty()) return base;
+    if(h.find("://")!=string::npos || base.compare(0, 7, "file://")!=0) return h;
+    if(h[0]=='/') return "file://" + h;
+    string dir = base.substr(0, base.rfind('/') + 1);
+    if(dir.size() <= 7) dir = "file://";
+    return dir + h;
 }
 
-void extendedFastfetch(){
-    asciiBorder("EXTENDED SYSTEM INFO",60,13);
-    setColor(13);
-    cout<<" OS: "<<OS_NAME<<"\n";
-    cout<<" Kernel: "<<KERNEL_VERSION<<"\n";
-    cout<<" User: "<<CURRENT_USER<<"\n";
-    cout<<" Environment: "<<currentEnvironment<<"\n";
-    cout<<" Uptime: "<<getUptime()<<"\n";
-    cout<<" Installed Programs:\n   ";
-    for(size_t i=0;i<installedPrograms.size();i++){
-        cout<<installedPrograms[i]<<"  ";
-        if((i+1)%4==0) cout<<"\n   ";
+/* strumien, ktory tylko liczy bajty (benchmark ukladu bez ekranu) */
+class CountingBuf : public streambuf {
+public:
+    size_t bytes;
+    CountingBuf(): bytes(0) {}
+protected:
+    virtual int overflow(int c){ if(c != EOF) bytes++; return c==EOF ? 0 : c; }
+    virtual streamsize xsputn(const char *, streamsize n){ bytes += (size_t)n; return n; }
+};
+
+/* dokument testowy ~mb MB: naglowki, akapity z linkami i encjami, listy, tabele, pre */
+string htmlBenchDoc(size_t mb){
+    string d = "<!DOCTYPE html><html><head><title>Bench</title><style>p{color:red}</style></head><body>\n";
+    const char *words[] = { "vireon", "kernel", "ascii", "browser", "layout", "token", "stream", "terminal" };
+    unsigned x = 12345;
+    for(int sec = 1; d.size() < mb << 20; sec++){
+        char h[64]; sprintf(h, "<h2 id=\"s%d\">Section %d</h2>\n", sec, sec); d += h;
+        for(int p=0;p<4;p++){
+            d += "<p class=\"body\">";
+            for(int w=0;w<60;w++){
+                x = x * 1103515245u + 12345u;
+                const char *wd = words[(x >> 16) & 7];
+                if(w % 17==5){ d += "<a href=\"docs/page"; d += wd; d += ".html\">"; d += wd; d += "</a> "; }
+                else if(w % 23==7){ d += "<b>"; d += wd; d += "</b> "; }
+                else if(w % 29==3) d += "&amp; ";
+                else { d += wd; d += ' '; }
+            }
+            d += "</p>\n";
+        }
+        d += "<ul><li>first item</li><li>second &lt;item&gt;</li><li><code>code()</code></li></ul>\n";
+        d += "<table><tr><th>key</th><th>value</th></tr><tr><td>a</td><td>1</td></tr></table>\n";
+        d += "<pre>  int main(){\n      return 0;\n  }</pre>\n<!-- comment -->\n";
     }
-    cout<<"\n Installed Environments:\n   ";
-    for(size_t i=0;i<installedEnvironments.size();i++){
-        cout<<installedEnvironments[i]<<"  ";
+    return d + "</body></html>\n";
+}
+
+/* browser bench [MB|PATH]: MB/s samego tokenizera i tokenizera z ukladem */
+void htmlBench(const string &arg){
+    string doc, label;
+    if(!arg.empty() && !isdigit((unsigned char)arg[0])){
+        string u = arg.compare(0, 7, "file://")==0 ? arg : "file://" + arg;
+        if(!pageSource(u, doc)){ cout<<"No such file: "<<arg<<"\n\n"; return; }
+        label = u;
+    } else {
+        size_t mb = arg.empty() ? 16 : (size_t)max(1, atoi(arg.c_str()));
+        doc = htmlBenchDoc(mb);
+        label = "generated";
     }
-    cout<<"\n";
+    double mbytes = doc.size() / 1048576.0;
+    int passes = max(1, (int)(64 / max(mbytes, 1.0)));
+    size_t tokens = 0;
+    long long t0 = nowMicros();
+    for(int i=0;i<passes;i++){
+        HtmlTokenizer tok(doc.data(), doc.size());
+        HtmlToken t;
+        while(tok.next(t)) tokens++;
+    }
+    long long tokUs = max(1LL, nowMicros() - t0);
+    CountingBuf sink;
+    ostream out(&sink);
+    int keep = screen.getAttr();
+    t0 = nowMicros();
+    for(int i=0;i<passes;i++) htmlRender(doc.data(), doc.size(), out, HTML_WIDTH);
+    long long layUs = max(1LL, nowMicros() - t0);
+    setColor(keep);
+    char buf[128];
+    asciiBorder("HTML BENCHMARK: " + label, 64, 11);
+    setColor(11);
+    sprintf(buf, " Document     : %.2f MB, %lu tokens, %d pass(es)\n", mbytes, (unsigned long)(tokens / passes), passes); cout<<buf;
+    sprintf(buf, " Tokenize     : %.1f MB/s\n", mbytes * passes * 1e6 / tokUs); cout<<buf;
+    sprintf(buf, " Parse+layout : %.1f MB/s (%lu bytes of output per pass)\n\n", mbytes * passes * 1e6 / layUs,
+            (unsigned long)(sink.bytes / passes)); cout<<buf;
     setColor(7);
-    asciiBorder("END EXTENDED INFO",60,13);
 }
 
 /* ===============================
@@ -552,7 +6063,7 @@ void browserShell(){
     smallLogo("browser");
     if(browserTabs.empty()){
         browserNewTab("home://start");
-    }
+    } else prefetchPlan(vector<string>());   // karty z sesji
     string line;
     while(true){
         if(activeTabIndex >=0 && activeTabIndex < (int)browserTabs.size()){
@@ -561,138 +6072,85 @@ void browserShell(){
             setColor(7);
         }
         cout<<"browser> ";
+        waitForInput();
         if(!getline(cin,line)) break;
         if(line.size()==0) continue;
-        string cmd = toLowerStr(line);
-        if(cmd=="exit" || cmd=="quit") break;
-        else if(cmd=="help"){
-            cout<<"Browser commands: open URL | newtab URL | closetab N | switch N | back | forward | refresh | bookmark | bookmarks | history | search TERM | viewsource | download | tabs | exit\n";
-        }
-        else if(cmd.substr(0,5)=="open "){
-            string url = line.substr(5);
-            browserOpen(url);
-        }
-        else if(cmd.substr(0,7)=="newtab "){
-            string url = line.substr(7);
-            browserNewTab(url);
-        }
-        else if(cmd.substr(0,8)=="closetab"){
-            int idx = -1;
-            if(sscanf(line.c_str(),"closetab %d",&idx)==1){
-                browserCloseTab(idx-1);
-            } else {
-                cout<<"Usage: closetab N\n";
-            }
-        }
-        else if(cmd.substr(0,6)=="switch"){
-            int idx=-1;
-            if(sscanf(line.c_str(),"switch %d",&idx)==1){
-                browserSwitchTab(idx-1);
-            } else cout<<"Usage: switch N\n";
-        }
-        else if(cmd=="tabs"){
-            cout<<"Open Tabs:\n";
-            for(size_t i=0;i<browserTabs.size();i++){
-                printf(" %2d) %-30s %s\n", (int)i+1, browserTabs[i].title.c_str(), browserTabs[i].url.c_str());
-            }
-        }
-        else if(cmd=="bookmark"){
-            if(activeTabIndex>=0 && activeTabIndex < (int)browserTabs.size()){
-                browserBookmarks.push_back(browserTabs[activeTabIndex].url);
-                cout<<"Bookmarked: "<<browserTabs[activeTabIndex].url<<"\n";
-                addLog("Browser bookmark added: "+browserTabs[activeTabIndex].url);
-            } else cout<<"No active tab\n";
-        }
-        else if(cmd=="bookmarks"){
-            browserShowBookmarks();
-        }
-        else if(cmd=="history"){
-            browserShowHistory();
-        }
-        else if(cmd.substr(0,7)=="search "){
-            string term = line.substr(7);
-            cout<<"Search results for: "<<term<<"\n";
-            for(int i=1;i<=5;i++){
-                printf(" %d) https://search.fake/%s/result%d\n", i, term.c_str(), i);
-            }
-            cout<<"Open result number? (0 = none): ";
-            int r; cin>>r; cin.ignore();
-            if(r>=1 && r<=5){
-                char buf[256];
-                sprintf(buf, "https://search.fake/%s/result%d", term.c_str(), r);
-                string url = buf;
-                browserOpen(url);
-            }
-        }
-        else if(cmd=="back"){
-            if(browserHistory.size() >= 2){
-                browserHistory.pop_back();
-                string prev = browserHistory.back();
-                browserOpen(prev);
-            } else cout<<"No history\n";
-        }
-        else if(cmd=="viewsource"){
-            if(activeTabIndex>=0 && activeTabIndex < (int)browserTabs.size()){
-                browserViewSource(browserTabs[activeTabIndex].url);
-            } else cout<<"No active tab\n";
-        }
-        else if(cmd=="download"){
-            if(activeTabIndex>=0 && activeTabIndex < (int)browserTabs.size()){
-                browserDownload(browserTabs[activeTabIndex].url);
-            } else cout<<"No active tab\n";
-        }
-        else if(cmd=="refresh"){
-            if(activeTabIndex>=0 && activeTabIndex < (int)browserTabs.size()){
-                cout<<"Refreshing "<<browserTabs[activeTabIndex].url<<"\n";
-                loadingBar("Refresh",24,9);
-                browserOpen(browserTabs[activeTabIndex].url);
-            } else cout<<"No active tab\n";
-        }
-        else cout<<"Unknown browser command. Type 'help'.\n";
+        if(browserCommands.slots.empty()) initBrowserCommands();
+        int rc = runCommand(browserCommands, line);
+        if(rc==CMD_EXIT) break;
+        if(rc==CMD_UNKNOWN) cout<<"Unknown browser command. Type 'help'.\n";
     }
 
+    prefetchCancel();
     asciiBorder("CLOSING BROWSER",64,9);
 }
 
+/* strona u w aktywnej karcie jako wizyta w historii */
+void browserShow(const string &u){
+    Tab &t = browserTabs[activeTabIndex];
+    t.url = u;
+    t.title = u;
+    procEnter(PID_NETIF);
+    historyVisit(u);
+    logEvent(LOG_INFO, "Browser opened: %s", u.c_str());
+    pageShow(u);
+    procLeave();
+    prefetchPlan(vector<string>());
+}
+
+void tabPush(vector<string> &stack, const string &u){
+    if(u.empty()) return;
+    stack.push_back(u);
+    if(stack.size() > TAB_STACK) stack.erase(stack.begin());
+}
+
 void browserOpen(const string &url){
     string u = url;
     if(u=="home://start") u = "vireonos.com/home";
     if(activeTabIndex==-1){
         browserNewTab(u);
         return;
-    } else {
-        browserTabs[activeTabIndex].url = u;
-        browserTabs[activeTabIndex].title = u;
     }
-    browserHistory.push_back(u);
-    addLog("Browser opened: "+u);
+    Tab &t = browserTabs[activeTabIndex];
+    if(t.url!=u){ tabPush(t.back, t.url); t.fwd.clear(); }
+    browserShow(u);
+}
+
+/* back (dir<0) / forward (dir>0) w obrebie aktywnej karty */
+void browserGo(int dir){
+    Tab &t = browserTabs[activeTabIndex];
+    vector<string> &from = dir < 0 ? t.back : t.fwd, &to = dir < 0 ? t.fwd : t.back;
+    if(from.empty()){ cout<<(dir < 0 ? "No previous page\n" : "No next page\n"); return; }
+    string u = from.back();
+    from.pop_back();
+    tabPush(to, t.url);
+    browserShow(u);
+}
 
+/* tresc strony na cout; pageShow() przechwytuje ja do bufora w cache */
+void browserRender(const string &u, vector<string> *links){
     asciiBorder("PAGE: "+u,64,10);
-    if(u.find("vireonos.com")!=string::npos){
-        smallLogo("vireon");
-        cout<<"Welcome to VireonOS official ASCII page!\n";
-        cout<<"- Projects: VireonOS, VireonTools, VireonArt\n";
-        cout<<"- Follow the fake dev announcements.\n";
-    } else if(u.find("github.com")!=string::npos){
-        cout<<"GitHub - Fake Repositories:\n";
-        cout<<" - fireon/vireonos\n - guest/demo\n - tools/ascii-suite\n";
-    } else if(u.find("youtube")!=string::npos || u.find("video")!=string::npos){
-        cout<<"YouTube Beta - Video Player (ASCII)\n";
-        cout<<"Type 'play' to play sample, or 'download' to fake-download.\n";
-    } else if(u.find("example.com")!=string::npos){
-        cout<<"Example Page\nLorem ipsum dolor sit amet, ascii content demo.\n";
-    } else if(u.find("search.fake")!=string::npos){
-        cout<<"Search engine placeholder page.\n";
-    } else {
-        cout<<"Generic page for: "<<u<<"\n";
-        cout<<"[ASCII CONTENT FOLLOWS]\n";
-        for(int i=0;i<6;i++){
-            cout<<" ~~~ "<<string(40-(i*2),'~')<<"\n";
-        }
-    }
+    string src;
+    pageSource(u, src);
+    htmlRender(src.data(), src.size(), cout, HTML_WIDTH);
+    if(links) htmlLinks(src.data(), src.size(), *links);
     cout<<"\n";
 }
 
+/* follow N: n-ty link strony z aktywnej karty, numeracja z ekranu */
+void browserFollow(int n){
+    const string &u = browserTabs[activeTabIndex].url;
+    vector<string> links;
+    if(u==pageShownUrl) links = pageShownLinks;
+    else {
+        string src;
+        pageSource(u, src);
+        htmlLinks(src.data(), src.size(), links);
+    }
+    if(n < 1 || n > (int)links.size()){ cout<<"No link ["<<n<<"] on this page\n"; return; }
+    browserOpen(htmlResolve(u, links[n-1]));
+}
+
 void browserShowBookmarks(){
     cout<<"\nBookmarks:\n";
     if(browserBookmarks.empty()) cout<<" (none)\n\n";
@@ -704,20 +6162,52 @@ void browserShowBookmarks(){
     }
 }
 
-void browserShowHistory(){
-    cout<<"\nHistory (most recent last):\n";
-    if(browserHistory.empty()) cout<<" (none)\n\n";
-    else {
-        for(size_t i=0;i<browserHistory.size();i++){
-            cout<<" "<<i+1<<") "<<browserHistory[i]<<"\n";
+/* ostatnie wizyty (domyslnie 20) albo --top: adresy wg frecency */
+void browserShowHistory(const string &args){
+    const History &h = history;
+    bool top = args.find("--top")!=string::npos;
+    int n = 20;
+    for(size_t i=0;i<args.size();i++) if(isdigit((unsigned char)args[i])){ n = atoi(args.c_str()+i); break; }
+    if(top){
+        vector<int> ids;
+        historySuggest("", n, ids);
+        cout<<"\nMost visited (frecency):\n";
+        for(size_t i=0;i<ids.size();i++){
+            time_t when = (time_t)h.urls[ids[i]].lastVisit;
+            struct tm *lt = localtime(&when);
+            char line[96];
+            sprintf(line, " %2d) %7.2f %5u  %04d-%02d-%02d %02d:%02d  ", (int)i+1, historyScore(ids[i]), h.urls[ids[i]].total,
+                    lt->tm_year + 1900, lt->tm_mon + 1, lt->tm_mday, lt->tm_hour, lt->tm_min);
+            cout<<line<<h.urls[ids[i]].url<<"\n";
+        }
+    } else {
+        size_t shown = min((size_t)max(n, 0), h.ring.size());
+        cout<<"\nHistory (most recent first):\n";
+        for(size_t i=0;i<shown;i++){
+            int id = historyAt(h.ring.size() - 1 - i);
+            cout<<" "<<i+1<<") "<<h.urls[id].url<<"\n";
         }
-        cout<<"\n";
     }
+    if(h.ring.empty()) cout<<" (none)\n";
+    char foot[96];
+    sprintf(foot, "(%lu visit(s) kept, %lu address(es))\n\n", (unsigned long)h.ring.size(), (unsigned long)h.live);
+    cout<<foot;
+}
+
+/* complete PREFIX: podpowiedzi z historii */
+void browserComplete(const string &prefix){
+    long long t0 = nowMicros();
+    vector<int> ids;
+    historySuggest(prefix, HISTORY_SUGGEST, ids);
+    long long us = nowMicros() - t0;
+    for(size_t i=0;i<ids.size();i++) cout<<" "<<i+1<<") "<<history.urls[ids[i]].url<<"\n";
+    char foot[64];
+    sprintf(foot, "(%d suggestion(s), %.3f ms)\n", (int)ids.size(), us / 1000.0);
+    cout<<foot;
 }
 
 void browserNewTab(const string &url){
-    Tab t; t.url = url; t.title = url;
-    browserTabs.push_back(t);
+    browserTabs.push_back(Tab());
     activeTabIndex = (int)browserTabs.size()-1;
     cout<<"New tab opened: "<<url<<"\n";
     browserOpen(url);
@@ -741,24 +6231,217 @@ void browserSwitchTab(int idx){
     }
     activeTabIndex = idx;
     cout<<"Switched to tab "<<idx+1<<"\n";
-    browserOpen(browserTabs[activeTabIndex].url);
+    /* przelaczenie to nie wizyta: tylko strona z cache */
+    procEnter(PID_NETIF);
+    pageShow(browserTabs[activeTabIndex].url);
+    procLeave();
+    prefetchPlan(vector<string>());
 }
 
 void browserViewSource(const string &url){
-    asciiBorder("VIEW SOURCE",64,12);
-    cout<<"<!-- Fake HTML source for "<<url<<" -->\n";
-    cout<<"<html>\n <head><title>Demo</title></head>\n <body>\n  <h1>Welcome</h1>\n  <p>This is an ASCII demo page</p>\n </body>\n</html>\n\n";
+    asciiBorder("VIEW SOURCE: "+url,64,12);
+    string src;
+    pageSource(url, src);
+    cout<<src;
+    if(!src.empty() && src[src.size()-1]!='\n') cout<<"\n";
+    cout<<"\n";
+}
+
+void browserDownload(const string &url){ dlAdd(url, ""); }
+
+/* ===============================
+   BROWSER SESSION
+   Plik dataDir/session-NAZWA.bin: karty, historia i zakladki jako id
+   napisow z jednej puli (kazdy URL zapisany raz). Wczytanie to jeden
+   odczyt pliku, sprawdzenie rozmiarow i sumy, potem zamiana id na napisy;
+   zadnego parsowania wpis po wpisie.
+     naglowek SessionHeader
+     u32 ends[strings]         koniec kazdego napisu w puli
+     u32 tabs[tabs*2]          id tytulu, id url
+     u32 history[history], u32 bookmarks[bookmarks]
+     SessionUrl urls[urls]     frecency i ostatnia wizyta adresow historii
+     char pool[poolBytes]
+=============================== */
+const char SESSION_MAGIC[8] = { 'V','S','E','S','S','I','O','N' };
+const unsigned SESSION_VERSION = 2;
+
+/* stan adresu z historii: bez niego odtworzone wizyty dostalyby czas
+   wczytania i ranking bylby zwykla liczba wizyt */
+struct SessionUrl {
+    unsigned str;                       // id napisu
+    unsigned total;
+    long long lastVisit;
+    double frecency;
+};
+
+struct SessionHeader {
+    char magic[8];
+    unsigned version;
+    unsigned strings, poolBytes;
+    unsigned tabs, history, bookmarks, urls;
+    int activeTab;
+    unsigned checksum;                  // fnv1a wszystkiego za naglowkiem
+};
+
+struct SessionWriter {
+    map<string,unsigned> ids;
+    vector<unsigned> ends;
+    string pool;
+    unsigned intern(const string &s){
+        map<string,unsigned>::iterator it = ids.find(s);
+        if(it!=ids.end()) return it->second;
+        unsigned id = (unsigned)ends.size();
+        ids[s] = id;
+        pool += s;
+        ends.push_back((unsigned)pool.size());
+        return id;
+    }
+};
+
+string sessionEncode(){
+    SessionWriter w;
+    vector<unsigned> refs;
+    for(size_t i=0;i<browserTabs.size();i++){
+        refs.push_back(w.intern(browserTabs[i].title));
+        refs.push_back(w.intern(browserTabs[i].url));
+    }
+    for(size_t i=0;i<history.ring.size();i++) refs.push_back(w.intern(history.urls[historyAt(i)].url));
+    for(size_t i=0;i<browserBookmarks.size();i++) refs.push_back(w.intern(browserBookmarks[i]));
+    vector<SessionUrl> urls;
+    for(size_t i=0;i<history.urls.size();i++){
+        const HistoryUrl &u = history.urls[i];
+        if(u.node < 0) continue;
+        SessionUrl s = { w.intern(u.url), u.total, u.lastVisit, u.frecency };
+        urls.push_back(s);
+    }
+    SessionHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, SESSION_MAGIC, 8);
+    h.version = SESSION_VERSION;
+    h.strings = (unsigned)w.ends.size();
+    h.poolBytes = (unsigned)w.pool.size();
+    h.tabs = (unsigned)browserTabs.size();
+    h.history = (unsigned)history.ring.size();
+    h.bookmarks = (unsigned)browserBookmarks.size();
+    h.urls = (unsigned)urls.size();
+    h.activeTab = activeTabIndex;
+    string body;
+    body.reserve((w.ends.size() + refs.size()) * 4 + urls.size() * sizeof(SessionUrl) + w.pool.size());
+    if(!w.ends.empty()) body.append((const char*)&w.ends[0], w.ends.size() * 4);
+    if(!refs.empty()) body.append((const char*)&refs[0], refs.size() * 4);
+    if(!urls.empty()) body.append((const char*)&urls[0], urls.size() * sizeof(SessionUrl));
+    body += w.pool;
+    h.checksum = fnv1a(body.data(), body.size());
+    return string((const char*)&h, sizeof h) + body;
+}
+
+/* stan przegladarki z bloku; przy bledzie nic nie zmienia */
+bool sessionDecode(const char *data, size_t size, string &err){
+    SessionHeader h;
+    if(size < sizeof h){ err = "truncated"; return false; }
+    memcpy(&h, data, sizeof h);
+    if(memcmp(h.magic, SESSION_MAGIC, 8)!=0){ err = "not a session file"; return false; }
+    if(h.version!=SESSION_VERSION){ err = "unsupported version"; return false; }
+    unsigned long long words = (unsigned long long)h.strings + 2ULL*h.tabs + h.history + h.bookmarks;
+    unsigned long long statBytes = (unsigned long long)h.urls * sizeof(SessionUrl);
+    if(sizeof h + words*4 + statBytes + h.poolBytes != size){ err = "size mismatch"; return false; }
+    const char *body = data + sizeof h;
+    if(fnv1a(body, size - sizeof h)!=h.checksum){ err = "checksum mismatch"; return false; }
+    vector<unsigned> w((size_t)words);
+    if(words) memcpy(&w[0], body, (size_t)words * 4);
+    vector<SessionUrl> stats(h.urls);
+    if(h.urls) memcpy(&stats[0], body + words*4, (size_t)statBytes);
+    for(unsigned i=0;i<h.urls;i++)
+        if(stats[i].str >= h.strings){ err = "bad string id"; return false; }
+    const char *pool = body + words*4 + statBytes;
+    /* napisy puli: konce rosnace i w granicach puli */
+    vector<string> strs(h.strings);
+    for(unsigned i=0, start=0;i<h.strings;i++){
+        if(w[i] < start || w[i] > h.poolBytes){ err = "bad string table"; return false; }
+        strs[i].assign(pool + start, w[i] - start);
+        start = w[i];
+    }
+    for(size_t i=h.strings;i<w.size();i++)
+        if(w[i] >= h.strings){ err = "bad string id"; return false; }
+    const unsigned *ref = w.empty() ? 0 : &w[0] + h.strings;
+    vector<Tab> tabs(h.tabs);
+    for(unsigned i=0;i<h.tabs;i++){ tabs[i].title = strs[*ref++]; tabs[i].url = strs[*ref++]; }
+    /* historia: kazdy napis puli internowany raz, wizyty to juz tylko id */
+    const unsigned *visits = ref;
+    ref += h.history;
+    vector<string> bookmarks(h.bookmarks);
+    for(unsigned i=0;i<h.bookmarks;i++) bookmarks[i] = strs[*ref++];
+    historyClear();
+    size_t distinct = min((size_t)h.strings, (size_t)HISTORY_KEEP);
+    history.urls.reserve(distinct);
+    history.nodes.reserve(distinct * 2 + 1);
+    vector<int> urlOf(h.strings, -1);
+    vector<char> hasStat(h.strings, 0);
+    for(unsigned i=0;i<h.urls;i++) hasStat[stats[i].str] = 1;
+    /* starsze niz HISTORY_KEEP i tak by wypadly; bez nich id z urlOf sa stale */
+    for(unsigned i = h.history > HISTORY_KEEP ? h.history - HISTORY_KEEP : 0; i<h.history; i++){
+        int &id = urlOf[visits[i]];
+        if(id < 0) id = historyIntern(strs[visits[i]]);
+        if(hasStat[visits[i]]) historyRingPush(id);
+        else historyVisitId(id);        // adres bez zapisanego stanu: wizyta teraz
+    }
+    /* zapisana frecency i ostatnia wizyta zamiast czasu wczytania */
+    for(unsigned i=0;i<h.urls;i++){
+        int id = urlOf[stats[i].str];
+        if(id < 0) continue;
+        HistoryUrl &u = history.urls[id];
+        u.total = max(stats[i].total, u.visits);
+        u.lastVisit = stats[i].lastVisit;
+        u.frecency = stats[i].frecency;
+        trieRaise(u.node, u.frecency);
+    }
+    browserTabs.swap(tabs);
+    browserBookmarks.swap(bookmarks);
+    activeTabIndex = h.activeTab >= 0 && h.activeTab < (int)browserTabs.size() ? h.activeTab : (int)browserTabs.size() - 1;
+    return true;
 }
 
-void browserDownload(const string &url){
-    cout<<"Starting download for: "<<url<<"\n";
-    loadingBar("Downloading",34,11);
-    char fnamebuf[64];
-    sprintf(fnamebuf, "dl_%d.bin", rand()%9999);
-    string filename = fnamebuf;
-    fileSystem[filename] = "FAKE-BINARY-DATA";
-    addLog("Downloaded "+url+" -> "+filename);
-    cout<<"Saved to "<<filename<<"\n\n";
+string sessionPath(const string &name){ return dataPath("session-" + name + ".bin"); }
+
+/* session save|load [NAZWA] */
+void browserSession(const string &args){
+    istringstream in(args);
+    string op, name;
+    in>>op>>name;
+    if(name.empty()) name = "default";
+    if((op!="save" && op!="load") || !vfsValidName(name)){ cout<<"Usage: session save|load [NAME]\n\n"; return; }
+    if(!dataEnabled()){ cout<<"Sessions need a data directory (--data DIR).\n\n"; return; }
+    long long t0 = nowMicros();
+    string path = sessionPath(name), err;
+    size_t bytes = 0;
+    if(op=="save"){
+        string blob = sessionEncode();
+        FILE *f = ensureDataDir() ? fopen(path.c_str(), "wb") : 0;
+        bool ok = f && fwrite(blob.data(), 1, blob.size(), f)==blob.size();
+        if(f && fclose(f)!=0) ok = false;
+        if(!ok){ cout<<"Cannot write "<<path<<"\n\n"; return; }
+        bytes = blob.size();
+    } else {
+        FILE *f = fopen(path.c_str(), "rb");
+        if(!f){ cout<<"No such session: "<<name<<"\n\n"; return; }
+        string blob;
+        fseek(f, 0, SEEK_END);
+        long n = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if(n > 0){
+            blob.resize((size_t)n);
+            if(fread(&blob[0], 1, blob.size(), f)!=blob.size()) blob.clear();
+        }
+        fclose(f);
+        if(!sessionDecode(blob.data(), blob.size(), err)){ cout<<"Cannot load session "<<name<<": "<<err<<"\n\n"; return; }
+        bytes = blob.size();
+    }
+    logEvent(LOG_INFO, "Session %s: %s", op.c_str(), name.c_str());
+    char line[128];
+    sprintf(line, ": %d tab(s), %d history, %d bookmark(s), %lu bytes (%.3f ms)\n\n",
+            (int)browserTabs.size(), (int)history.ring.size(), (int)browserBookmarks.size(),
+            (unsigned long)bytes, (nowMicros() - t0) / 1000.0);
+    cout<<"Session "<<name<<(op=="save" ? " saved" : " loaded")<<line;
 }
 
 /* ===============================
@@ -766,30 +6449,33 @@ void browserDownload(const string &url){
 =============================== */
 void asciiBorder(const string &title, int width, int color){
     setColor(color);
-    cout<<"\n+";
-    for(int i=0;i<width;i++) cout<<"=";
-    cout<<"+\n";
+    string bar = "+" + string(width,'=') + "+\n";
+    cout<<"\n"<<bar;
     cout<<"| "<<title;
-    if((int)title.length() < width-1){
-        for(int i=0;i<width - (int)title.length() -1; i++) cout<<" ";
-    }
-    cout<<"|\n";
-    cout<<"+";
-    for(int i=0;i<width;i++) cout<<"=";
-    cout<<"+\n";
+    if((int)title.length() < width-1) cout<<string(width - (int)title.length() - 1, ' ');
+    cout<<"|\n"<<bar;
     setColor(7);
 }
 
+bool barStep(Task &t){
+    if(t.frame >= t.frames) return false;
+    t.frame++;
+    t.rows[0][t.vals[0] + t.frame - 1] = '#';
+    t.delayMs = 30 + rand()%60;
+    return true;
+}
+
+void barFinish(Task &t){ if(t.foreground) cout<<"\n"; }
+
+const TaskKind barTask = { true, 0, barStep, barFinish };
+
+/* pasek postepu jako zadanie pierwszego planu: w trakcie chodza zadania w tle */
 void loadingBar(const string &label, int length, int color){
-    setColor(color);
-    cout<<label<<": [";
-    for(int i=0;i<length;i++) cout<<" ";
-    cout<<"]\r"<<label<<": [";
-    for(int i=0;i<length;i++){
-        cout<<"#"; msleep(30 + rand()%60);
-    }
-    cout<<"]\n";
-    setColor(7);
+    Task *t = createTask(&barTask, label, 0, length);
+    t->color = color;
+    t->rows.push_back(label + ": [" + string(length,' ') + "]");
+    t->vals.push_back((int)label.size() + 3);
+    launchTask(t, false);
 }
 
 void smallLogo(const string &id){
@@ -822,6 +6508,11 @@ string toLowerStr(const string &s){
     return out;
 }
 
+string trim(const string &s){
+    size_t b = s.find_first_not_of(" \t\r\n"), e = s.find_last_not_of(" \t\r\n");
+    return b==string::npos ? "" : s.substr(b, e - b + 1);
+}
+
 void pressAnyKey(){
     cout<<"Press ENTER to continue...";
     string tmp; getline(cin,tmp);
@@ -829,12 +6520,154 @@ void pressAnyKey(){
 
 /* ===============================
    BOOT
+   Kazda faza startu zostawia znacznik czasu; --boot-profile wypisuje
+   je przed pierwszym promptem jako os czasu.
 =============================== */
+struct BootPhase { const char *name; long long at; };
+vector<BootPhase> bootPhases;
+long long bootStart = 0;          // nowMicros() na wejsciu do main
+bool bootRestored = false;        // stan wczytany z boot.img
+
+void bootMark(const char *name){
+    BootPhase p = { name, nowMicros() };
+    bootPhases.push_back(p);
+}
+
+void bootReport(){
+    setColor(11);
+    cout<<"\n--- Boot profile ---\n";
+    setColor(7);
+    long long prev = bootStart;
+    for(size_t i=0;i<bootPhases.size();i++){
+        char line[96];
+        sprintf(line, " %-16s %8.3f ms %9.3f ms\n", bootPhases[i].name,
+                (bootPhases[i].at - prev) / 1000.0, (bootPhases[i].at - bootStart) / 1000.0);
+        cout<<line;
+        prev = bootPhases[i].at;
+    }
+    char line[64];
+    sprintf(line, " time to prompt   %8.3f ms\n\n", (prev - bootStart) / 1000.0);
+    cout<<line;
+}
+
+/* Obraz startowy dataDir/boot.img, zapisywany przy wyjsciu: srodowisko,
+   zainstalowane paczki, sesja przegladarki i seedy tabel komend. Paczki
+   sa brane z obrazu tylko, gdy pieczatka zgadza sie z naglowkiem vfs.img
+   (txSeq, epoch, dataEnd); inaczej czyta je regLoad() z VFS.
+     "VBOOTIM1" u32 wersja, u32 pieczatka[3], u32 seed/mask x2,
+     str srodowisko, u32 n + (u32 rodzaj, str nazwa, str wersja),
+     str sesja (sessionEncode);  str = u32 dlugosc + bajty */
+const char BOOT_IMG_MAGIC[8] = { 'V','B','O','O','T','I','M','1' };
+const unsigned BOOT_IMG_VERSION = 2;
+
+void imgU32(string &out, unsigned v){ out.append((const char*)&v, sizeof v); }
+void imgStr(string &out, const string &v){ imgU32(out, (unsigned)v.size()); out += v; }
+
+struct ImgReader {
+    const char *p, *end;
+    bool ok;
+    unsigned u32(){
+        unsigned v = 0;
+        if(end - p < (ptrdiff_t)sizeof v){ ok = false; p = end; return 0; }
+        memcpy(&v, p, sizeof v); p += sizeof v;
+        return v;
+    }
+    string str(){
+        unsigned n = u32();
+        if((size_t)(end - p) < n){ ok = false; p = end; return ""; }
+        string v(p, n); p += n;
+        return v;
+    }
+};
+
+void bootStamp(unsigned stamp[3]){
+    const VfsHeader &h = vfsHeader();
+    stamp[0] = h.txSeq; stamp[1] = h.epoch; stamp[2] = h.dataEnd;
+}
+
+void bootSave(){
+    if(!dataEnabled() || !vfsBase()) return;
+    string out(BOOT_IMG_MAGIC, 8);
+    imgU32(out, BOOT_IMG_VERSION);
+    unsigned stamp[3];
+    bootStamp(stamp);
+    for(int i=0;i<3;i++) imgU32(out, stamp[i]);
+    imgU32(out, shellCommands.seed); imgU32(out, shellCommands.mask);
+    imgU32(out, browserCommands.seed); imgU32(out, browserCommands.mask);
+    imgStr(out, currentEnvironment);
+    unsigned pkgs = 0;
+    for(int k=0;k<PKG_KINDS;k++) pkgs += (unsigned)regList(k).size();
+    imgU32(out, pkgs);
+    for(int k=0;k<PKG_KINDS;k++)
+        for(size_t i=0;i<regList(k).size();i++){
+            int id = regList(k)[i];
+            imgU32(out, (unsigned)k); imgStr(out, regName(id)); imgStr(out, registry.versions[id]);
+        }
+    imgStr(out, sessionEncode());
+    /* nowy plik obok, potem podmiana: przerwany zapis nie psuje starego */
+    string path = dataPath("boot.img"), tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if(!f) return;
+    bool ok = fwrite(out.data(), 1, out.size(), f)==out.size();
+    if(fclose(f)!=0) ok = false;
+    if(ok){ remove(path.c_str()); ok = rename(tmp.c_str(), path.c_str())==0; }
+    if(!ok) remove(tmp.c_str());
+}
+
+/* true = obraz wczytany; paczki z niego tylko przy zgodnej pieczatce */
+bool bootRestore(bool &pkgsRestored){
+    pkgsRestored = false;
+    if(!dataEnabled()) return false;
+    MappedFile m;
+    if(!mapFile(dataPath("boot.img"), m)) return false;
+    ImgReader r = { m.data, m.data + m.size, m.size >= 8 && memcmp(m.data, BOOT_IMG_MAGIC, 8)==0 };
+    if(r.ok){ r.p += 8; r.ok = r.u32()==BOOT_IMG_VERSION; }
+    if(!r.ok){ unmapFile(m); return false; }
+    unsigned stamp[3], now[3];
+    bootStamp(now);
+    for(int i=0;i<3;i++) stamp[i] = r.u32();
+    CommandTable sh, br;
+    sh.seed = r.u32(); sh.mask = r.u32();
+    br.seed = r.u32(); br.mask = r.u32();
+    string env = r.str();
+    vector<unsigned> kinds;
+    vector<string> names, versions;
+    for(unsigned n = r.u32(); r.ok && n; n--){
+        kinds.push_back(r.u32()); names.push_back(r.str()); versions.push_back(r.str());
+    }
+    string session = r.str(), err;
+    unmapFile(m);
+    if(!r.ok) return false;
+
+    /* obraz nie ma sumy kontrolnej: zla maska = brak seedow, tabela od zera */
+    if(cmdMaskValid(sh.mask)){ shellCommands.seed = sh.seed; shellCommands.mask = sh.mask; }
+    if(cmdMaskValid(br.mask)){ browserCommands.seed = br.seed; browserCommands.mask = br.mask; }
+    currentEnvironment = env;
+    sessionDecode(session.data(), session.size(), err);
+    if(memcmp(stamp, now, sizeof now)==0){
+        for(size_t i=0;i<names.size();i++)
+            if(kinds[i] < (unsigned)PKG_KINDS) regAdd(regIntern(names[i]), (int)kinds[i], versions[i]);
+        pkgsRestored = true;
+    }
+    return true;
+}
+
 void boot(){
     bootTime = time(0);
+    bootClock = clockNow();
     srand((unsigned)time(0));
+    logOpenStore();
+    bootMark("log store");
     initFS();
+    bootMark("filesystem");
+    bool pkgs;
+    bootRestored = bootRestore(pkgs);
+    if(!pkgs) regLoad();
+    bootMark(bootRestored ? "boot image" : "packages");
     initProcesses();
+    bootMark("processes");
+    initCommands();
+    bootMark("commands");
     addLog("System booted");
     addLog("Kernel initialized");
 }
@@ -858,86 +6691,560 @@ void drawDesktop(){
     asciiBorder("VireonOS Desktop",72,11);
     cout<<"[ Desktop layout - Apps | Commands | Status ]\n";
     cout<<"  Apps: ";
-    for(size_t i=0;i<installedPrograms.size();i++){
-        cout<<installedPrograms[i];
-        if(i+1 < installedPrograms.size()) cout<<" | ";
+    const vector<int> &apps = regList(PKG_APP);
+    for(size_t i=0;i<apps.size();i++){
+        cout<<regName(apps[i]);
+        if(i+1 < apps.size()) cout<<" | ";
     }
     cout<<"\n  Status: User="<<CURRENT_USER<<" | Uptime="<<getUptime()<<" | Env="<<currentEnvironment<<"\n\n";
 }
 
 /* ===============================
-   MAIN SHELL
+   COMMAND TABLE
+   Nazwy w perfect hashu budowanym raz przy starcie: seed dobierany tak,
+   zeby zadne dwie komendy nie trafily w ten sam slot, wiec lookup to
+   jeden hash pierwszego slowa (bez kopii/tolower linii) i jedno porownanie.
 =============================== */
-int main(){
-    boot();
-    showLogo();
+unsigned cmdHash(unsigned seed, const char *s, size_t n){
+    unsigned h = 2166136261u ^ seed;
+    for(size_t i=0;i<n;i++){ h ^= (unsigned char)tolower((unsigned char)s[i]); h *= 16777619u; }
+    return h ^ (h>>15);
+}
 
-    installer();
-    drawCommandsTable();
+void addCommand(CommandTable &t, const char *name, const char *usage, const char *group,
+                const char *desc, ArgKind arg, CmdHandler handler, bool hidden=false){
+    /* dwie takie same nazwy (bez wzgledu na wielkosc liter) zawsze trafiaja
+       w ten sam slot: perfect hash by ich nie rozdzielil */
+    for(size_t i=0;i<t.cmds.size();i++)
+        if(toLowerStr(t.cmds[i].name)==toLowerStr(name)){
+            cout<<"Command table: duplicate command '"<<name<<"' ignored\n";
+            return;
+        }
+    Command c;
+    c.name = name; c.usage = usage; c.group = group; c.desc = desc;
+    c.arg = arg; c.handler = handler; c.hidden = hidden;
+    t.cmds.push_back(c);
+}
+
+bool placeCommands(CommandTable &t, size_t size){
+    t.slots.assign(size, -1);
+    for(size_t i=0;i<t.cmds.size();i++){
+        unsigned k = cmdHash(t.seed, t.cmds[i].name, strlen(t.cmds[i].name)) & t.mask;
+        if(t.slots[k] >= 0) return false;
+        t.slots[k] = (int)i;
+    }
+    return true;
+}
+
+/* seed/mask z obrazu startowego sprawdzane najpierw: wtedy bez szukania */
+void buildCommandTable(CommandTable &t){
+    if(cmdMaskValid(t.mask) && placeCommands(t, (size_t)t.mask + 1)) return;
+    size_t size = 8;
+    while(size < t.cmds.size()*2) size *= 2;
+    for(;size <= (1u << 16);size*=2){
+        t.mask = (unsigned)size - 1;
+        for(t.seed=1; t.seed<4096; t.seed++)
+            if(placeCommands(t, size)) return;
+    }
+    cout<<"Command table: no collision-free layout for "<<t.cmds.size()<<" commands\n";
+    t.slots.clear();
+    t.mask = 0;
+}
+
+const Command *findCommand(const CommandTable &t, const char *s, size_t n){
+    if(t.slots.empty()) return 0;
+    int i = t.slots[cmdHash(t.seed, s, n) & t.mask];
+    if(i < 0) return 0;
+    const char *name = t.cmds[i].name;
+    for(size_t k=0;k<n;k++)
+        if(name[k]=='\0' || (char)tolower((unsigned char)s[k]) != name[k]) return 0;
+    return name[n]=='\0' ? &t.cmds[i] : 0;
+}
+
+int runCommand(const CommandTable &t, const string &line){
+    size_t b = line.find_first_not_of(' ');
+    if(b==string::npos) return CMD_DONE;
+    size_t e = line.find(' ', b);
+    if(e==string::npos) e = line.size();
+    const Command *c = findCommand(t, line.data()+b, e-b);
+    if(!c) return CMD_UNKNOWN;
+
+    size_t a = line.find_first_not_of(' ', e);
+    CmdArgs args;
+    args.num = 0;
+    bool ok = true;
+    switch(c->arg){
+        case ARG_NONE: ok = (a==string::npos); break;
+        case ARG_TEXT: ok = (a!=string::npos); if(ok) args.text = line.substr(a); break;
+        case ARG_OPT:  if(a!=string::npos) args.text = line.substr(a); break;
+        case ARG_INT:  ok = (a!=string::npos && sscanf(line.c_str()+a, "%d", &args.num)==1); break;
+    }
+    if(!ok){ cout<<"Usage: "<<c->usage<<"\n"; return CMD_DONE; }
+    return c->handler(args) ? CMD_DONE : CMD_EXIT;
+}
+
+/* --- powloka glowna --- */
+bool cmdHelp(const CmdArgs &){ drawCommandsTable(); return true; }
+bool cmdVer(const CmdArgs &){ cout<<OS_NAME<<" | "<<KERNEL_VERSION<<"\n\n"; return true; }
+bool cmdWhoami(const CmdArgs &){ cout<<CURRENT_USER<<"\n\n"; return true; }
+bool cmdUptime(const CmdArgs &){ cout<<getUptime()<<"\n\n"; return true; }
+bool cmdNeofetch(const CmdArgs &){ extendedFastfetch(); return true; }
+bool cmdFastfetch(const CmdArgs &){ fastfetch(); return true; }
+bool cmdLs(const CmdArgs &a){ ls(a.text); return true; }
+bool cmdCat(const CmdArgs &a){ cat(a.text); return true; }
+bool cmdTouch(const CmdArgs &a){ touch(a.text); return true; }
+bool cmdWrite(const CmdArgs &a){ writeFile(a.text); return true; }
+bool cmdMkdir(const CmdArgs &a){ makeDir(a.text); return true; }
+bool cmdCd(const CmdArgs &a){ changeDir(a.text); return true; }
+bool cmdPwd(const CmdArgs &){ cout<<vfsCwdPath<<"\n\n"; return true; }
+bool cmdDf(const CmdArgs &){ diskFree(); return true; }
+bool cmdGrep(const CmdArgs &a){ grepFiles(a.text); return true; }
+bool cmdFind(const CmdArgs &a){ findFiles(a.text); return true; }
+bool cmdSnapshot(const CmdArgs &a){ takeSnapshot(a.text); return true; }
+bool cmdSnapshots(const CmdArgs &){ listSnapshots(); return true; }
+bool cmdRollback(const CmdArgs &a){ rollbackTo(a.text); return true; }
+bool cmdPs(const CmdArgs &){ htop(false); return true; }
+bool cmdHtop(const CmdArgs &){ htop(true); return true; }
+bool cmdLogs(const CmdArgs &a){ showLogs(a.text); return true; }
+bool cmdGuess(const CmdArgs &){ guessGame(); return true; }
+bool cmdCalculator(const CmdArgs &a){ calculator(a.text); return true; }
+bool cmdPaint(const CmdArgs &){ paint(); return true; }
+bool cmdMusic(const CmdArgs &){ musicPlayer(); return true; }
+bool cmdNotes(const CmdArgs &){ notesApp(); return true; }
+bool cmdYoutube(const CmdArgs &){ youtubePlayer(); return true; }
+bool cmdBrowser(const CmdArgs &a){
+    if(a.text.empty()) browserShell();
+    else if(toLowerStr(a.text.substr(0, a.text.find(' ')))=="bench")
+        htmlBench(a.text.find(' ')==string::npos ? "" : a.text.substr(a.text.find(' ') + 1));
+    else if(!pageCacheCommand(a.text)) cout<<"Usage: browser [stats | budget BYTES | bench [MB|FILE]]\n\n";
+    return true;
+}
+bool cmdBookmarks(const CmdArgs &){ browserShowBookmarks(); return true; }
+bool cmdHistory(const CmdArgs &a){ browserShowHistory(a.text); return true; }
+bool cmdInstaller(const CmdArgs &){ installer(); return true; }
+bool cmdInstall(const CmdArgs &a){ installPackages(a.text); return true; }
+bool cmdPackages(const CmdArgs &){ listPackages(); return true; }
+bool cmdSession(const CmdArgs &a){ browserSession(a.text); return true; }
+bool cmdDownloads(const CmdArgs &a){ downloadsCommand(a.text); return true; }
+bool cmdEnvchange(const CmdArgs &){ changeEnvironment(); return true; }
+bool cmdWsmApps(const CmdArgs &){ wsmApps(); return true; }
+bool cmdWsmCmds(const CmdArgs &){ wsmCmds(); return true; }
+bool cmdWsm(const CmdArgs &){ drawCommandsTable(); drawWSM(); return true; }
+bool cmdDrawWsm(const CmdArgs &){ drawWSM(); return true; }
+bool cmdDrawDesktop(const CmdArgs &){ drawDesktop(); return true; }
+bool cmdCls(const CmdArgs &){ screen.clearAll(); return true; }
+bool cmdClock(const CmdArgs &a){
+    if(!a.text.empty()){
+        ClockMode m; int speed;
+        string spec = toLowerStr(a.text);
+        for(size_t i=0;i<spec.size();i++) if(spec[i]==' ') spec[i] = ':';
+        if(!parseClockMode(spec, m, speed)){ cout<<"Usage: clock [real|fast N|virtual]\n\n"; return true; }
+        setClockMode(m, speed);
+        logEvent(LOG_INFO, "Clock mode set to %s", clockModeName());
+    }
+    cout<<"Clock: "<<clockModeName();
+    if(clockMode==CLOCK_FAST) cout<<" x"<<clockSpeed;
+    cout<<" | uptime "<<getUptime()<<"\n\n";
+    return true;
+}
+bool cmdJobs(const CmdArgs &){
+    if(tasks.empty()){ cout<<"No running tasks\n\n"; return true; }
+    char buf[128];
+    sprintf(buf, " %-6s %-24s %-10s %s\n", "PID", "TASK", "MODE", "PROGRESS"); cout<<buf;
+    for(size_t i=0;i<tasks.size();i++){
+        const Task &t = *tasks[i];
+        sprintf(buf, " %-6d %-24.24s %-10s %d/%d\n", t.pid, t.name.c_str(),
+                t.foreground ? "fg" : "bg", t.frame, t.frames);
+        cout<<buf;
+    }
+    cout<<"\n";
+    return true;
+}
+
+bool cmdFg(const CmdArgs &a){
+    Task *t = findTask(a.num);
+    if(!t){ cout<<"No such task: "<<a.num<<"\n\n"; return true; }
+    t->foreground = true;
+    t->drawnRows = -1;
+    if(t->frame > 0) drawTask(*t);
+    schedulerWait(-1, t->pid);
+    return true;
+}
+
+bool cmdKill(const CmdArgs &a){
+    for(size_t i=0;i<tasks.size();i++){
+        if(tasks[i]->pid != a.num) continue;
+        tasks[i]->frame = tasks[i]->frames;   // konczy przy najblizszym kroku
+        tasks[i]->wakeAt = clockNow();
+        runDueTasks();
+        cout<<"Killed "<<a.num<<"\n\n";
+        return true;
+    }
+    cout<<"No such task: "<<a.num<<"\n\n";
+    return true;
+}
+
+bool cmdWait(const CmdArgs &a){
+    if(!a.text.empty()){
+        int pid = atoi(a.text.c_str());
+        if(findTask(pid)) schedulerWait(-1, pid);
+        return true;
+    }
+    while(!tasks.empty()) schedulerWait(-1, tasks[0]->pid);
+    return true;
+}
+
+bool cmdExit(const CmdArgs &){ cout<<"Shutting down "<<OS_NAME<<"...\n"; addLog("Shutdown requested"); return false; }
+
+bool cmdGfxstat(const CmdArgs &a){
+    if(a.text.empty()){ showFrameStats(); return true; }
+    char word[16]; int b = 0;
+    if(sscanf(a.text.c_str(), "%15s %d", word, &b)==2 && toLowerStr(word)=="budget" && b > 0){
+        screen.stats.budget = b;
+        cout<<"Frame budget set to "<<b<<" bytes\n\n";
+    } else cout<<"Usage: gfxstat budget BYTES\n\n";
+    return true;
+}
+
+/* --- przegladarka --- */
+bool activeTabOk(){
+    if(activeTabIndex>=0 && activeTabIndex < (int)browserTabs.size()) return true;
+    cout<<"No active tab\n";
+    return false;
+}
+
+bool brHelp(const CmdArgs &){
+    cout<<"Browser commands: ";
+    bool first = true;
+    for(size_t i=0;i<browserCommands.cmds.size();i++){
+        if(browserCommands.cmds[i].hidden) continue;
+        cout<<(first ? "" : " | ")<<browserCommands.cmds[i].usage;
+        first = false;
+    }
+    cout<<"\n";
+    return true;
+}
+/* open PREFIX*: najlepsza podpowiedz z historii */
+bool brOpen(const CmdArgs &a){
+    const string &u = a.text;
+    if(u.size() > 1 && u[u.size()-1]=='*'){
+        vector<int> ids;
+        historySuggest(u.substr(0, u.size()-1), 1, ids);
+        if(ids.empty()){ cout<<"No history match for "<<u<<"\n"; return true; }
+        browserOpen(history.urls[ids[0]].url);
+    } else browserOpen(u);
+    return true;
+}
+bool brNewTab(const CmdArgs &a){ browserNewTab(a.text); return true; }
+bool brCloseTab(const CmdArgs &a){ browserCloseTab(a.num-1); return true; }
+bool brSwitch(const CmdArgs &a){ browserSwitchTab(a.num-1); return true; }
+
+bool brStats(const CmdArgs &){ showPageStats(); return true; }
+
+bool brTabs(const CmdArgs &){
+    cout<<"Open Tabs:\n";
+    for(size_t i=0;i<browserTabs.size();i++){
+        char num[16]; sprintf(num, " %2d) ", (int)i+1);
+        string title = browserTabs[i].title;
+        if(title.size() < 30) title.resize(30, ' ');
+        cout<<num<<title<<" "<<browserTabs[i].url<<"\n";
+    }
+    return true;
+}
+
+bool brBookmark(const CmdArgs &){
+    if(!activeTabOk()) return true;
+    browserBookmarks.push_back(browserTabs[activeTabIndex].url);
+    cout<<"Bookmarked: "<<browserTabs[activeTabIndex].url<<"\n";
+    logEvent(LOG_INFO, "Browser bookmark added: %s", browserTabs[activeTabIndex].url.c_str());
+    return true;
+}
+
+bool brSearch(const CmdArgs &a){
+    const string &term = a.text;
+    vector<string> results;
+    cout<<"Search results for: "<<term<<"\n";
+    for(int i=1;i<=5;i++){
+        char num[16]; sprintf(num, "%d", i);
+        results.push_back("https://search.fake/"+term+"/result"+num);
+        cout<<" "<<i<<") "<<results.back()<<"\n";
+    }
+    /* wyniki renderuja sie w tle, zanim uzytkownik wybierze */
+    prefetchPlan(results);
+    cout<<"Open result number? (0 = none): ";
+    waitForInput();
+    int r; cin>>r; cin.ignore();
+    if(r>=1 && r<=5) browserOpen(results[r-1]);
+    return true;
+}
+
+bool brBack(const CmdArgs &){ if(activeTabOk()) browserGo(-1); return true; }
+bool brForward(const CmdArgs &){ if(activeTabOk()) browserGo(1); return true; }
+bool brComplete(const CmdArgs &a){ browserComplete(a.text); return true; }
+
+bool brFollow(const CmdArgs &a){ if(activeTabOk()) browserFollow(a.num); return true; }
+bool brViewSource(const CmdArgs &){ if(activeTabOk()) browserViewSource(browserTabs[activeTabIndex].url); return true; }
+bool brDownload(const CmdArgs &){ if(activeTabOk()) browserDownload(browserTabs[activeTabIndex].url); return true; }
+
+bool brRefresh(const CmdArgs &){
+    if(!activeTabOk()) return true;
+    cout<<"Refreshing "<<browserTabs[activeTabIndex].url<<"\n";
+    loadingBar("Refresh",24,9);
+    pageForget(browserTabs[activeTabIndex].url);
+    browserOpen(browserTabs[activeTabIndex].url);
+    return true;
+}
+
+bool brExit(const CmdArgs &){ return false; }
+
+void initCommands(){
+    CommandTable &t = shellCommands;
+    t.cmds.clear();
+    addCommand(t, "help",        "help",        "System",      "Show help",            ARG_NONE, cmdHelp);
+    addCommand(t, "ver",         "ver",         "System",      "Version info",         ARG_NONE, cmdVer);
+    addCommand(t, "whoami",      "whoami",      "System",      "Current user",         ARG_NONE, cmdWhoami);
+    addCommand(t, "uptime",      "uptime",      "System",      "System uptime",        ARG_NONE, cmdUptime);
+    addCommand(t, "neofetch",    "neofetch",    "System",      "Full info",            ARG_NONE, cmdNeofetch);
+    addCommand(t, "fastfetch",   "fastfetch",   "System",      "Short info",           ARG_NONE, cmdFastfetch);
+    addCommand(t, "ls",          "ls [DIR]",    "Files",       "List directory",       ARG_OPT,  cmdLs);
+    addCommand(t, "cat",         "cat F [OFF LEN]", "Files",   "Show file (range)",    ARG_TEXT, cmdCat);
+    addCommand(t, "touch",       "touch FILE",  "Files",       "Create file",          ARG_TEXT, cmdTouch);
+    addCommand(t, "write",       "write FILE",  "Files",       "Write to file",        ARG_TEXT, cmdWrite);
+    addCommand(t, "mkdir",       "mkdir DIR",   "Files",       "Create directory",     ARG_TEXT, cmdMkdir);
+    addCommand(t, "cd",          "cd [DIR]",    "Files",       "Change directory",     ARG_OPT,  cmdCd);
+    addCommand(t, "pwd",         "pwd",         "Files",       "Current directory",    ARG_NONE, cmdPwd);
+    addCommand(t, "df",          "df",          "Files",       "Disk usage and dedup", ARG_NONE, cmdDf);
+    addCommand(t, "grep",        "grep [-i] TEXT", "Files",    "Search file contents", ARG_TEXT, cmdGrep);
+    addCommand(t, "find",        "find [DIR] NAME", "Files",   "Find files by name",   ARG_TEXT, cmdFind);
+    addCommand(t, "snapshot",    "snapshot NAME", "Files",     "Save FS checkpoint",   ARG_TEXT, cmdSnapshot);
+    addCommand(t, "snapshots",   "snapshots",   "Files",       "List snapshots",       ARG_NONE, cmdSnapshots);
+    addCommand(t, "rollback",    "rollback NAME", "Files",     "Restore a snapshot",   ARG_TEXT, cmdRollback);
+    addCommand(t, "ps",          "ps",          "Processes",   "Process list (htop)",  ARG_NONE, cmdPs);
+    addCommand(t, "htop",        "htop",        "Processes",   "Detailed htop view",   ARG_NONE, cmdHtop);
+    addCommand(t, "jobs",        "jobs",        "Processes",   "Running tasks",        ARG_NONE, cmdJobs);
+    addCommand(t, "fg",          "fg PID",      "Processes",   "Bring task to front",  ARG_INT,  cmdFg);
+    addCommand(t, "kill",        "kill PID",    "Processes",   "Stop task",            ARG_INT,  cmdKill);
+    addCommand(t, "wait",        "wait [PID]",  "Processes",   "Wait for tasks",       ARG_OPT,  cmdWait);
+    addCommand(t, "browser",     "browser [stats]", "Apps",    "Open browser",         ARG_OPT,  cmdBrowser);
+    addCommand(t, "youtube",     "youtube [&]", "Apps",        "YouTube ascii",        ARG_NONE, cmdYoutube);
+    addCommand(t, "paint",       "paint [&]",   "Apps",        "Paint",                ARG_NONE, cmdPaint);
+    addCommand(t, "musicplayer", "musicplayer [&]", "Apps",    "Music player",         ARG_NONE, cmdMusic);
+    addCommand(t, "notes",       "notes",       "Apps",        "Notes",                ARG_NONE, cmdNotes);
+    addCommand(t, "calc",        "calc [EXPR]", "Apps",        "Calculator (--batch)", ARG_OPT,  cmdCalculator);
+    addCommand(t, "calculator",  "calculator",  "Apps",        "Calculator",           ARG_OPT,  cmdCalculator, true);
+    addCommand(t, "guess",       "guess",       "Apps",        "Guess the number",     ARG_NONE, cmdGuess);
+    addCommand(t, "bookmarks",   "bookmarks",   "Apps",        "Browser bookmarks",    ARG_NONE, cmdBookmarks);
+    addCommand(t, "history",     "history [--top]", "Apps",    "Browser history",      ARG_OPT,  cmdHistory);
+    addCommand(t, "session",     "session OP NAME", "Apps",    "Save/load browser",    ARG_TEXT, cmdSession);
+    addCommand(t, "downloads",   "downloads [OP]", "Apps",     "Download manager",     ARG_OPT,  cmdDownloads);
+    addCommand(t, "wsm",         "wsm",         "Desktop",     "WSM panel",            ARG_NONE, cmdWsm);
+    addCommand(t, "wsmpanel",    "wsmpanel",    "Desktop",     "WSM panel",            ARG_NONE, cmdWsm, true);
+    addCommand(t, "drawwsm",     "drawwsm",     "Desktop",     "WSM apps & commands",  ARG_NONE, cmdDrawWsm);
+    addCommand(t, "wsm_apps",    "wsm_apps",    "Desktop",     "WSM applications",     ARG_NONE, cmdWsmApps);
+    addCommand(t, "wsm_cmds",    "wsm_cmds",    "Desktop",     "WSM commands",         ARG_NONE, cmdWsmCmds);
+    addCommand(t, "drawdesktop", "drawdesktop", "Desktop",     "Desktop view",         ARG_NONE, cmdDrawDesktop);
+    addCommand(t, "installer",   "installer",   "Maintenance", "Run installer",        ARG_NONE, cmdInstaller);
+    addCommand(t, "install",     "install PKG...", "Maintenance", "Install packages",     ARG_TEXT, cmdInstall);
+    addCommand(t, "packages",    "packages",    "Maintenance", "Installed packages",   ARG_NONE, cmdPackages);
+    addCommand(t, "envchange",   "envchange",   "Maintenance", "Change environment",   ARG_NONE, cmdEnvchange);
+    addCommand(t, "logs",        "logs [--tail N]", "Maintenance", "Logs (--since/--grep)", ARG_OPT, cmdLogs);
+    addCommand(t, "gfxstat",     "gfxstat [budget]", "Maintenance", "Renderer frame stats", ARG_OPT, cmdGfxstat);
+    addCommand(t, "clock",       "clock [MODE]","Maintenance", "real/fast N/virtual",  ARG_OPT,  cmdClock);
+    addCommand(t, "cls",         "cls",         "Maintenance", "Clear screen",         ARG_NONE, cmdCls);
+    addCommand(t, "exit",        "exit",        "Maintenance", "Shutdown",             ARG_NONE, cmdExit);
+    buildCommandTable(t);
+}
 
+/* tabela przegladarki powstaje dopiero przy pierwszym browser */
+void initBrowserCommands(){
+    CommandTable &b = browserCommands;
+    b.cmds.clear();
+    addCommand(b, "open",       "open URL",    "Browser", "Open URL in tab",     ARG_TEXT, brOpen);
+    addCommand(b, "newtab",     "newtab URL",  "Browser", "Open new tab",        ARG_TEXT, brNewTab);
+    addCommand(b, "closetab",   "closetab N",  "Browser", "Close tab",           ARG_INT,  brCloseTab);
+    addCommand(b, "switch",     "switch N",    "Browser", "Switch tab",          ARG_INT,  brSwitch);
+    addCommand(b, "follow",     "follow N",    "Browser", "Open link [N]",       ARG_INT,  brFollow);
+    addCommand(b, "back",       "back",        "Browser", "Previous page",       ARG_NONE, brBack);
+    addCommand(b, "forward",    "forward",     "Browser", "Next page",           ARG_NONE, brForward);
+    addCommand(b, "complete",   "complete PREFIX", "Browser", "History suggestions", ARG_OPT, brComplete);
+    addCommand(b, "refresh",    "refresh",     "Browser", "Reload page",         ARG_NONE, brRefresh);
+    addCommand(b, "bookmark",   "bookmark",    "Browser", "Bookmark page",       ARG_NONE, brBookmark);
+    addCommand(b, "bookmarks",  "bookmarks",   "Browser", "List bookmarks",      ARG_NONE, cmdBookmarks);
+    addCommand(b, "history",    "history [N|--top]", "Browser", "List history",  ARG_OPT,  cmdHistory);
+    addCommand(b, "search",     "search TERM", "Browser", "Search the web",      ARG_TEXT, brSearch);
+    addCommand(b, "viewsource", "viewsource",  "Browser", "Show page source",    ARG_NONE, brViewSource);
+    addCommand(b, "download",   "download",    "Browser", "Download page",       ARG_NONE, brDownload);
+    addCommand(b, "downloads",  "downloads [add URL|pause ID|resume ID|cancel ID|clear]", "Browser", "Download manager", ARG_OPT, cmdDownloads);
+    addCommand(b, "tabs",       "tabs",        "Browser", "List tabs",           ARG_NONE, brTabs);
+    addCommand(b, "stats",      "stats",       "Browser", "Page cache stats",    ARG_NONE, brStats);
+    addCommand(b, "session",    "session save|load [NAME]", "Browser", "Save/restore session", ARG_TEXT, cmdSession);
+    addCommand(b, "help",       "help",        "Browser", "Browser commands",    ARG_NONE, brHelp, true);
+    addCommand(b, "exit",       "exit",        "Browser", "Close browser",       ARG_NONE, brExit);
+    addCommand(b, "quit",       "quit",        "Browser", "Close browser",       ARG_NONE, brExit, true);
+    buildCommandTable(b);
+}
+
+/* ===============================
+   MAIN SHELL
+   interaktywnie: logo, installer, prompt.
+   --script FILE / stdin z potoku: bez animacji startowych i promptu,
+   linie z '#' na poczatku to komentarze.
+   --bench FILE [--repeat N]: odtwarza korpus komend i mierzy opoznienia.
+   Bez terminala domyslny zegar to virtual (animacje bez czekania),
+   --clock real|fast[:N]|virtual to zmienia.
+   --fast-boot: gdy jest boot.img, zamiast logo i tabeli komend jedna linia.
+   --boot-profile: czasy faz startu przed pierwszym promptem.
+=============================== */
+void shellLoop(bool interactive){
     string rawcmd;
     while(true){
-        setColor(14);
-        cout<<CURRENT_USER<<"@vireon> ";
-        setColor(7);
+        for(size_t i=0;i<taskNotices.size();i++) cout<<taskNotices[i]<<"\n";
+        taskNotices.clear();
+        if(interactive){
+            setColor(14);
+            cout<<CURRENT_USER<<"@vireon:"<<vfsCwdPath<<"> ";
+            setColor(7);
+        }
+        waitForInput();
         if(!getline(cin, rawcmd)) break;
+        if(!rawcmd.empty() && rawcmd[rawcmd.size()-1]=='\r') rawcmd.erase(rawcmd.size()-1);
         if(rawcmd.size()==0) continue;
-        string cmd = toLowerStr(rawcmd);
-        if(cmd=="help") { drawCommandsTable(); }
-        else if(cmd=="ver"){ cout<<OS_NAME<<" | "<<KERNEL_VERSION<<"\n\n"; }
-        else if(cmd=="whoami"){ cout<<CURRENT_USER<<"\n\n"; }
-        else if(cmd=="uptime"){ cout<<getUptime()<<"\n\n"; }
-        else if(cmd=="neofetch"){ extendedFastfetch(); }
-        else if(cmd=="fastfetch"){ fastfetch(); }
-        else if(cmd=="ls"){ ls(); }
-        else if(cmd.substr(0,4)=="cat "){ string f = rawcmd.substr(4); cat(f); }
-        else if(cmd.substr(0,6)=="touch "){ string f = rawcmd.substr(6); touch(f); }
-        else if(cmd.substr(0,6)=="write "){ string f = rawcmd.substr(6); writeFile(f); }
-        else if(cmd=="ps"){ htop(false); }
-        else if(cmd=="htop"){ htop(true); }
-        else if(cmd=="logs"){ showLogs(); }
-        else if(cmd=="guess"){ guessGame(); }
-        else if(cmd=="calculator"){ calculator(); }
-        else if(cmd=="paint"){ paint(); }
-        else if(cmd=="musicplayer"){ musicPlayer(); }
-        else if(cmd=="notes"){ notesApp(); }
-        else if(cmd=="installer"){ installer(); }
-        else if(cmd=="envchange"){ changeEnvironment(); }
-        else if(cmd=="wsm_apps"){ wsmApps(); }
-        else if(cmd=="wsm_cmds"){ wsmCmds(); }
-        else if(cmd=="browser"){ browserShell(); }
-        else if(cmd=="youtube"){ /* built-in youtube demo */ 
-            asciiBorder("YOUTUBE ASCII BETA",64,9);
-            cout<<"Select demo video (1-5):\n1) Funny Cats\n2) Coding Tutorial\n3) VireonOS Demo\n4) ASCII Music\n5) Retro DOS\nChoose: ";
-            int ch=0; cin>>ch; cin.ignore();
-            if(ch < 1 || ch > 5){ cout<<"Invalid\n"; }
-            else {
-                loadingBar("Preparing video",24,13);
-                cout<<"Playing video...\n";
-                for(int f=0; f<15; f++){
-                    cout<<"Frame "<<f+1<<": [";
-                    for(int b=0;b<40;b++) cout<<((rand()%3==0)?'*':' ');
-                    cout<<"]\r";
-                    msleep(120);
-                }
-                cout<<"\nVideo ended.\n\n";
-            }
+        if(!interactive && rawcmd[0]=='#') continue;
+        /* "komenda &": aplikacje oparte o zadania startuja w tle */
+        size_t amp = rawcmd.find_last_not_of(' ');
+        launchBackground = (amp != string::npos && amp > 0 && rawcmd[amp]=='&');
+        if(launchBackground) rawcmd.erase(amp);
+        int rc = runCommand(shellCommands, rawcmd);
+        launchBackground = false;
+        if(rc==CMD_EXIT) break;
+        if(rc==CMD_UNKNOWN) cout<<"Unknown command: "<<rawcmd<<"\nType 'help' for list of commands.\n\n";
+    }
+}
+
+long long percentile(vector<long long> &v, double p){
+    if(v.empty()) return 0;
+    sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (v.size()-1) + 0.5);
+    return v[i];
+}
+
+int runBenchmark(const char *path, int repeat){
+    ifstream in(path, ios::in | ios::binary);
+    if(!in){ cout<<"Cannot open corpus: "<<path<<"\n"; return 1; }
+    string corpus((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    vector<long long> all;
+    map< string, vector<long long> > byName;
+    screen.setDiscard(true);
+    long bytesBefore = screen.stats.bytes, framesBefore = screen.stats.frames;
+    long long wallStart = nowMicros();
+    for(int pass=0; pass<repeat; pass++){
+        stringbuf src(corpus);
+        screenInput.redirect(&src, false);
+        string line;
+        while(getline(cin, line)){
+            if(!line.empty() && line[line.size()-1]=='\r') line.erase(line.size()-1);
+            if(line.empty() || line[0]=='#') continue;
+            long long t0 = nowMicros();
+            int rc = runCommand(shellCommands, line);
+            screen.present();
+            if(logPending() >= LOG_CAPACITY/2) logFlush();
+            long long dt = nowMicros() - t0;
+            all.push_back(dt);
+            byName[toLowerStr(line.substr(0, line.find(' ')))].push_back(dt);
+            if(rc==CMD_EXIT) break;
         }
-        else if(cmd=="wsm" || cmd=="wsmpanel"){ drawCommandsTable(); drawWSM(); }
-        else if(cmd=="drawwsm"){ drawWSM(); }
-        else if(cmd=="drawdesktop"){ drawDesktop(); }
-        else if(cmd=="bookmarks"){ browserShowBookmarks(); }
-        else if(cmd=="history"){ browserShowHistory(); }
-        else if(cmd=="cls"){ system("cls"); }
-        else if(cmd=="exit"){ cout<<"Shutting down "<<OS_NAME<<"...\n"; addLog("Shutdown requested"); break; }
+        cin.clear();
+        screenInput.redirect(screenInput.source(), false);
+    }
+    long long wall = nowMicros() - wallStart;
+    screen.setDiscard(false);
+
+    char buf[160];
+    size_t n = all.size();
+    asciiBorder(string("BENCHMARK: ")+path,64,11);
+    setColor(11);
+    sprintf(buf," Commands   : %lu (%d pass%s)\n", (unsigned long)n, repeat, repeat==1 ? "" : "es"); cout<<buf;
+    sprintf(buf," Wall time  : %.1f ms\n", wall/1000.0); cout<<buf;
+    sprintf(buf," Throughput : %.0f cmds/s\n", wall>0 ? n*1e6/wall : 0.0); cout<<buf;
+    long p50 = (long)percentile(all,0.50), p99 = (long)percentile(all,0.99), mx = n ? (long)all[n-1] : 0L;
+    sprintf(buf," Latency    : p50 %ld us | p99 %ld us | max %ld us\n", p50, p99, mx); cout<<buf;
+    sprintf(buf," Output     : %ld bytes in %ld frames (discarded)\n\n",
+            screen.stats.bytes-bytesBefore, screen.stats.frames-framesBefore); cout<<buf;
+    sprintf(buf,"  %-14s %8s %10s %10s\n","COMMAND","COUNT","P50(us)","P99(us)"); cout<<buf;
+    for(map< string, vector<long long> >::iterator it=byName.begin(); it!=byName.end(); ++it){
+        sprintf(buf,"  %-14s %8lu %10ld %10ld\n", it->first.c_str(), (unsigned long)it->second.size(),
+                (long)percentile(it->second,0.50), (long)percentile(it->second,0.99));
+        cout<<buf;
+    }
+    cout<<"\n";
+    setColor(7);
+    return 0;
+}
+
+int main(int argc, char **argv){
+    bootStart = nowMicros();
+    const char *scriptPath = 0, *benchPath = 0, *clockSpec = 0;
+    int repeat = 1;
+    bool profile = false, fast = false;
+    for(int i=1;i<argc;i++){
+        string a = argv[i];
+        if(a=="--script" && i+1<argc) scriptPath = argv[++i];
+        else if(a=="--bench" && i+1<argc) benchPath = argv[++i];
+        else if(a=="--repeat" && i+1<argc) repeat = max(1, atoi(argv[++i]));
+        else if(a=="--clock" && i+1<argc) clockSpec = argv[++i];
+        else if(a=="--data" && i+1<argc) dataDir = argv[++i];
+        else if(a=="--boot-profile") profile = true;
+        else if(a=="--fast-boot") fast = true;
         else {
-            cout<<"Unknown command: "<<rawcmd<<"\nType 'help' for list of commands.\n\n";
+            cout<<"Usage: "<<argv[0]<<" [--script FILE|-] [--bench FILE [--repeat N]] [--clock real|fast[:N]|virtual] [--data DIR|none] [--fast-boot] [--boot-profile]\n";
+            return 1;
         }
     }
 
+    screen.attach();
+    bootMark("screen");
+    bool headless = benchPath || scriptPath || !screenInput.isTty();
+    ClockMode cm = headless ? CLOCK_VIRTUAL : CLOCK_REAL;
+    int speed = 1;
+    if(clockSpec && !parseClockMode(clockSpec, cm, speed)){
+        cout<<"Unknown clock mode: "<<clockSpec<<"\n";
+        return 1;
+    }
+    setClockMode(cm, speed);
+    boot();
+    procEnter(PID_SHELL);
+    if(benchPath){
+        int rc = runBenchmark(benchPath, repeat);
+        closeFS();
+        logCloseStore();
+        return rc;
+    }
+
+    ifstream script;
+    if(scriptPath && strcmp(scriptPath,"-")!=0){
+        script.open(scriptPath);
+        if(!script){ cout<<"Cannot open script: "<<scriptPath<<"\n"; return 1; }
+        screenInput.redirect(script.rdbuf(), false);
+    }
+    bool interactive = !scriptPath && screenInput.isTty();
+    if(interactive && fast && bootRestored){
+        /* szybki start: stan z boot.img, zamiast logo i tabeli jedna linia */
+        fastfetch();
+    } else if(interactive){
+        showLogo();
+        /* instalator tylko przy pierwszym starcie: stan jest w /var/lib/packages.db */
+        if(regEmpty()) installer();
+        drawCommandsTable();
+    }
+    bootMark("banner");
+    if(profile) bootReport();
+    shellLoop(interactive);
+    bootSave();
+    closeFS();
+    logCloseStore();
     return 0;
 }
-
 /* ===============================
    Additional Auxiliary GUIs (WSM / Desktop)
 =============================== */
@@ -945,9 +7252,12 @@ void wsmApps(){
     asciiBorder("WSM - Applications",60,10);
     smallLogo("vireon");
     cout<<"Installed Applications:\n";
-    if(installedPrograms.empty()) cout<<" (none)\n";
-    for(size_t i=0;i<installedPrograms.size();i++){
-        printf("  %2d) %s\n",(int)i+1, installedPrograms[i].c_str());
+    const vector<int> &apps = regList(PKG_APP);
+    if(apps.empty()) cout<<" (none)\n";
+    for(size_t i=0;i<apps.size();i++){
+        char line[128];
+        sprintf(line, "  %2d) %s\n",(int)i+1, regName(apps[i]).c_str());
+        cout<<line;
     }
     cout<<"\n";
 }